@@ -211,6 +211,11 @@ RECENT REVISION HISTORY:
 // (at least this is true for iOS and Android). Therefore, the NEON support is
 // toggled by a build flag: define STBI_NEON to get NEON loops.
 //
+// The JPEG IDCT, 2x2 upsampling and YCbCr conversion also have AVX2 versions,
+// picked by a run-time test on top of SSE2; define STBI_NO_AVX2 to leave them
+// out. A baseline JPEG with restart markers decodes its restart intervals in
+// parallel when stbi_set_parallel_for has been given a parallel-for.
+//
 // If for some reason you do not want to use any of SIMD code, or if
 // you have issues compiling it, you can disable it entirely by
 // defining STBI_NO_SIMD.
@@ -446,6 +451,45 @@ STBIDEF void stbi_convert_iphone_png_to_rgb(int flag_true_if_should_convert);
 // flip the image vertically, so the first pixel in the output array is the bottom left
 STBIDEF void stbi_set_flip_vertically_on_load(int flag_true_if_should_flip);
 
+// the three flags above are process-wide, so threads decoding at the same time would race on
+// them. the _with_options loads take them per call instead and touch no global state besides
+// the failure reason. stbi_default_load_options fills in the current process-wide settings.
+// JPEG, PNG, BMP, TGA and PNM write their rows bottom-up as they go when flipping; the other
+// formats still flip in a pass after the decode
+typedef struct
+{
+   int desired_channels;            // 0 keeps the file's channel count, like desired_channels above
+   int flip_vertically;             // first pixel in the output array is the bottom left
+   int prefer_16_bit;               // 16-bit PNG/PSD come back as stbi_us instead of being cut to 8 bits
+   int unpremultiply;               // see stbi_set_unpremultiply_on_load
+   int convert_iphone_png_to_rgb;   // see stbi_convert_iphone_png_to_rgb
+   // decode straight to a smaller image, the size of mip level N (each side halved N times, never
+   // below 1). JPEG gets up to 3 levels from its DCT coefficients for free, the rest is box filtered
+   int skip_levels;                 // N itself
+   int max_size;                    // above 0, N is raised until neither side is larger than this
+} stbi_load_options;
+
+STBIDEF void stbi_default_load_options(stbi_load_options *options);
+
+// options may be NULL for the defaults. the pixels are stbi_uc, or stbi_us when *bits_per_channel
+// comes back as 16 (only with prefer_16_bit); bits_per_channel may be NULL without prefer_16_bit.
+// *x and *y are the size after skip_levels/max_size
+STBIDEF void *stbi_load_from_memory_with_options   (stbi_uc const *buffer, int len, int *x, int *y, int *channels_in_file, int *bits_per_channel, stbi_load_options const *options);
+STBIDEF void *stbi_load_from_callbacks_with_options(stbi_io_callbacks const *clbk, void *user, int *x, int *y, int *channels_in_file, int *bits_per_channel, stbi_load_options const *options);
+#ifndef STBI_NO_STDIO
+STBIDEF void *stbi_load_with_options               (char const *filename, int *x, int *y, int *channels_in_file, int *bits_per_channel, stbi_load_options const *options);
+#endif
+
+// spread the independent parts of a single decode over your own threads (currently PNG: inflate runs
+// while finished rows are unfiltered, the seven Adam7 passes, and the sub-8-bit/16-bit expansion).
+// run(user, task, task_user, count) must call task(task_user, i) once for each i in [0,count) and return
+// only when all of them finished; the calls may happen on any thread and in any order, one after the
+// other included. set it before loading, NULL (the default) decodes on the calling thread.
+// #define STBI_NO_THREADS to compile the pipelined decode out; the passes still go through run
+typedef void stbi_parallel_task(void *task_user, int index);
+typedef void stbi_parallel_for(void *user, stbi_parallel_task *task, void *task_user, int count);
+STBIDEF void stbi_set_parallel_for(stbi_parallel_for *run, void *user);
+
 // ZLIB client - used by PNG, available for other purposes
 
 STBIDEF char *stbi_zlib_decode_malloc_guesssize(const char *buffer, int len, int initial_size, int *outlen);
@@ -456,6 +500,11 @@ STBIDEF int   stbi_zlib_decode_buffer(char *obuffer, int olen, const char *ibuff
 STBIDEF char *stbi_zlib_decode_noheader_malloc(const char *buffer, int len, int *outlen);
 STBIDEF int   stbi_zlib_decode_noheader_buffer(char *obuffer, int olen, const char *ibuffer, int ilen);
 
+// huffman blocks normally go through a wide inflate (64-bit bit buffer, two literals per table lookup,
+// 8 byte match copies); set this to decode with the original byte-at-a-time loop instead, e.g. to
+// compare the two
+STBIDEF void stbi_zlib_use_reference_inflate(int flag_true_if_should_use_reference);
+
 
 #ifdef __cplusplus
 }
@@ -553,6 +602,12 @@ typedef int32_t  stbi__int32;
 // should produce compiler error if size is wrong
 typedef unsigned char validate_uint32[sizeof(stbi__uint32)==4 ? 1 : -1];
 
+#ifdef _MSC_VER
+typedef unsigned __int64 stbi__uint64;
+#else
+typedef unsigned long long stbi__uint64;
+#endif
+
 #ifdef _MSC_VER
 #define STBI_NOTUSED(v)  (void)(v)
 #else
@@ -682,6 +737,68 @@ static int stbi__sse2_available(void)
 #define STBI_SIMD_ALIGN(type, name) type name
 #endif
 
+// AVX2 versions of the JPEG kernels, chosen at run time. only those functions are compiled for AVX2
+// (a target attribute on GCC/Clang; MSVC takes the intrinsics anywhere), so the library still runs
+// on any SSE2 machine. #define STBI_NO_AVX2 to leave them out
+#if defined(STBI_SSE2) && !defined(STBI_NO_AVX2) && ((defined(_MSC_VER) && _MSC_VER >= 1700) || defined(__clang__) || (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))))
+#define STBI_AVX2
+#include <immintrin.h>
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#define STBI__AVX2_TARGET
+static int stbi__avx2_available(void)
+{
+   int info[4];
+   __cpuid(info, 0);
+   if (info[0] < 7) return 0;
+   __cpuid(info, 1);
+   // AVX, and OSXSAVE so xgetbv can tell whether the OS saves the ymm registers
+   if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0) return 0;
+   if ((_xgetbv(0) & 6) != 6) return 0;
+   __cpuidex(info, 7, 0);
+   return (info[1] & (1 << 5)) != 0;
+}
+#else
+#define STBI__AVX2_TARGET __attribute__((target("avx2")))
+static int stbi__avx2_available(void)
+{
+   return __builtin_cpu_supports("avx2");
+}
+#endif
+#endif
+
+// just enough atomics for one thread to hand progress to another inside a decode
+typedef long stbi__atomic;
+#ifndef STBI_NO_THREADS
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define stbi__atomic_load(p)      _InterlockedOr((volatile long *) (p), 0)
+#define stbi__atomic_store(p,v)   _InterlockedExchange((volatile long *) (p), (v))
+#define stbi__atomic_add(p,v)     _InterlockedExchangeAdd((volatile long *) (p), (v))
+#elif defined(__GNUC__) || defined(__clang__)
+#define stbi__atomic_load(p)      __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define stbi__atomic_store(p,v)   __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#define stbi__atomic_add(p,v)     __atomic_fetch_add((p), (v), __ATOMIC_ACQ_REL)
+#else
+#define STBI_NO_THREADS
+#endif
+#endif
+
+#ifndef STBI_NO_THREADS
+#if defined(__cplusplus)
+#include <thread>
+#define stbi__yield()  std::this_thread::yield()
+#elif defined(_WIN32)
+__declspec(dllimport) int __stdcall SwitchToThread(void);
+#define stbi__yield()  SwitchToThread()
+#elif defined(__unix__) || defined(__APPLE__)
+#include <sched.h>
+#define stbi__yield()  sched_yield()
+#else
+#define stbi__yield()  ((void) 0)
+#endif
+#endif
+
 ///////////////////////////////////////////////
 //
 //  stbi__context struct and start_xxx functions
@@ -702,14 +819,46 @@ typedef struct
 
    stbi_uc *img_buffer, *img_buffer_end;
    stbi_uc *img_buffer_original, *img_buffer_original_end;
+
+   // this load's options, see stbi_load_options
+   int flip_vertically;
+   int unpremultiply;
+   int de_iphone;
+   int skip_levels, max_size;
 } stbi__context;
 
+// process-wide defaults, each context takes a copy when it starts
+static int stbi__vertically_flip_on_load = 0;
+static int stbi__unpremultiply_on_load = 0;
+static int stbi__de_iphone_flag = 0;
 
 static void stbi__refill_buffer(stbi__context *s);
 
+static void stbi__start_options(stbi__context *s)
+{
+   s->flip_vertically = stbi__vertically_flip_on_load;
+   s->unpremultiply = stbi__unpremultiply_on_load;
+   s->de_iphone = stbi__de_iphone_flag;
+   s->skip_levels = 0;
+   s->max_size = 0;
+}
+
+// how many more times a w x h image should be halved for skip_levels/max_size, after done already
+static int stbi__downscale_levels(stbi__context *s, stbi__uint32 w, stbi__uint32 h, int done)
+{
+   int levels = s->skip_levels - done;
+   if (levels < 0) levels = 0;
+   if (s->max_size > 0)
+      while ((w >> levels) > (stbi__uint32) s->max_size || (h >> levels) > (stbi__uint32) s->max_size) ++levels;
+   // past the level where both sides fit in one box it stays the same 1x1 average
+   while (levels > 0 && (w >> (levels-1)) == 0 && (h >> (levels-1)) == 0) --levels;
+   return levels;
+}
+
 // initialize a memory-decode context
 static void stbi__start_mem(stbi__context *s, stbi_uc const *buffer, int len)
 {
+   stbi__start_options(s);
    s->io.read = NULL;
    s->read_from_callbacks = 0;
    s->img_buffer = s->img_buffer_original = (stbi_uc *) buffer;
@@ -719,6 +868,7 @@ static void stbi__start_mem(stbi__context *s, stbi_uc const *buffer, int len)
 // initialize a callback-based context
 static void stbi__start_callbacks(stbi__context *s, stbi_io_callbacks *c, void *user)
 {
+   stbi__start_options(s);
    s->io = *c;
    s->io_user_data = user;
    s->buflen = sizeof(s->buffer_start);
@@ -781,6 +931,8 @@ typedef struct
    int bits_per_channel;
    int num_channels;
    int channel_order;
+   int flipped; // the loader already stored the rows bottom-up
+   int downscaled; // halvings the loader already did for skip_levels/max_size
 } stbi__result_info;
 
 #ifndef STBI_NO_JPEG
@@ -962,13 +1114,31 @@ static float   *stbi__ldr_to_hdr(stbi_uc *data, int x, int y, int comp);
 static stbi_uc *stbi__hdr_to_ldr(float   *data, int x, int y, int comp);
 #endif
 
-static int stbi__vertically_flip_on_load = 0;
-
 STBIDEF void stbi_set_flip_vertically_on_load(int flag_true_if_should_flip)
 {
     stbi__vertically_flip_on_load = flag_true_if_should_flip;
 }
 
+static stbi_parallel_for *stbi__parallel_run = NULL;
+static void *stbi__parallel_user = NULL;
+
+STBIDEF void stbi_set_parallel_for(stbi_parallel_for *run, void *user)
+{
+   stbi__parallel_run = run;
+   stbi__parallel_user = user;
+}
+
+// task for every index in [0,count), through the installed parallel-for or a plain loop
+static void stbi__parallel(stbi_parallel_task *task, void *task_user, int count)
+{
+   int i;
+   if (stbi__parallel_run && count > 1)
+      stbi__parallel_run(stbi__parallel_user, task, task_user, count);
+   else
+      for (i=0; i < count; ++i)
+         task(task_user, i);
+}
+
 static void *stbi__load_main(stbi__context *s, int *x, int *y, int *comp, int req_comp, stbi__result_info *ri, int bpc)
 {
    memset(ri, 0, sizeof(*ri)); // make sure it's initialized if we add new fields
@@ -1098,7 +1268,7 @@ static unsigned char *stbi__load_and_postprocess_8bit(stbi__context *s, int *x,
 
    // @TODO: move stbi__convert_format to here
 
-   if (stbi__vertically_flip_on_load) {
+   if (s->flip_vertically && !ri.flipped) {
       int channels = req_comp ? req_comp : *comp;
       stbi__vertical_flip(result, *x, *y, channels * sizeof(stbi_uc));
    }
@@ -1123,7 +1293,7 @@ static stbi__uint16 *stbi__load_and_postprocess_16bit(stbi__context *s, int *x,
    // @TODO: move stbi__convert_format16 to here
    // @TODO: special case RGB-to-Y (and RGBA-to-YA) for 8-bit-to-16-bit case to keep more precision
 
-   if (stbi__vertically_flip_on_load) {
+   if (s->flip_vertically && !ri.flipped) {
       int channels = req_comp ? req_comp : *comp;
       stbi__vertical_flip(result, *x, *y, channels * sizeof(stbi__uint16));
    }
@@ -1132,9 +1302,9 @@ static stbi__uint16 *stbi__load_and_postprocess_16bit(stbi__context *s, int *x,
 }
 
 #if !defined(STBI_NO_HDR) || !defined(STBI_NO_LINEAR)
-static void stbi__float_postprocess(float *result, int *x, int *y, int *comp, int req_comp)
+static void stbi__float_postprocess(stbi__context *s, float *result, int *x, int *y, int *comp, int req_comp)
 {
-   if (stbi__vertically_flip_on_load && result != NULL) {
+   if (s->flip_vertically && result != NULL) {
       int channels = req_comp ? req_comp : *comp;
       stbi__vertical_flip(result, *x, *y, channels * sizeof(float));
    }
@@ -1202,6 +1372,20 @@ STBIDEF stbi_us *stbi_load_16(char const *filename, int *x, int *y, int *comp, i
    return result;
 }
 
+static void *stbi__load_with_options(stbi__context *s, int *x, int *y, int *comp, int *bits_per_channel, stbi_load_options const *options);
+
+STBIDEF void *stbi_load_with_options(char const *filename, int *x, int *y, int *comp, int *bits_per_channel, stbi_load_options const *options)
+{
+   FILE *f = stbi__fopen(filename, "rb");
+   void *result;
+   stbi__context s;
+   if (!f) return stbi__errpuc("can't fopen", "Unable to open file");
+   stbi__start_file(&s,f);
+   result = stbi__load_with_options(&s,x,y,comp,bits_per_channel,options);
+   fclose(f);
+   return result;
+}
+
 
 #endif //!STBI_NO_STDIO
 
@@ -1233,6 +1417,140 @@ STBIDEF stbi_uc *stbi_load_from_callbacks(stbi_io_callbacks const *clbk, void *u
    return stbi__load_and_postprocess_8bit(&s,x,y,comp,req_comp);
 }
 
+STBIDEF void stbi_default_load_options(stbi_load_options *options)
+{
+   options->desired_channels = 0;
+   options->flip_vertically = stbi__vertically_flip_on_load;
+   options->prefer_16_bit = 0;
+   options->unpremultiply = stbi__unpremultiply_on_load;
+   options->convert_iphone_png_to_rgb = stbi__de_iphone_flag;
+   options->skip_levels = 0;
+   options->max_size = 0;
+}
+
+// sums the rows of a box into acc, 8-bit samples
+static void stbi__box_sum_rows(stbi__uint32 *acc, stbi_uc *row, int row_bytes, int rows, int len)
+{
+   int r,i;
+   for (r=0; r < rows; ++r, row += row_bytes) {
+      i = 0;
+#ifdef STBI_SSE2
+      if (stbi__sse2_available()) {
+         __m128i zero = _mm_setzero_si128();
+         for (; i+16 <= len; i += 16) {
+            __m128i b = _mm_loadu_si128((__m128i const *) (row + i));
+            __m128i lo = _mm_unpacklo_epi8(b, zero), hi = _mm_unpackhi_epi8(b, zero);
+            __m128i *a = (__m128i *) (acc + i);
+            _mm_storeu_si128(a+0, _mm_add_epi32(_mm_loadu_si128(a+0), _mm_unpacklo_epi16(lo, zero)));
+            _mm_storeu_si128(a+1, _mm_add_epi32(_mm_loadu_si128(a+1), _mm_unpackhi_epi16(lo, zero)));
+            _mm_storeu_si128(a+2, _mm_add_epi32(_mm_loadu_si128(a+2), _mm_unpacklo_epi16(hi, zero)));
+            _mm_storeu_si128(a+3, _mm_add_epi32(_mm_loadu_si128(a+3), _mm_unpackhi_epi16(hi, zero)));
+         }
+      }
+#endif
+      for (; i < len; ++i)
+         acc[i] += row[i];
+   }
+}
+
+// averages boxes of (1 << levels) pixels square into the w>>levels x h>>levels image, sides that are
+// already smaller than a box become 1 pixel. rows past a whole number of boxes are dropped from the
+// end of the image, which is the start of the buffer when it was flipped
+static void *stbi__box_reduce(void *image, int *w, int *h, int n, int bits, int flipped, int levels)
+{
+   int bw = *w >> levels >= 1 ? 1 << levels : *w, bh = *h >> levels >= 1 ? 1 << levels : *h;
+   int ow = *w / bw, oh = *h / bh, bytes = bits / 8;
+   int len = ow * bw * n, x, y, c, i;
+   stbi__uint32 div = (stbi__uint32) (bw * bh);
+   stbi_uc *src = (stbi_uc *) image + (flipped ? (size_t) (*h - oh*bh) * *w * n * bytes : 0);
+   stbi_uc *out = (stbi_uc *) stbi__malloc_mad3(ow, oh, n * bytes, 0);
+   stbi__uint32 *acc = (stbi__uint32 *) stbi__malloc_mad2(len, sizeof(stbi__uint32), 0);
+   if (!out || !acc) {
+      STBI_FREE(out); STBI_FREE(acc); STBI_FREE(image);
+      return stbi__errpuc("outofmem", "Out of memory");
+   }
+   for (y=0; y < oh; ++y) {
+      stbi_uc *rows = src + (size_t) y * bh * *w * n * bytes;
+      memset(acc, 0, len * sizeof(stbi__uint32));
+      if (bytes == 1) {
+         stbi__box_sum_rows(acc, rows, *w * n, bh, len);
+      } else {
+         int r;
+         for (r=0; r < bh; ++r) {
+            stbi__uint16 *row = (stbi__uint16 *) (rows + (size_t) r * *w * n * 2);
+            for (i=0; i < len; ++i)
+               acc[i] += row[i];
+         }
+      }
+      for (x=0; x < ow; ++x) {
+         for (c=0; c < n; ++c) {
+            stbi__uint64 sum = 0;
+            for (i=0; i < bw; ++i)
+               sum += acc[(x*bw + i)*n + c];
+            sum = (sum + div/2) / div;
+            if (bytes == 1) out[(y*ow + x)*n + c] = (stbi_uc) sum;
+            else ((stbi__uint16 *) out)[(y*ow + x)*n + c] = (stbi__uint16) sum;
+         }
+      }
+   }
+   STBI_FREE(acc);
+   STBI_FREE(image);
+   *w = ow;
+   *h = oh;
+   return out;
+}
+
+static void *stbi__load_with_options(stbi__context *s, int *x, int *y, int *comp, int *bits_per_channel, stbi_load_options const *options)
+{
+   stbi_load_options defaults;
+   stbi__result_info ri;
+   int req_comp, channels, levels;
+   void *result;
+   if (options == NULL) {
+      stbi_default_load_options(&defaults);
+      options = &defaults;
+   }
+   s->flip_vertically = options->flip_vertically;
+   s->unpremultiply = options->unpremultiply;
+   s->de_iphone = options->convert_iphone_png_to_rgb;
+   s->skip_levels = options->skip_levels;
+   s->max_size = options->max_size;
+   if (bits_per_channel) *bits_per_channel = 8;
+   req_comp = options->desired_channels;
+   result = stbi__load_main(s, x, y, comp, req_comp, &ri, options->prefer_16_bit ? 16 : 8);
+   if (result == NULL)
+      return NULL;
+   channels = req_comp ? req_comp : *comp;
+   if (ri.bits_per_channel != 8 && !(options->prefer_16_bit && bits_per_channel)) {
+      result = stbi__convert_16_to_8((stbi__uint16 *) result, *x, *y, channels);
+      ri.bits_per_channel = 8;
+      if (result == NULL) return NULL;
+   }
+   levels = stbi__downscale_levels(s, *x, *y, ri.downscaled);
+   if (levels > 0) {
+      result = stbi__box_reduce(result, x, y, channels, ri.bits_per_channel, ri.flipped, levels);
+      if (result == NULL) return NULL;
+   }
+   if (s->flip_vertically && !ri.flipped)
+      stbi__vertical_flip(result, *x, *y, channels * (ri.bits_per_channel / 8));
+   if (bits_per_channel) *bits_per_channel = ri.bits_per_channel;
+   return result;
+}
+
+STBIDEF void *stbi_load_from_memory_with_options(stbi_uc const *buffer, int len, int *x, int *y, int *comp, int *bits_per_channel, stbi_load_options const *options)
+{
+   stbi__context s;
+   stbi__start_mem(&s,buffer,len);
+   return stbi__load_with_options(&s,x,y,comp,bits_per_channel,options);
+}
+
+STBIDEF void *stbi_load_from_callbacks_with_options(stbi_io_callbacks const *clbk, void *user, int *x, int *y, int *comp, int *bits_per_channel, stbi_load_options const *options)
+{
+   stbi__context s;
+   stbi__start_callbacks(&s, (stbi_io_callbacks *) clbk, user);
+   return stbi__load_with_options(&s,x,y,comp,bits_per_channel,options);
+}
+
 #ifndef STBI_NO_GIF
 STBIDEF stbi_uc *stbi_load_gif_from_memory(stbi_uc const *buffer, int len, int **delays, int *x, int *y, int *z, int *comp, int req_comp)
 {
@@ -1241,7 +1559,7 @@ STBIDEF stbi_uc *stbi_load_gif_from_memory(stbi_uc const *buffer, int len, int *
    stbi__start_mem(&s,buffer,len); 
    
    result = (unsigned char*) stbi__load_gif_main(&s, delays, x, y, z, comp, req_comp);
-   if (stbi__vertically_flip_on_load) {
+   if (s.flip_vertically) {
       stbi__vertical_flip_slices( result, *x, *y, *z, *comp ); 
    }
 
@@ -1258,7 +1576,7 @@ static float *stbi__loadf_main(stbi__context *s, int *x, int *y, int *comp, int
       stbi__result_info ri;
       float *hdr_data = stbi__hdr_load(s,x,y,comp,req_comp, &ri);
       if (hdr_data)
-         stbi__float_postprocess(hdr_data,x,y,comp,req_comp);
+         stbi__float_postprocess(s,hdr_data,x,y,comp,req_comp);
       return hdr_data;
    }
    #endif
@@ -1744,6 +2062,7 @@ typedef struct
 
    int scan_n, order[4];
    int restart_interval, todo;
+   int idct_shift; // blocks come out 8 >> idct_shift pixels square when decoding at reduced size
 
 // kernels
    void (*idct_block_kernel)(stbi_uc *out, int out_stride, short data[64]);
@@ -2260,6 +2579,58 @@ static void stbi__idct_block(stbi_uc *out, int out_stride, short data[64])
    }
 }
 
+// reduced size IDCTs for decoding at 1/2, 1/4 and 1/8 scale. each output pixel is the average of
+// its 2x2 (4x4) pixels of the full IDCT, taken over the lowest 4x4 (2x2) coefficients only: the
+// higher ones would just alias. entries are C(u)/2 * mean cos((2x'+1)u pi/16) over x' in the box, 12 bits
+static const short stbi__idct4_table[4][4] =
+{
+   { 1448, 1856, 1338, 652 }, { 1448, 769, -1338, -1573 }, { 1448, -769, -1338, 1573 }, { 1448, -1856, 1338, -652 },
+};
+static const short stbi__idct2_table[2][2] =
+{
+   { 1448, 1312 }, { 1448, -1312 },
+};
+
+static void stbi__idct_reduced(stbi_uc *out, int out_stride, short data[64], const short *table, int size)
+{
+   int i,j,k,tmp[16];
+   // columns, keeping one extra bit
+   for (i=0; i < size; ++i) {
+      for (j=0; j < size; ++j) {
+         int t = 1 << 10;
+         for (k=0; k < size; ++k)
+            t += table[j*size + k] * data[k*8 + i];
+         tmp[j*size + i] = t >> 11;
+      }
+   }
+   // rows, with the +128 level shift and rounding folded in
+   for (j=0; j < size; ++j, out += out_stride) {
+      for (i=0; i < size; ++i) {
+         int t = (128 << 13) + (1 << 12);
+         for (k=0; k < size; ++k)
+            t += table[i*size + k] * tmp[j*size + k];
+         out[i] = stbi__clamp(t >> 13);
+      }
+   }
+}
+
+static void stbi__idct_4x4(stbi_uc *out, int out_stride, short data[64])
+{
+   stbi__idct_reduced(out, out_stride, data, stbi__idct4_table[0], 4);
+}
+
+static void stbi__idct_2x2(stbi_uc *out, int out_stride, short data[64])
+{
+   stbi__idct_reduced(out, out_stride, data, stbi__idct2_table[0], 2);
+}
+
+// the block's average is its DC term alone
+static void stbi__idct_1x1(stbi_uc *out, int out_stride, short data[64])
+{
+   STBI_NOTUSED(out_stride);
+   out[0] = stbi__clamp(((data[0] + 4) >> 3) + 128);
+}
+
 #ifdef STBI_SSE2
 // sse2 integer IDCT. not the fastest possible implementation but it
 // produces bit-identical results to the generic C version so it's
@@ -2441,6 +2812,166 @@ static void stbi__idct_simd(stbi_uc *out, int out_stride, short data[64])
 
 #endif // STBI_SSE2
 
+#ifdef STBI_AVX2
+// AVX2 flavour of stbi__idct_simd, bit-identical to it: rows and transposes stay 16-bit and 128 bits
+// wide, while the 32-bit products of a whole row fit one register instead of a lo/hi pair
+STBI__AVX2_TARGET static void stbi__idct_avx2(stbi_uc *out, int out_stride, short data[64])
+{
+   __m128i row0, row1, row2, row3, row4, row5, row6, row7;
+   __m128i tmp;
+
+   // dot product constant: even elems=x, odd elems=y
+   #define dct_const(x,y)  _mm256_set1_epi32((int) (((unsigned) (y) << 16) | ((x) & 0xffff)))
+
+   // out0 = c0[even]*x + c0[odd]*y, out1 the same with c1, all 8 columns at once (32-bit out)
+   #define dct_rot(out0,out1, x,y,c0,c1) \
+      __m256i c0##xy = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_unpacklo_epi16((x),(y))), _mm_unpackhi_epi16((x),(y)), 1); \
+      __m256i out0 = _mm256_madd_epi16(c0##xy, c0); \
+      __m256i out1 = _mm256_madd_epi16(c0##xy, c1)
+
+   // out = in << 12  (in 16-bit, out 32-bit)
+   #define dct_widen(out, in) \
+      __m256i out = _mm256_slli_epi32(_mm256_cvtepi16_epi32(in), 12)
+
+   // butterfly a/b, add bias, then shift by "s" and pack both results with one packs
+   #define dct_bfly32o(out0, out1, a,b,bias,s) \
+      { \
+         __m256i abiased = _mm256_add_epi32(a, bias); \
+         __m256i sum = _mm256_srai_epi32(_mm256_add_epi32(abiased, b), s); \
+         __m256i dif = _mm256_srai_epi32(_mm256_sub_epi32(abiased, b), s); \
+         __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(sum, dif), 0xd8); \
+         out0 = _mm256_castsi256_si128(packed); \
+         out1 = _mm256_extracti128_si256(packed, 1); \
+      }
+
+   // 8-bit interleave step (for transposes)
+   #define dct_interleave8(a, b) \
+      tmp = a; \
+      a = _mm_unpacklo_epi8(a, b); \
+      b = _mm_unpackhi_epi8(tmp, b)
+
+   // 16-bit interleave step (for transposes)
+   #define dct_interleave16(a, b) \
+      tmp = a; \
+      a = _mm_unpacklo_epi16(a, b); \
+      b = _mm_unpackhi_epi16(tmp, b)
+
+   #define dct_pass(bias,shift) \
+      { \
+         /* even part */ \
+         dct_rot(t2e,t3e, row2,row6, rot0_0,rot0_1); \
+         __m128i sum04 = _mm_add_epi16(row0, row4); \
+         __m128i dif04 = _mm_sub_epi16(row0, row4); \
+         dct_widen(t0e, sum04); \
+         dct_widen(t1e, dif04); \
+         __m256i x0 = _mm256_add_epi32(t0e, t3e); \
+         __m256i x3 = _mm256_sub_epi32(t0e, t3e); \
+         __m256i x1 = _mm256_add_epi32(t1e, t2e); \
+         __m256i x2 = _mm256_sub_epi32(t1e, t2e); \
+         /* odd part */ \
+         dct_rot(y0o,y2o, row7,row3, rot2_0,rot2_1); \
+         dct_rot(y1o,y3o, row5,row1, rot3_0,rot3_1); \
+         __m128i sum17 = _mm_add_epi16(row1, row7); \
+         __m128i sum35 = _mm_add_epi16(row3, row5); \
+         dct_rot(y4o,y5o, sum17,sum35, rot1_0,rot1_1); \
+         __m256i x4 = _mm256_add_epi32(y0o, y4o); \
+         __m256i x5 = _mm256_add_epi32(y1o, y5o); \
+         __m256i x6 = _mm256_add_epi32(y2o, y5o); \
+         __m256i x7 = _mm256_add_epi32(y3o, y4o); \
+         dct_bfly32o(row0,row7, x0,x7,bias,shift); \
+         dct_bfly32o(row1,row6, x1,x6,bias,shift); \
+         dct_bfly32o(row2,row5, x2,x5,bias,shift); \
+         dct_bfly32o(row3,row4, x3,x4,bias,shift); \
+      }
+
+   __m256i rot0_0 = dct_const(stbi__f2f(0.5411961f), stbi__f2f(0.5411961f) + stbi__f2f(-1.847759065f));
+   __m256i rot0_1 = dct_const(stbi__f2f(0.5411961f) + stbi__f2f( 0.765366865f), stbi__f2f(0.5411961f));
+   __m256i rot1_0 = dct_const(stbi__f2f(1.175875602f) + stbi__f2f(-0.899976223f), stbi__f2f(1.175875602f));
+   __m256i rot1_1 = dct_const(stbi__f2f(1.175875602f), stbi__f2f(1.175875602f) + stbi__f2f(-2.562915447f));
+   __m256i rot2_0 = dct_const(stbi__f2f(-1.961570560f) + stbi__f2f( 0.298631336f), stbi__f2f(-1.961570560f));
+   __m256i rot2_1 = dct_const(stbi__f2f(-1.961570560f), stbi__f2f(-1.961570560f) + stbi__f2f( 3.072711026f));
+   __m256i rot3_0 = dct_const(stbi__f2f(-0.390180644f) + stbi__f2f( 2.053119869f), stbi__f2f(-0.390180644f));
+   __m256i rot3_1 = dct_const(stbi__f2f(-0.390180644f), stbi__f2f(-0.390180644f) + stbi__f2f( 1.501321110f));
+
+   // rounding biases in column/row passes, see stbi__idct_block for explanation.
+   __m256i bias_0 = _mm256_set1_epi32(512);
+   __m256i bias_1 = _mm256_set1_epi32(65536 + (128<<17));
+
+   // load
+   row0 = _mm_load_si128((const __m128i *) (data + 0*8));
+   row1 = _mm_load_si128((const __m128i *) (data + 1*8));
+   row2 = _mm_load_si128((const __m128i *) (data + 2*8));
+   row3 = _mm_load_si128((const __m128i *) (data + 3*8));
+   row4 = _mm_load_si128((const __m128i *) (data + 4*8));
+   row5 = _mm_load_si128((const __m128i *) (data + 5*8));
+   row6 = _mm_load_si128((const __m128i *) (data + 6*8));
+   row7 = _mm_load_si128((const __m128i *) (data + 7*8));
+
+   // column pass
+   dct_pass(bias_0, 10);
+
+   {
+      // 16bit 8x8 transpose
+      dct_interleave16(row0, row4);
+      dct_interleave16(row1, row5);
+      dct_interleave16(row2, row6);
+      dct_interleave16(row3, row7);
+
+      dct_interleave16(row0, row2);
+      dct_interleave16(row1, row3);
+      dct_interleave16(row4, row6);
+      dct_interleave16(row5, row7);
+
+      dct_interleave16(row0, row1);
+      dct_interleave16(row2, row3);
+      dct_interleave16(row4, row5);
+      dct_interleave16(row6, row7);
+   }
+
+   // row pass
+   dct_pass(bias_1, 17);
+
+   {
+      // pack
+      __m128i p0 = _mm_packus_epi16(row0, row1);
+      __m128i p1 = _mm_packus_epi16(row2, row3);
+      __m128i p2 = _mm_packus_epi16(row4, row5);
+      __m128i p3 = _mm_packus_epi16(row6, row7);
+
+      // 8bit 8x8 transpose
+      dct_interleave8(p0, p2);
+      dct_interleave8(p1, p3);
+
+      dct_interleave8(p0, p1);
+      dct_interleave8(p2, p3);
+
+      dct_interleave8(p0, p2);
+      dct_interleave8(p1, p3);
+
+      // store
+      _mm_storel_epi64((__m128i *) out, p0); out += out_stride;
+      _mm_storel_epi64((__m128i *) out, _mm_shuffle_epi32(p0, 0x4e)); out += out_stride;
+      _mm_storel_epi64((__m128i *) out, p2); out += out_stride;
+      _mm_storel_epi64((__m128i *) out, _mm_shuffle_epi32(p2, 0x4e)); out += out_stride;
+      _mm_storel_epi64((__m128i *) out, p1); out += out_stride;
+      _mm_storel_epi64((__m128i *) out, _mm_shuffle_epi32(p1, 0x4e)); out += out_stride;
+      _mm_storel_epi64((__m128i *) out, p3); out += out_stride;
+      _mm_storel_epi64((__m128i *) out, _mm_shuffle_epi32(p3, 0x4e));
+   }
+
+   // no AVX-SSE transition penalty for the SSE2 code that runs next
+   _mm256_zeroupper();
+
+#undef dct_const
+#undef dct_rot
+#undef dct_widen
+#undef dct_bfly32o
+#undef dct_interleave8
+#undef dct_interleave16
+#undef dct_pass
+}
+#endif // STBI_AVX2
+
 #ifdef STBI_NEON
 
 // NEON integer IDCT. should produce bit-identical
@@ -2683,9 +3214,168 @@ static void stbi__jpeg_reset(stbi__jpeg *j)
    // since we don't even allow 1<<30 pixels
 }
 
+// where block (bx,by) of component n goes
+stbi_inline static stbi_uc *stbi__jpeg_block_out(stbi__jpeg *z, int n, int bx, int by)
+{
+   int size = 8 >> z->idct_shift;
+   return z->img_comp[n].data + z->img_comp[n].w2*by*size + bx*size;
+}
+
+// decodes count MCUs of a baseline scan starting at MCU first, without looking for restart markers
+static int stbi__jpeg_decode_mcus(stbi__jpeg *z, int first, int count)
+{
+   int m,k,x,y;
+   STBI_SIMD_ALIGN(short, data[64]);
+   if (z->scan_n == 1) {
+      // non-interleaved, every block is an MCU
+      int n = z->order[0];
+      int w = (z->img_comp[n].x+7) >> 3;
+      int ha = z->img_comp[n].ha;
+      for (m = first; m < first + count; ++m) {
+         int i = m % w, j = m / w;
+         if (!stbi__jpeg_decode_block(z, data, z->huff_dc+z->img_comp[n].hd, z->huff_ac+ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
+         z->idct_block_kernel(stbi__jpeg_block_out(z, n, i, j), z->img_comp[n].w2, data);
+      }
+   } else {
+      for (m = first; m < first + count; ++m) {
+         int i = m % z->img_mcu_x, j = m / z->img_mcu_x;
+         for (k=0; k < z->scan_n; ++k) {
+            int n = z->order[k];
+            for (y=0; y < z->img_comp[n].v; ++y) {
+               for (x=0; x < z->img_comp[n].h; ++x) {
+                  int ha = z->img_comp[n].ha;
+                  if (!stbi__jpeg_decode_block(z, data, z->huff_dc+z->img_comp[n].hd, z->huff_ac+ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
+                  z->idct_block_kernel(stbi__jpeg_block_out(z, n, i*z->img_comp[n].h + x, j*z->img_comp[n].v + y), z->img_comp[n].w2, data);
+               }
+            }
+         }
+      }
+   }
+   return 1;
+}
+
+// restart markers reset the entropy decoder and the dc predictions, so the intervals between them
+// decode independently: read the whole scan, split it at the markers and hand runs of intervals to
+// the parallel-for, each with its own copy of the decoder state
+#define STBI__JPEG_RESTART_TASKS 64
+
+typedef struct
+{
+   stbi__jpeg *z;
+   // the scan's entropy coded bytes with the restart markers taken out,
+   // interval k is data[start[k], start[k+1])
+   stbi_uc *data;
+   int *start;
+   int intervals, mcus, tasks;
+   int ok[STBI__JPEG_RESTART_TASKS];
+   // MCUs each task decoded, together they have to cover the scan
+   int decoded[STBI__JPEG_RESTART_TASKS];
+} stbi__jpeg_restarts;
+
+static void stbi__jpeg_restart_task(void *user, int index)
+{
+   stbi__jpeg_restarts *r = (stbi__jpeg_restarts *) user;
+   int k0 = r->intervals * index / r->tasks;
+   int k1 = r->intervals * (index+1) / r->tasks;
+   stbi__context s;
+   stbi__jpeg *z;
+   int k;
+   r->ok[index] = 0;
+   r->decoded[index] = 0;
+   z = (stbi__jpeg *) stbi__malloc(sizeof(stbi__jpeg));
+   if (!z) { stbi__err("outofmem", "Out of memory"); return; }
+   *z = *r->z;
+   z->s = &s;
+   for (k = k0; k < k1; ++k) {
+      int first = k * z->restart_interval;
+      int count = r->mcus - first < z->restart_interval ? r->mcus - first : z->restart_interval;
+      if (count <= 0) break; // restart markers past the end of the image
+      stbi__start_mem(&s, r->data + r->start[k], r->start[k+1] - r->start[k]);
+      stbi__jpeg_reset(z);
+      if (!stbi__jpeg_decode_mcus(z, first, count)) {
+         STBI_FREE(z);
+         return;
+      }
+      r->decoded[index] += count;
+   }
+   STBI_FREE(z);
+   r->ok[index] = 1;
+}
+
+static int stbi__parse_entropy_coded_restarts(stbi__jpeg *z)
+{
+   stbi__jpeg_restarts r;
+   int len = 0, cap = 1 << 16, start_cap = 64, i, decoded = 0;
+   r.z = z;
+   r.data = (stbi_uc *) stbi__malloc(cap);
+   r.start = (int *) stbi__malloc(start_cap * sizeof(int));
+   r.intervals = 0;
+   if (!r.data || !r.start) {
+      STBI_FREE(r.data); STBI_FREE(r.start);
+      return stbi__err("outofmem", "Out of memory");
+   }
+   r.start[0] = 0;
+   // same byte handling as stbi__grow_buffer_unsafe: fill bytes are dropped, 0xff 0x00 is data,
+   // a restart marker starts the next interval and any other marker ends the scan
+   while (!stbi__at_eof(z->s)) {
+      int b = stbi__get8(z->s);
+      if (b == 0xff) {
+         int c = stbi__get8(z->s);
+         while (c == 0xff) c = stbi__get8(z->s);
+         if (c != 0) {
+            if (!STBI__RESTART(c)) {
+               z->marker = (unsigned char) c;
+               break;
+            }
+            if (r.intervals+2 >= start_cap) {
+               int *p = (int *) STBI_REALLOC_SIZED(r.start, start_cap * sizeof(int), start_cap * 2 * sizeof(int));
+               if (!p) { STBI_FREE(r.data); STBI_FREE(r.start); return stbi__err("outofmem", "Out of memory"); }
+               r.start = p;
+               start_cap *= 2;
+            }
+            r.start[++r.intervals] = len;
+            continue;
+         }
+      }
+      if (len+2 > cap) {
+         stbi_uc *p = (stbi_uc *) STBI_REALLOC_SIZED(r.data, cap, cap * 2);
+         if (!p) { STBI_FREE(r.data); STBI_FREE(r.start); return stbi__err("outofmem", "Out of memory"); }
+         r.data = p;
+         cap *= 2;
+      }
+      r.data[len++] = (stbi_uc) b;
+      if (b == 0xff) r.data[len++] = 0;
+   }
+   r.start[++r.intervals] = len;
+
+   if (z->scan_n == 1) {
+      int n = z->order[0];
+      r.mcus = ((z->img_comp[n].x+7) >> 3) * ((z->img_comp[n].y+7) >> 3);
+   } else {
+      r.mcus = z->img_mcu_x * z->img_mcu_y;
+   }
+   // missing or stripped markers leave MCUs no interval decodes, their pixels would be left uninitialized
+   if (r.intervals < (r.mcus + z->restart_interval - 1) / z->restart_interval) {
+      STBI_FREE(r.data); STBI_FREE(r.start);
+      return stbi__err("bad restart", "Corrupt JPEG");
+   }
+   r.tasks = r.intervals < STBI__JPEG_RESTART_TASKS ? r.intervals : STBI__JPEG_RESTART_TASKS;
+   stbi__parallel(stbi__jpeg_restart_task, &r, r.tasks);
+   STBI_FREE(r.data);
+   STBI_FREE(r.start);
+   for (i=0; i < r.tasks; ++i) {
+      if (!r.ok[i]) return 0;
+      decoded += r.decoded[i];
+   }
+   if (decoded < r.mcus) return stbi__err("bad restart", "Corrupt JPEG");
+   return 1;
+}
+
 static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
 {
    stbi__jpeg_reset(z);
+   if (!z->progressive && z->restart_interval && stbi__parallel_run)
+      return stbi__parse_entropy_coded_restarts(z);
    if (!z->progressive) {
       if (z->scan_n == 1) {
          int i,j;
@@ -2701,7 +3391,7 @@ static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
             for (i=0; i < w; ++i) {
                int ha = z->img_comp[n].ha;
                if (!stbi__jpeg_decode_block(z, data, z->huff_dc+z->img_comp[n].hd, z->huff_ac+ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
-               z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*j*8+i*8, z->img_comp[n].w2, data);
+               z->idct_block_kernel(stbi__jpeg_block_out(z, n, i, j), z->img_comp[n].w2, data);
                // every data block is an MCU, so countdown the restart interval
                if (--z->todo <= 0) {
                   if (z->code_bits < 24) stbi__grow_buffer_unsafe(z);
@@ -2725,11 +3415,9 @@ static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
                   // by the basic H and V specified for the component
                   for (y=0; y < z->img_comp[n].v; ++y) {
                      for (x=0; x < z->img_comp[n].h; ++x) {
-                        int x2 = (i*z->img_comp[n].h + x)*8;
-                        int y2 = (j*z->img_comp[n].v + y)*8;
                         int ha = z->img_comp[n].ha;
                         if (!stbi__jpeg_decode_block(z, data, z->huff_dc+z->img_comp[n].hd, z->huff_ac+ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
-                        z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*y2+x2, z->img_comp[n].w2, data);
+                        z->idct_block_kernel(stbi__jpeg_block_out(z, n, i*z->img_comp[n].h + x, j*z->img_comp[n].v + y), z->img_comp[n].w2, data);
                      }
                   }
                }
@@ -2826,7 +3514,7 @@ static void stbi__jpeg_finish(stbi__jpeg *z)
             for (i=0; i < w; ++i) {
                short *data = z->img_comp[n].coeff + 64 * (i + j * z->img_comp[n].coeff_w);
                stbi__jpeg_dequantize(data, z->dequant[z->img_comp[n].tq]);
-               z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*j*8+i*8, z->img_comp[n].w2, data);
+               z->idct_block_kernel(stbi__jpeg_block_out(z, n, i, j), z->img_comp[n].w2, data);
             }
          }
       }
@@ -3045,6 +3733,13 @@ static int stbi__process_frame_header(stbi__jpeg *z, int scan)
    z->img_mcu_x = (s->img_x + z->img_mcu_w-1) / z->img_mcu_w;
    z->img_mcu_y = (s->img_y + z->img_mcu_h-1) / z->img_mcu_h;
 
+   // decoding at reduced size: smaller IDCT outputs, the component planes shrink with them
+   z->idct_shift = stbi__downscale_levels(s, s->img_x, s->img_y, 0);
+   if (z->idct_shift > 3) z->idct_shift = 3;
+   if (z->idct_shift == 1) z->idct_block_kernel = stbi__idct_4x4;
+   if (z->idct_shift == 2) z->idct_block_kernel = stbi__idct_2x2;
+   if (z->idct_shift == 3) z->idct_block_kernel = stbi__idct_1x1;
+
    for (i=0; i < s->img_n; ++i) {
       // number of effective pixels (e.g. for non-interleaved MCU)
       z->img_comp[i].x = (s->img_x * z->img_comp[i].h + h_max-1) / h_max;
@@ -3056,8 +3751,8 @@ static int stbi__process_frame_header(stbi__jpeg *z, int scan)
       //
       // img_mcu_x, img_mcu_y: <=17 bits; comp[i].h and .v are <=4 (checked earlier)
       // so these muls can't overflow with 32-bit ints (which we require)
-      z->img_comp[i].w2 = z->img_mcu_x * z->img_comp[i].h * 8;
-      z->img_comp[i].h2 = z->img_mcu_y * z->img_comp[i].v * 8;
+      z->img_comp[i].w2 = z->img_mcu_x * z->img_comp[i].h * (8 >> z->idct_shift);
+      z->img_comp[i].h2 = z->img_mcu_y * z->img_comp[i].v * (8 >> z->idct_shift);
       z->img_comp[i].coeff = 0;
       z->img_comp[i].raw_coeff = 0;
       z->img_comp[i].linebuf = NULL;
@@ -3067,10 +3762,10 @@ static int stbi__process_frame_header(stbi__jpeg *z, int scan)
       // align blocks for idct using mmx/sse
       z->img_comp[i].data = (stbi_uc*) (((size_t) z->img_comp[i].raw_data + 15) & ~15);
       if (z->progressive) {
-         // w2, h2 are multiples of 8 (see above)
-         z->img_comp[i].coeff_w = z->img_comp[i].w2 / 8;
-         z->img_comp[i].coeff_h = z->img_comp[i].h2 / 8;
-         z->img_comp[i].raw_coeff = stbi__malloc_mad3(z->img_comp[i].w2, z->img_comp[i].h2, sizeof(short), 15);
+         // one 8x8 coefficient block per block of the planes, whatever size those come out at
+         z->img_comp[i].coeff_w = z->img_mcu_x * z->img_comp[i].h;
+         z->img_comp[i].coeff_h = z->img_mcu_y * z->img_comp[i].v;
+         z->img_comp[i].raw_coeff = stbi__malloc_mad3(z->img_comp[i].coeff_w * 8, z->img_comp[i].coeff_h * 8, sizeof(short), 15);
          if (z->img_comp[i].raw_coeff == NULL)
             return stbi__free_jpeg_components(z, i+1, stbi__err("outofmem", "Out of memory"));
          z->img_comp[i].coeff = (short*) (((size_t) z->img_comp[i].raw_coeff + 15) & ~15);
@@ -3351,6 +4046,64 @@ static stbi_uc *stbi__resample_row_hv_2_simd(stbi_uc *out, stbi_uc *in_near, stb
 }
 #endif
 
+#ifdef STBI_AVX2
+// stbi__resample_row_hv_2_simd 16 pixels at a time; the scalar tail is exact like the SSE2 loop is
+STBI__AVX2_TARGET static stbi_uc *stbi__resample_row_hv_2_avx2(stbi_uc *out, stbi_uc *in_near, stbi_uc *in_far, int w, int hs)
+{
+   int i=0,t0,t1;
+
+   if (w == 1) {
+      out[0] = out[1] = stbi__div4(3*in_near[0] + in_far[0] + 2);
+      return out;
+   }
+
+   t1 = 3*in_near[0] + in_far[0];
+   for (; i < ((w-1) & ~15); i += 16) {
+      // vertical pass, 3*x + y = 4*x + (y - x)
+      __m256i farw  = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i *) (in_far + i)));
+      __m256i nearw = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i *) (in_near + i)));
+      __m256i curr  = _mm256_add_epi16(_mm256_slli_epi16(nearw, 2), _mm256_sub_epi16(farw, nearw));
+
+      // current row shifted right/left by a pixel across both 128-bit lanes, with the pixel before
+      // (t1) and the one after this block of 16 filled in
+      __m256i prv0 = _mm256_alignr_epi8(curr, _mm256_permute2x128_si256(curr, curr, 0x08), 14);
+      __m256i nxt0 = _mm256_alignr_epi8(_mm256_permute2x128_si256(curr, curr, 0x81), curr, 2);
+      __m256i prev = _mm256_or_si256(prv0, _mm256_setr_epi32(t1, 0,0,0,0,0,0,0));
+      __m256i next = _mm256_or_si256(nxt0, _mm256_setr_epi32(0,0,0,0,0,0,0, (3*in_near[i+16] + in_far[i+16]) << 16));
+
+      // horizontal polyphase filter, see stbi__resample_row_hv_2_simd
+      __m256i bias = _mm256_set1_epi16(8);
+      __m256i curb = _mm256_add_epi16(_mm256_slli_epi16(curr, 2), bias);
+      __m256i even = _mm256_add_epi16(_mm256_sub_epi16(prev, curr), curb);
+      __m256i odd  = _mm256_add_epi16(_mm256_sub_epi16(next, curr), curb);
+
+      // unpack works per lane, which with packus puts pixels 0-7 in the low lane and 8-15 in the high one
+      __m256i de0  = _mm256_srli_epi16(_mm256_unpacklo_epi16(even, odd), 4);
+      __m256i de1  = _mm256_srli_epi16(_mm256_unpackhi_epi16(even, odd), 4);
+      _mm256_storeu_si256((__m256i *) (out + i*2), _mm256_packus_epi16(de0, de1));
+
+      t1 = 3*in_near[i+15] + in_far[i+15];
+   }
+   _mm256_zeroupper();
+
+   t0 = t1;
+   t1 = 3*in_near[i] + in_far[i];
+   out[i*2] = stbi__div16(3*t1 + t0 + 8);
+
+   for (++i; i < w; ++i) {
+      t0 = t1;
+      t1 = 3*in_near[i]+in_far[i];
+      out[i*2-1] = stbi__div16(3*t0 + t1 + 8);
+      out[i*2  ] = stbi__div16(3*t1 + t0 + 8);
+   }
+   out[w*2-1] = stbi__div4(t1+2);
+
+   STBI_NOTUSED(hs);
+
+   return out;
+}
+#endif
+
 static stbi_uc *stbi__resample_row_generic(stbi_uc *out, stbi_uc *in_near, stbi_uc *in_far, int w, int hs)
 {
    // resample with nearest-neighbor
@@ -3525,9 +4278,71 @@ static void stbi__YCbCr_to_RGB_simd(stbi_uc *out, stbi_uc const *y, stbi_uc cons
 }
 #endif
 
+#ifdef STBI_AVX2
+// stbi__YCbCr_to_RGB_simd 16 pixels at a time, the rest goes through it
+STBI__AVX2_TARGET static void stbi__YCbCr_to_RGB_avx2(stbi_uc *out, stbi_uc const *y, stbi_uc const *pcb, stbi_uc const *pcr, int count, int step)
+{
+   int i = 0;
+   if (step == 4) {
+      __m128i signflip  = _mm_set1_epi8(-0x80);
+      __m256i cr_const0 = _mm256_set1_epi16(   (short) ( 1.40200f*4096.0f+0.5f));
+      __m256i cr_const1 = _mm256_set1_epi16( - (short) ( 0.71414f*4096.0f+0.5f));
+      __m256i cb_const0 = _mm256_set1_epi16( - (short) ( 0.34414f*4096.0f+0.5f));
+      __m256i cb_const1 = _mm256_set1_epi16(   (short) ( 1.77200f*4096.0f+0.5f));
+      __m256i y_bias = _mm256_set1_epi16(128);
+      __m256i xw = _mm256_set1_epi16(255); // alpha channel
+
+      for (; i+15 < count; i += 16) {
+         // load
+         __m128i y_bytes  = _mm_loadu_si128((__m128i *) (y+i));
+         __m128i cr_bytes = _mm_loadu_si128((__m128i *) (pcr+i));
+         __m128i cb_bytes = _mm_loadu_si128((__m128i *) (pcb+i));
+
+         // to short, y as (y << 8) + 128 and cr, cb as (c - 128) << 8 like the SSE2 unpacks
+         __m256i yw  = _mm256_or_si256(_mm256_slli_epi16(_mm256_cvtepu8_epi16(y_bytes), 8), y_bias);
+         __m256i crw = _mm256_slli_epi16(_mm256_cvtepu8_epi16(_mm_xor_si128(cr_bytes, signflip)), 8);
+         __m256i cbw = _mm256_slli_epi16(_mm256_cvtepu8_epi16(_mm_xor_si128(cb_bytes, signflip)), 8);
+
+         // color transform
+         __m256i yws = _mm256_srli_epi16(yw, 4);
+         __m256i cr0 = _mm256_mulhi_epi16(cr_const0, crw);
+         __m256i cb0 = _mm256_mulhi_epi16(cb_const0, cbw);
+         __m256i cb1 = _mm256_mulhi_epi16(cbw, cb_const1);
+         __m256i cr1 = _mm256_mulhi_epi16(crw, cr_const1);
+         __m256i rws = _mm256_add_epi16(cr0, yws);
+         __m256i gwt = _mm256_add_epi16(cb0, yws);
+         __m256i bws = _mm256_add_epi16(yws, cb1);
+         __m256i gws = _mm256_add_epi16(gwt, cr1);
+
+         // descale
+         __m256i rw = _mm256_srai_epi16(rws, 4);
+         __m256i bw = _mm256_srai_epi16(bws, 4);
+         __m256i gw = _mm256_srai_epi16(gws, 4);
+
+         // back to byte and interleave, per 128-bit lane: the low lane ends up with pixels 0-3 and
+         // 4-7 in o0/o1, the high lane with 8-11 and 12-15
+         __m256i brb = _mm256_packus_epi16(rw, bw);
+         __m256i gxb = _mm256_packus_epi16(gw, xw);
+         __m256i t0 = _mm256_unpacklo_epi8(brb, gxb);
+         __m256i t1 = _mm256_unpackhi_epi8(brb, gxb);
+         __m256i o0 = _mm256_unpacklo_epi16(t0, t1);
+         __m256i o1 = _mm256_unpackhi_epi16(t0, t1);
+
+         // store
+         _mm256_storeu_si256((__m256i *) (out + 0), _mm256_permute2x128_si256(o0, o1, 0x20));
+         _mm256_storeu_si256((__m256i *) (out + 32), _mm256_permute2x128_si256(o0, o1, 0x31));
+         out += 64;
+      }
+      _mm256_zeroupper();
+   }
+   stbi__YCbCr_to_RGB_simd(out, y+i, pcb+i, pcr+i, count-i, step);
+}
+#endif
+
 // set up the kernels
 static void stbi__setup_jpeg(stbi__jpeg *j)
 {
+   j->idct_shift = 0;
    j->idct_block_kernel = stbi__idct_block;
    j->YCbCr_to_RGB_kernel = stbi__YCbCr_to_RGB_row;
    j->resample_row_hv_2_kernel = stbi__resample_row_hv_2;
@@ -3540,6 +4355,14 @@ static void stbi__setup_jpeg(stbi__jpeg *j)
    }
 #endif
 
+#ifdef STBI_AVX2
+   if (stbi__avx2_available()) {
+      j->idct_block_kernel = stbi__idct_avx2;
+      j->YCbCr_to_RGB_kernel = stbi__YCbCr_to_RGB_avx2;
+      j->resample_row_hv_2_kernel = stbi__resample_row_hv_2_avx2;
+   }
+#endif
+
 #ifdef STBI_NEON
    j->idct_block_kernel = stbi__idct_simd;
    j->YCbCr_to_RGB_kernel = stbi__YCbCr_to_RGB_simd;
@@ -3591,12 +4414,22 @@ static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp
    else
       decode_n = z->s->img_n;
 
+   // from here on the image is the reduced one, whole pixels only like a mip level
+   if (z->idct_shift) {
+      int k;
+      for (k=0; k < z->s->img_n; ++k)
+         z->img_comp[k].y = (z->img_comp[k].y + (1 << z->idct_shift) - 1) >> z->idct_shift;
+      z->s->img_x = z->s->img_x >> z->idct_shift ? z->s->img_x >> z->idct_shift : 1;
+      z->s->img_y = z->s->img_y >> z->idct_shift ? z->s->img_y >> z->idct_shift : 1;
+   }
+
    // resample and color-convert
    {
       int k;
       unsigned int i,j;
       stbi_uc *output;
       stbi_uc *coutput[4];
+      stbi_uc after_row = 0;
 
       stbi__resample res_comp[4];
 
@@ -3626,9 +4459,13 @@ static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp
       output = (stbi_uc *) stbi__malloc_mad3(n, z->s->img_x, z->s->img_y, 1);
       if (!output) { stbi__cleanup_jpeg(z); return stbi__errpuc("outofmem", "Out of memory"); }
 
-      // now go ahead and resample
+      // now go ahead and resample, straight into the bottom-up rows when flipping
       for (j=0; j < z->s->img_y; ++j) {
-         stbi_uc *out = output + n * z->s->img_x * j;
+         stbi_uc *out = output + n * z->s->img_x * (z->s->flip_vertically ? z->s->img_y-1-j : j);
+         // 3 channel output stores a 4th byte past every pixel, which going bottom-up would land on the
+         // first byte of the row already written below (the last row has the allocation's spare byte)
+         stbi_uc *row_end = out + n * z->s->img_x;
+         if (z->s->flip_vertically) after_row = *row_end;
          for (k=0; k < decode_n; ++k) {
             stbi__resample *r = &res_comp[k];
             int y_bot = r->ystep >= (r->vs >> 1);
@@ -3720,6 +4557,7 @@ static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp
                   for (i=0; i < z->s->img_x; ++i) *out++ = y[i], *out++ = 255;
             }
          }
+         if (z->s->flip_vertically) *row_end = after_row;
       }
       stbi__cleanup_jpeg(z);
       *out_x = z->s->img_x;
@@ -3733,10 +4571,11 @@ static void *stbi__jpeg_load(stbi__context *s, int *x, int *y, int *comp, int re
 {
    unsigned char* result;
    stbi__jpeg* j = (stbi__jpeg*) stbi__malloc(sizeof(stbi__jpeg));
-   STBI_NOTUSED(ri);
    j->s = s;
    stbi__setup_jpeg(j);
    result = load_jpeg_image(j, x,y,comp,req_comp);
+   ri->flipped = s->flip_vertically;
+   ri->downscaled = j->idct_shift;
    STBI_FREE(j);
    return result;
 }
@@ -3881,10 +4720,26 @@ typedef struct
    char *zout_start;
    char *zout_end;
    int   z_expandable;
+   // set when a fixed size buffer was too small
+   int   z_overflow;
+
+   // when not NULL, the count of bytes inflated so far is stored here every STBI__ZPUBLISH_STEP bytes
+   stbi__atomic *zprogress;
+   char *zpublish_next;
 
    stbi__zhuffman z_length, z_distance;
 } stbi__zbuf;
 
+#ifndef STBI_NO_THREADS
+#define STBI__ZPUBLISH_STEP 32768
+
+static void stbi__zpublish(stbi__zbuf *z, char *zout)
+{
+   stbi__atomic_store(z->zprogress, (long) (zout - z->zout_start));
+   z->zpublish_next = zout + STBI__ZPUBLISH_STEP;
+}
+#endif
+
 stbi_inline static stbi_uc stbi__zget8(stbi__zbuf *z)
 {
    if (z->zbuffer >= z->zbuffer_end) return 0;
@@ -3947,7 +4802,10 @@ static int stbi__zexpand(stbi__zbuf *z, char *zout, int n)  // need to make room
    char *q;
    int cur, limit, old_limit;
    z->zout = zout;
-   if (!z->z_expandable) return stbi__err("output buffer limit","Corrupt PNG");
+   if (!z->z_expandable) {
+      z->z_overflow = 1;
+      return stbi__err("output buffer limit","Corrupt PNG");
+   }
    cur   = (int) (z->zout     - z->zout_start);
    limit = old_limit = (int) (z->zout_end - z->zout_start);
    while (cur + n > limit)
@@ -3979,7 +4837,11 @@ static int stbi__parse_huffman_block(stbi__zbuf *a)
 {
    char *zout = a->zout;
    for(;;) {
-      int z = stbi__zhuffman_decode(a, &a->z_length);
+      int z;
+#ifndef STBI_NO_THREADS
+      if (a->zprogress && zout >= a->zpublish_next) stbi__zpublish(a, zout);
+#endif
+      z = stbi__zhuffman_decode(a, &a->z_length);
       if (z < 256) {
          if (z < 0) return stbi__err("bad huffman code","Corrupt PNG"); // error in huffman codes
          if (zout >= a->zout_end) {
@@ -4017,6 +4879,231 @@ static int stbi__parse_huffman_block(stbi__zbuf *a)
    }
 }
 
+// wide inflate: a 64-bit bit buffer refilled 8 bytes at a time, STBI__ZWIDE_BITS bit tables that resolve
+// up to two literals, or a length with its base and extra bit count, per lookup, and matches copied
+// 8 bytes at a time. falls back to stbi__zwide_slow only for codes longer than the tables
+#define STBI__ZWIDE_BITS  11
+#define STBI__ZWIDE_SIZE  (1 << STBI__ZWIDE_BITS)
+#define STBI__ZWIDE_MASK  (STBI__ZWIDE_SIZE - 1)
+
+// litlen entries: bits 0-7 code bits used, 8-9 kind, then the literal(s) in 16-23 and 24-31, or for a
+// length the extra bit count in 10-15 and the base in 16-31 (base 0 is end of block).
+// dist entries: bits 0-7 code bits used, 8-15 extra bit count, 16-31 base. 0 means not in the table
+enum { STBI__ZWIDE_slow, STBI__ZWIDE_lit1, STBI__ZWIDE_lit2, STBI__ZWIDE_len };
+
+typedef struct
+{
+   stbi__uint32 litlen[STBI__ZWIDE_SIZE];
+   stbi__uint32 dist[STBI__ZWIDE_SIZE];
+} stbi__zwide;
+
+static int stbi__zlib_reference = 0;
+
+STBIDEF void stbi_zlib_use_reference_inflate(int flag_true_if_should_use_reference)
+{
+   stbi__zlib_reference = flag_true_if_should_use_reference;
+}
+
+// 0 for symbols a valid stream never sends
+static stbi__uint32 stbi__zwide_litlen_entry(int sym, int len)
+{
+   if (sym < 256) return len | (STBI__ZWIDE_lit1 << 8) | (sym << 16);
+   if (sym == 256) return len | (STBI__ZWIDE_len << 8);
+   if (sym < 286) return len | (STBI__ZWIDE_len << 8) | (stbi__zlength_extra[sym-257] << 10) | ((stbi__uint32) stbi__zlength_base[sym-257] << 16);
+   return 0;
+}
+
+static stbi__uint32 stbi__zwide_dist_entry(int sym, int len)
+{
+   if (sym < 30) return len | (stbi__zdist_extra[sym] << 8) | ((stbi__uint32) stbi__zdist_base[sym] << 16);
+   return 0;
+}
+
+// symbol << 16 | code length for every table index whose code fits, 0 elsewhere
+static void stbi__zwide_single(const stbi__zhuffman *z, stbi__uint32 *table)
+{
+   int s,i,j;
+   memset(table, 0, STBI__ZWIDE_SIZE * sizeof(table[0]));
+   for (s=1; s <= STBI__ZWIDE_BITS; ++s) {
+      int count = (z->maxcode[s] >> (16-s)) - z->firstcode[s];
+      for (i=0; i < count; ++i) {
+         stbi__uint32 e = ((stbi__uint32) z->value[z->firstsymbol[s] + i] << 16) | s;
+         for (j = stbi__bit_reverse(z->firstcode[s] + i, s); j < STBI__ZWIDE_SIZE; j += 1 << s)
+            table[j] = e;
+      }
+   }
+}
+
+static void stbi__zwide_build(stbi__zwide *w, const stbi__zhuffman *length, const stbi__zhuffman *distance)
+{
+   int i;
+   // the dist table is scratch space for the single symbol litlen table until it is built
+   stbi__uint32 *single = w->dist;
+   stbi__zwide_single(length, single);
+   for (i=0; i < STBI__ZWIDE_SIZE; ++i) {
+      int len = single[i] & 255, sym = single[i] >> 16;
+      stbi__uint32 e = len ? stbi__zwide_litlen_entry(sym, len) : 0;
+      if (e && sym < 256) {
+         // a second literal whose whole code is in the bits left over
+         stbi__uint32 next = single[i >> len];
+         int len2 = next & 255;
+         if (len2 && len + len2 <= STBI__ZWIDE_BITS && (next >> 16) < 256)
+            e = (len + len2) | (STBI__ZWIDE_lit2 << 8) | (sym << 16) | ((next >> 16) << 24);
+      }
+      w->litlen[i] = e;
+   }
+   stbi__zwide_single(distance, w->dist);
+   for (i=0; i < STBI__ZWIDE_SIZE; ++i) {
+      stbi__uint32 e = w->dist[i];
+      w->dist[i] = e ? stbi__zwide_dist_entry(e >> 16, e & 255) : 0;
+   }
+}
+
+// codes longer than the table, same search as stbi__zhuffman_decode_slowpath; returns the symbol, -1 if invalid
+static int stbi__zwide_slow(const stbi__zhuffman *z, stbi__uint64 bits, int *len)
+{
+   int b,s,k;
+   k = stbi__bit_reverse((int) (bits & 0xffff), 16);
+   for (s=STBI__ZWIDE_BITS+1; ; ++s)
+      if (k < z->maxcode[s])
+         break;
+   if (s == 16) return -1;
+   b = (k >> (16-s)) - z->firstcode[s] + z->firstsymbol[s];
+   if (b < 0 || b >= 288 || z->size[b] != s) return -1;
+   *len = s;
+   return z->value[b];
+}
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__) || (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define STBI__ZWIDE_LITTLE_ENDIAN
+#endif
+
+static stbi__uint64 stbi__zwide_load64(const stbi_uc *p)
+{
+#ifdef STBI__ZWIDE_LITTLE_ENDIAN
+   stbi__uint64 v;
+   memcpy(&v, p, 8);
+   return v;
+#else
+   stbi__uint64 v = 0;
+   int i;
+   for (i=7; i >= 0; --i)
+      v = (v << 8) | p[i];
+   return v;
+#endif
+}
+
+// tops bits up to at least 56; past the end of the input it shifts in zeros like stbi__zget8, counted in phantom
+#define STBI__ZWIDE_REFILL() \
+   if (in_end - in >= 8) { \
+      bits |= stbi__zwide_load64(in) << nbits; \
+      in += (63 - nbits) >> 3; \
+      nbits |= 56; \
+   } else { \
+      while (nbits <= 56) { \
+         if (in < in_end) bits |= (stbi__uint64) *in++ << nbits; else ++phantom; \
+         nbits += 8; \
+      } \
+   }
+
+#define STBI__ZWIDE_CONSUME(n)  (bits >>= (n), nbits -= (n))
+
+static int stbi__parse_huffman_block_wide(stbi__zbuf *a, const stbi__zwide *w)
+{
+   stbi__uint64 bits = a->code_buffer;
+   int nbits = a->num_bits;
+   int phantom = 0;
+   stbi_uc *in = a->zbuffer, *in_end = a->zbuffer_end;
+   char *zout = a->zout, *zout_end = a->zout_end;
+   int result = 1, n;
+   for(;;) {
+      stbi__uint32 e, d;
+      int length, dist, kind;
+#ifndef STBI_NO_THREADS
+      if (a->zprogress && zout >= a->zpublish_next) stbi__zpublish(a, zout);
+#endif
+      // 56 bits cover the longest length code, its extra bits, distance code and extra bits (48)
+      STBI__ZWIDE_REFILL();
+      e = w->litlen[bits & STBI__ZWIDE_MASK];
+      if (!e) {
+         int sym = stbi__zwide_slow(&a->z_length, bits, &n);
+         e = sym < 0 ? 0 : stbi__zwide_litlen_entry(sym, n);
+         if (!e) { result = stbi__err("bad huffman code","Corrupt PNG"); break; }
+      }
+      STBI__ZWIDE_CONSUME(e & 255);
+      kind = (e >> 8) & 3;
+      if (kind != STBI__ZWIDE_len) {
+         // kind is the literal count
+         if (zout_end - zout < kind) {
+            if (!stbi__zexpand(a, zout, kind)) { result = 0; break; }
+            zout = a->zout; zout_end = a->zout_end;
+         }
+         zout[0] = (char) (e >> 16);
+         if (kind == STBI__ZWIDE_lit2) zout[1] = (char) (e >> 24);
+         zout += kind;
+         continue;
+      }
+      length = e >> 16;
+      if (length == 0) break; // end of block
+      n = (e >> 10) & 63;
+      length += (int) (bits & ((1u << n) - 1));
+      STBI__ZWIDE_CONSUME(n);
+
+      d = w->dist[bits & STBI__ZWIDE_MASK];
+      if (!d) {
+         int sym = stbi__zwide_slow(&a->z_distance, bits, &n);
+         d = sym < 0 ? 0 : stbi__zwide_dist_entry(sym, n);
+         if (!d) { result = stbi__err("bad huffman code","Corrupt PNG"); break; }
+      }
+      STBI__ZWIDE_CONSUME(d & 255);
+      n = (d >> 8) & 255;
+      dist = (int) (d >> 16) + (int) (bits & ((1u << n) - 1));
+      STBI__ZWIDE_CONSUME(n);
+      if (zout - a->zout_start < dist) { result = stbi__err("bad dist","Corrupt PNG"); break; }
+
+      if (zout_end - zout < length + 7) {
+         if (zout_end - zout < length) {
+            if (!stbi__zexpand(a, zout, length)) { result = 0; break; }
+            zout = a->zout; zout_end = a->zout_end;
+         }
+         if (zout_end - zout < length + 7) {
+            // no room to overshoot, the end of a fixed size buffer
+            const char *p = zout - dist;
+            do *zout++ = *p++; while (--length);
+            continue;
+         }
+      }
+      if (dist >= 8) {
+         // 8 byte chunks only ever read bytes written by an earlier chunk, and the up to 7 spare bytes
+         // past the match are overwritten by whatever comes next
+         const char *p = zout - dist;
+         char *end = zout + length;
+         do {
+            memcpy(zout, p, 8);
+            zout += 8;
+            p += 8;
+         } while (zout < end);
+         zout = end;
+      } else if (dist == 1) { // run of one byte; common in images.
+         memset(zout, zout[-1], length);
+         zout += length;
+      } else {
+         const char *p = zout - dist;
+         do *zout++ = *p++; while (--length);
+      }
+   }
+
+   // whole bytes in the buffer go back to the input so the byte-wise code can carry on, zeros first
+   n = nbits >> 3;
+   in -= n > phantom ? n - phantom : 0;
+   nbits &= 7;
+   a->zbuffer = in;
+   a->code_buffer = (stbi__uint32) (bits & ((1u << nbits) - 1));
+   a->num_bits = nbits;
+   a->zout = zout;
+   return result;
+}
+
 static int stbi__compute_huffman_codes(stbi__zbuf *a)
 {
    static const stbi_uc length_dezigzag[19] = { 16,17,18,0,8,7,9,6,10,5,11,4,12,3,13,2,14,1,15 };
@@ -4137,13 +5224,9 @@ Init algorithm:
 }
 */
 
-static int stbi__parse_zlib(stbi__zbuf *a, int parse_header)
+static int stbi__parse_zlib_blocks(stbi__zbuf *a, stbi__zwide *wide)
 {
    int final, type;
-   if (parse_header)
-      if (!stbi__parse_zlib_header(a)) return 0;
-   a->num_bits = 0;
-   a->code_buffer = 0;
    do {
       final = stbi__zreceive(a,1);
       type = stbi__zreceive(a,2);
@@ -4159,21 +5242,66 @@ static int stbi__parse_zlib(stbi__zbuf *a, int parse_header)
          } else {
             if (!stbi__compute_huffman_codes(a)) return 0;
          }
-         if (!stbi__parse_huffman_block(a)) return 0;
+         if (wide) {
+            stbi__zwide_build(wide, &a->z_length, &a->z_distance);
+            if (!stbi__parse_huffman_block_wide(a, wide)) return 0;
+         } else {
+            if (!stbi__parse_huffman_block(a)) return 0;
+         }
       }
+#ifndef STBI_NO_THREADS
+      if (a->zprogress) stbi__zpublish(a, a->zout);
+#endif
    } while (!final);
    return 1;
 }
 
+static int stbi__parse_zlib(stbi__zbuf *a, int parse_header)
+{
+   stbi__zwide *wide = NULL;
+   int result;
+   if (parse_header)
+      if (!stbi__parse_zlib_header(a)) return 0;
+   a->num_bits = 0;
+   a->code_buffer = 0;
+   // building the tables costs more than a few hundred bytes of input take to decode
+   if (!stbi__zlib_reference && a->zbuffer_end - a->zbuffer >= 256) {
+      wide = (stbi__zwide *) stbi__malloc(sizeof(*wide));
+      if (wide == NULL) return stbi__err("outofmem", "Out of memory");
+   }
+   result = stbi__parse_zlib_blocks(a, wide);
+   STBI_FREE(wide);
+   return result;
+}
+
 static int stbi__do_zlib(stbi__zbuf *a, char *obuf, int olen, int exp, int parse_header)
 {
    a->zout_start = obuf;
    a->zout       = obuf;
    a->zout_end   = obuf + olen;
    a->z_expandable = exp;
+   a->z_overflow = 0;
+   a->zprogress  = NULL;
+
+   return stbi__parse_zlib(a, parse_header);
+}
+
+#ifndef STBI_NO_THREADS
+// inflates into the fixed size obuf, storing the count of bytes done in progress as it goes so another
+// thread can consume the output while it is still being produced
+static int stbi__do_zlib_published(stbi__zbuf *a, char *obuf, int olen, int parse_header, stbi__atomic *progress)
+{
+   a->zout_start = obuf;
+   a->zout       = obuf;
+   a->zout_end   = obuf + olen;
+   a->z_expandable = 0;
+   a->z_overflow = 0;
+   a->zprogress  = progress;
+   a->zpublish_next = obuf;
 
    return stbi__parse_zlib(a, parse_header);
 }
+#endif
 
 STBIDEF char *stbi_zlib_decode_malloc_guesssize(const char *buffer, int len, int initial_size, int *outlen)
 {
@@ -4326,35 +5454,133 @@ static int stbi__paeth(int a, int b, int c)
 
 static const stbi_uc stbi__depth_scale_table[9] = { 0, 0xff, 0x55, 0, 0x11, 0,0,0, 0x01 };
 
-// create the png data from post-deflated data
-static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 raw_len, int out_n, stbi__uint32 x, stbi__uint32 y, int depth, int color)
+#ifdef STBI_SSE2
+// SIMD unfiltering for 3 and 4 byte pixels (8-bit RGB/RGBA): Sub/Avg/Paeth still depend on the pixel
+// to the left, so they run a pixel per step instead of a byte per step; Up has no such dependency
+// and does 16 bytes at a time for any pixel size
+// n is 4, or 3 for the last pixel of an RGB row; the others move a spare byte that the next pixel overwrites
+static __m128i stbi__png_load_pixel(const stbi_uc *p, int n)
 {
-   int bytes = (depth == 16? 2 : 1);
-   stbi__context *s = a->s;
-   stbi__uint32 i,j,stride = x*out_n*bytes;
-   stbi__uint32 img_len, img_width_bytes;
-   int k;
-   int img_n = s->img_n; // copy it into a local for later
+   int v = 0;
+   if (n == 4) memcpy(&v, p, 4); else memcpy(&v, p, 3);
+   return _mm_cvtsi32_si128(v);
+}
 
-   int output_bytes = out_n*bytes;
-   int filter_bytes = img_n*bytes;
-   int width = x;
+static void stbi__png_store_pixel(stbi_uc *p, __m128i v, int n)
+{
+   int w = _mm_cvtsi128_si32(v);
+   if (n == 4) memcpy(p, &w, 4); else memcpy(p, &w, 3);
+}
 
-   STBI_ASSERT(out_n == s->img_n || out_n == s->img_n+1);
-   a->out = (stbi_uc *) stbi__malloc_mad3(x, y, output_bytes, 0); // extra bytes to write off the end into
-   if (!a->out) return stbi__err("outofmem", "Out of memory");
+// cur/prior/raw point past the first pixel of the row, nk bytes remain; returns 0 if not handled
+static int stbi__png_unfilter_simd(int filter, stbi_uc *cur, stbi_uc *prior, stbi_uc *raw, int nk, int bpp)
+{
+   __m128i zero = _mm_setzero_si128();
+   __m128i a, b, c;
+   int k = 0;
+   if (filter == STBI__F_up) {
+      for (; k+16 <= nk; k += 16)
+         _mm_storeu_si128((__m128i *) (cur+k), _mm_add_epi8(_mm_loadu_si128((__m128i *) (raw+k)), _mm_loadu_si128((__m128i *) (prior+k))));
+      for (; k < nk; ++k)
+         cur[k] = STBI__BYTECAST(raw[k] + prior[k]);
+      return 1;
+   }
+   if (bpp != 3 && bpp != 4) return 0;
+   switch (filter) {
+      case STBI__F_sub:
+         a = stbi__png_load_pixel(cur - bpp, bpp);
+         for (; k < nk; k += bpp) {
+            int n = k+4 <= nk ? 4 : bpp;
+            a = _mm_add_epi8(a, stbi__png_load_pixel(raw+k, n));
+            stbi__png_store_pixel(cur+k, a, n);
+         }
+         return 1;
+      case STBI__F_avg:
+         a = stbi__png_load_pixel(cur - bpp, bpp);
+         for (; k < nk; k += bpp) {
+            // _mm_avg_epu8 rounds up, png rounds down
+            int n = k+4 <= nk ? 4 : bpp;
+            __m128i avg;
+            b = stbi__png_load_pixel(prior+k, n);
+            avg = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), _mm_set1_epi8(1)));
+            a = _mm_add_epi8(avg, stbi__png_load_pixel(raw+k, n));
+            stbi__png_store_pixel(cur+k, a, n);
+         }
+         return 1;
+      case STBI__F_paeth:
+         a = _mm_unpacklo_epi8(stbi__png_load_pixel(cur - bpp, bpp), zero);
+         c = _mm_unpacklo_epi8(stbi__png_load_pixel(prior - bpp, bpp), zero);
+         for (; k < nk; k += bpp) {
+            int n = k+4 <= nk ? 4 : bpp;
+            __m128i pa, pb, pc, smallest, nearest, d;
+            b = _mm_unpacklo_epi8(stbi__png_load_pixel(prior+k, n), zero);
+            // pa = |b-c|, pb = |a-c|, pc = |a+b-2c|, ties prefer a then b like stbi__paeth
+            pa = _mm_sub_epi16(b, c);
+            pb = _mm_sub_epi16(a, c);
+            pc = _mm_add_epi16(pa, pb);
+            pa = _mm_max_epi16(pa, _mm_sub_epi16(zero, pa));
+            pb = _mm_max_epi16(pb, _mm_sub_epi16(zero, pb));
+            pc = _mm_max_epi16(pc, _mm_sub_epi16(zero, pc));
+            smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+            nearest = c;
+            d = _mm_cmpeq_epi16(pb, smallest);
+            nearest = _mm_or_si128(_mm_and_si128(d, b), _mm_andnot_si128(d, nearest));
+            d = _mm_cmpeq_epi16(pa, smallest);
+            nearest = _mm_or_si128(_mm_and_si128(d, a), _mm_andnot_si128(d, nearest));
+            d = _mm_add_epi8(_mm_packus_epi16(nearest, zero), stbi__png_load_pixel(raw+k, n));
+            stbi__png_store_pixel(cur+k, d, n);
+            a = _mm_unpacklo_epi8(d, zero);
+            c = b;
+         }
+         return 1;
+   }
+   return 0;
+}
+#endif
 
+// checks shared by every way of building a (sub)image from post-deflated data
+static int stbi__png_check_raw(int img_n, stbi__uint32 raw_len, stbi__uint32 x, stbi__uint32 y, int depth, stbi__uint32 *img_len)
+{
+   stbi__uint32 img_width_bytes;
    if (!stbi__mad3sizes_valid(img_n, x, depth, 7)) return stbi__err("too large", "Corrupt PNG");
    img_width_bytes = (((img_n * x * depth) + 7) >> 3);
-   img_len = (img_width_bytes + 1) * y;
+   *img_len = (img_width_bytes + 1) * y;
 
    // we used to check for exact match between raw_len and img_len on non-interlaced PNGs,
    // but issue #276 reported a PNG in the wild that had extra data at the end (all zeros),
    // so just check for raw_len < img_len always.
-   if (raw_len < img_len) return stbi__err("not enough pixels","Corrupt PNG");
+   if (raw_len < *img_len) return stbi__err("not enough pixels","Corrupt PNG");
+   return 1;
+}
 
-   for (j=0; j < y; ++j) {
-      stbi_uc *cur = a->out + stride*j;
+// unfilter rows [j0,j1) into out; raw points at the filter byte of row j0 and row j0-1 must already be
+// unfiltered. rows below 8 bits stay packed at the right end of their output row and 16-bit rows
+// stay big-endian, stbi__png_expand_rows finishes both once the next row no longer needs them
+// where row j of a y row image goes, the rows run bottom-up when flipping on load
+static stbi_uc *stbi__png_row(stbi_uc *out, stbi__uint32 stride, stbi__uint32 y, stbi__uint32 j, int flip)
+{
+   return out + (size_t) stride * (flip ? y-1-j : j);
+}
+
+static int stbi__png_unfilter_rows(stbi_uc *out, stbi_uc *raw, int img_n, int out_n, stbi__uint32 x, stbi__uint32 y, stbi__uint32 j0, stbi__uint32 j1, int depth, int flip)
+{
+   int bytes = (depth == 16? 2 : 1);
+   stbi__uint32 i,j,stride = x*out_n*bytes;
+   stbi__uint32 img_width_bytes = (((img_n * x * depth) + 7) >> 3);
+   int k;
+
+   int output_bytes = out_n*bytes;
+   int filter_bytes = img_n*bytes;
+   int width = x;
+#ifdef STBI_SSE2
+   int simd = stbi__sse2_available();
+#endif
+
+   STBI_ASSERT(out_n == img_n || out_n == img_n+1);
+
+   for (j=j0; j < j1; ++j) {
+      stbi_uc *row = stbi__png_row(out, stride, y, j, flip);
+      stbi_uc *cur = row;
       stbi_uc *prior;
       int filter = *raw++;
 
@@ -4367,7 +5593,8 @@ static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 r
          filter_bytes = 1;
          width = img_width_bytes;
       }
-      prior = cur - stride; // bugfix: need to compute this after 'cur +=' computation above
+      // bugfix: need to compute this after 'cur +=' computation above. the first row never reads it
+      prior = j ? cur + (stbi__png_row(out, stride, y, j-1, flip) - row) : cur;
 
       // if first row, use special filter that doesn't sample previous row
       if (j == 0) filter = first_row_filter[filter];
@@ -4408,6 +5635,12 @@ static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 r
       // this is a little gross, so that we don't switch per-pixel or per-component
       if (depth < 8 || img_n == out_n) {
          int nk = (width - 1)*filter_bytes;
+#ifdef STBI_SSE2
+         if (simd && stbi__png_unfilter_simd(filter, cur, prior, raw, nk, filter_bytes)) {
+            raw += nk;
+            continue;
+         }
+#endif
          #define STBI__CASE(f) \
              case f:     \
                 for (k=0; k < nk; ++k)
@@ -4443,21 +5676,29 @@ static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 r
          // the loop above sets the high byte of the pixels' alpha, but for
          // 16 bit png files we also need the low byte set. we'll do that here.
          if (depth == 16) {
-            cur = a->out + stride*j; // start at the beginning of the row again
+            cur = row; // start at the beginning of the row again
             for (i=0; i < x; ++i,cur+=output_bytes) {
                cur[filter_bytes+1] = 255;
             }
          }
       }
    }
+   return 1;
+}
 
-   // we make a separate pass to expand bits to pixels; for performance,
-   // this could run two scanlines behind the above code, so it won't
-   // intefere with filtering but will still be in the cache.
+// expand bits to pixels / byteswap 16-bit samples for rows [j0,j1). rows are independent here, but
+// row j can only be expanded once row j+1 is unfiltered
+static void stbi__png_expand_rows(stbi_uc *out, int img_n, int out_n, stbi__uint32 x, stbi__uint32 y, stbi__uint32 j0, stbi__uint32 j1, int depth, int color, int flip)
+{
+   stbi__uint32 i,j;
+   int k;
    if (depth < 8) {
-      for (j=0; j < y; ++j) {
-         stbi_uc *cur = a->out + stride*j;
-         stbi_uc *in  = a->out + stride*j + x*out_n - img_width_bytes;
+      stbi__uint32 stride = x*out_n;
+      stbi__uint32 img_width_bytes = (((img_n * x * depth) + 7) >> 3);
+      for (j=j0; j < j1; ++j) {
+         stbi_uc *row = stbi__png_row(out, stride, y, j, flip);
+         stbi_uc *cur = row;
+         stbi_uc *in  = row + x*out_n - img_width_bytes;
          // unpack 1/2/4-bit into a 8-bit buffer. allows us to keep the common 8-bit path optimal at minimal cost for 1/2/4-bit
          // png guarante byte alignment, if width is not multiple of 8/4/2 we'll decode dummy trailing data that will be skipped in the later loop
          stbi_uc scale = (color == 0) ? stbi__depth_scale_table[depth] : 1; // scale grayscale values to 0..255 range
@@ -4506,7 +5747,7 @@ static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 r
          if (img_n != out_n) {
             int q;
             // insert alpha = 255
-            cur = a->out + stride*j;
+            cur = row;
             if (img_n == 1) {
                for (q=x-1; q >= 0; --q) {
                   cur[q*2+1] = 255;
@@ -4527,61 +5768,234 @@ static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 r
       // force the image data from big-endian to platform-native.
       // this is done in a separate pass due to the decoding relying
       // on the data being untouched, but could probably be done
-      // per-line during decode if care is taken.
-      stbi_uc *cur = a->out;
+      // per-line during decode if care is taken. rows [j0,j1) are contiguous either way up
+      stbi_uc *cur = out + (size_t) x*out_n*2*(flip ? y-j1 : j0);
       stbi__uint16 *cur16 = (stbi__uint16*)cur;
 
-      for(i=0; i < x*y*out_n; ++i,cur16++,cur+=2) {
+      for(i=0; i < x*(j1-j0)*out_n; ++i,cur16++,cur+=2) {
          *cur16 = (cur[0] << 8) | cur[1];
       }
    }
+}
+
+#define STBI__PNG_EXPAND_ROWS 64
+
+typedef struct
+{
+   stbi_uc *out;
+   int img_n, out_n, depth, color, flip;
+   stbi__uint32 x, y;
+} stbi__png_expand_job;
+
+static void stbi__png_expand_task(void *user, int index)
+{
+   stbi__png_expand_job *e = (stbi__png_expand_job *) user;
+   stbi__uint32 j0 = (stbi__uint32) index * STBI__PNG_EXPAND_ROWS;
+   stbi__uint32 j1 = j0 + STBI__PNG_EXPAND_ROWS < e->y ? j0 + STBI__PNG_EXPAND_ROWS : e->y;
+   stbi__png_expand_rows(e->out, e->img_n, e->out_n, e->x, e->y, j0, j1, e->depth, e->color, e->flip);
+}
+
+// expands a whole unfiltered image, split into row bands over the parallel-for when there is one
+static void stbi__png_expand_image(stbi_uc *out, int img_n, int out_n, stbi__uint32 x, stbi__uint32 y, int depth, int color, int flip)
+{
+   stbi__png_expand_job e;
+   if (depth == 8) return;
+   e.out = out; e.img_n = img_n; e.out_n = out_n; e.depth = depth; e.color = color; e.x = x; e.y = y; e.flip = flip;
+   stbi__parallel(stbi__png_expand_task, &e, (int) ((y + STBI__PNG_EXPAND_ROWS - 1) / STBI__PNG_EXPAND_ROWS));
+}
+
+// create the png data from post-deflated data
+static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 raw_len, int out_n, stbi__uint32 x, stbi__uint32 y, int depth, int color)
+{
+   int bytes = (depth == 16? 2 : 1);
+   stbi__context *s = a->s;
+   stbi__uint32 img_len;
+   int img_n = s->img_n; // copy it into a local for later
 
+   STBI_ASSERT(out_n == s->img_n || out_n == s->img_n+1);
+   a->out = (stbi_uc *) stbi__malloc_mad3(x, y, out_n*bytes, 0); // extra bytes to write off the end into
+   if (!a->out) return stbi__err("outofmem", "Out of memory");
+   if (!stbi__png_check_raw(img_n, raw_len, x, y, depth, &img_len)) return 0;
+   if (!stbi__png_unfilter_rows(a->out, raw, img_n, out_n, x, y, 0, y, depth, s->flip_vertically)) return 0;
+
+   // we make a separate pass to expand bits to pixels; for performance,
+   // this could run two scanlines behind the above code, so it won't
+   // intefere with filtering but will still be in the cache.
+   stbi__png_expand_image(a->out, img_n, out_n, x, y, depth, color, s->flip_vertically);
    return 1;
 }
 
+// Adam7: the seven passes are consecutive sub-images of the inflated data, independent of each other
+// and scattered to disjoint pixels of the final image, so each one is a task of its own
+typedef struct
+{
+   stbi__png *a;
+   stbi_uc *final;
+   stbi_uc *raw[7];
+   stbi__uint32 raw_len[7];
+   int out_n, depth, color;
+   int ok[7];
+} stbi__png_adam7;
+
+static const int stbi__adam7_xorig[] = { 0,4,0,2,0,1,0 };
+static const int stbi__adam7_yorig[] = { 0,0,4,0,2,0,1 };
+static const int stbi__adam7_xspc[]  = { 8,8,4,4,2,2,1 };
+static const int stbi__adam7_yspc[]  = { 8,8,8,4,4,2,2 };
+
+static void stbi__png_adam7_pass(void *user, int p)
+{
+   stbi__png_adam7 *d = (stbi__png_adam7 *) user;
+   stbi__context *s = d->a->s;
+   int bytes = (d->depth == 16 ? 2 : 1);
+   int out_bytes = d->out_n * bytes;
+   stbi__uint32 img_len;
+   stbi_uc *out;
+   int i,j,x,y;
+   // pass1_x[4] = 0, pass1_x[5] = 1, pass1_x[12] = 1
+   x = (s->img_x - stbi__adam7_xorig[p] + stbi__adam7_xspc[p]-1) / stbi__adam7_xspc[p];
+   y = (s->img_y - stbi__adam7_yorig[p] + stbi__adam7_yspc[p]-1) / stbi__adam7_yspc[p];
+   d->ok[p] = 1;
+   if (!x || !y) return;
+   d->ok[p] = 0;
+   if (!stbi__png_check_raw(s->img_n, d->raw_len[p], x, y, d->depth, &img_len)) return;
+   out = (stbi_uc *) stbi__malloc_mad3(x, y, out_bytes, 0);
+   if (!out) { stbi__err("outofmem", "Out of memory"); return; }
+   if (!stbi__png_unfilter_rows(out, d->raw[p], s->img_n, d->out_n, x, y, 0, y, d->depth, 0)) { STBI_FREE(out); return; }
+   stbi__png_expand_rows(out, s->img_n, d->out_n, x, y, 0, y, d->depth, d->color, 0);
+   for (j=0; j < y; ++j) {
+      for (i=0; i < x; ++i) {
+         int out_y = j*stbi__adam7_yspc[p]+stbi__adam7_yorig[p];
+         if (s->flip_vertically) out_y = s->img_y-1-out_y;
+         int out_x = i*stbi__adam7_xspc[p]+stbi__adam7_xorig[p];
+         memcpy(d->final + out_y*s->img_x*out_bytes + out_x*out_bytes,
+                out + (j*x+i)*out_bytes, out_bytes);
+      }
+   }
+   STBI_FREE(out);
+   d->ok[p] = 1;
+}
+
 static int stbi__create_png_image(stbi__png *a, stbi_uc *image_data, stbi__uint32 image_data_len, int out_n, int depth, int color, int interlaced)
 {
    int bytes = (depth == 16 ? 2 : 1);
    int out_bytes = out_n * bytes;
-   stbi_uc *final;
+   stbi__png_adam7 d;
    int p;
    if (!interlaced)
       return stbi__create_png_image_raw(a, image_data, image_data_len, out_n, a->s->img_x, a->s->img_y, depth, color);
 
    // de-interlacing
-   final = (stbi_uc *) stbi__malloc_mad3(a->s->img_x, a->s->img_y, out_bytes, 0);
+   d.a = a;
+   d.out_n = out_n;
+   d.depth = depth;
+   d.color = color;
+   d.final = (stbi_uc *) stbi__malloc_mad3(a->s->img_x, a->s->img_y, out_bytes, 0);
+   if (!d.final) return stbi__err("outofmem", "Out of memory");
+   // where each pass starts in the inflated data
    for (p=0; p < 7; ++p) {
-      int xorig[] = { 0,4,0,2,0,1,0 };
-      int yorig[] = { 0,0,4,0,2,0,1 };
-      int xspc[]  = { 8,8,4,4,2,2,1 };
-      int yspc[]  = { 8,8,8,4,4,2,2 };
-      int i,j,x,y;
-      // pass1_x[4] = 0, pass1_x[5] = 1, pass1_x[12] = 1
-      x = (a->s->img_x - xorig[p] + xspc[p]-1) / xspc[p];
-      y = (a->s->img_y - yorig[p] + yspc[p]-1) / yspc[p];
-      if (x && y) {
-         stbi__uint32 img_len = ((((a->s->img_n * x * depth) + 7) >> 3) + 1) * y;
-         if (!stbi__create_png_image_raw(a, image_data, image_data_len, out_n, x, y, depth, color)) {
-            STBI_FREE(final);
-            return 0;
-         }
-         for (j=0; j < y; ++j) {
-            for (i=0; i < x; ++i) {
-               int out_y = j*yspc[p]+yorig[p];
-               int out_x = i*xspc[p]+xorig[p];
-               memcpy(final + out_y*a->s->img_x*out_bytes + out_x*out_bytes,
-                      a->out + (j*x+i)*out_bytes, out_bytes);
-            }
-         }
-         STBI_FREE(a->out);
-         image_data += img_len;
-         image_data_len -= img_len;
+      stbi__uint32 x = (a->s->img_x - stbi__adam7_xorig[p] + stbi__adam7_xspc[p]-1) / stbi__adam7_xspc[p];
+      stbi__uint32 y = (a->s->img_y - stbi__adam7_yorig[p] + stbi__adam7_yspc[p]-1) / stbi__adam7_yspc[p];
+      stbi__uint32 img_len = (x && y) ? ((((a->s->img_n * x * depth) + 7) >> 3) + 1) * y : 0;
+      d.raw[p] = image_data;
+      d.raw_len[p] = image_data_len;
+      if (img_len > image_data_len) img_len = image_data_len; // that pass reports "not enough pixels"
+      image_data += img_len;
+      image_data_len -= img_len;
+   }
+   stbi__parallel(stbi__png_adam7_pass, &d, 7);
+   for (p=0; p < 7; ++p) {
+      if (!d.ok[p]) {
+         STBI_FREE(d.final);
+         return 0;
+      }
+   }
+   a->out = d.final;
+
+   return 1;
+}
+
+#ifndef STBI_NO_THREADS
+// non-interlaced images with a parallel-for: one task inflates straight into a buffer of the exact
+// size while the other unfilters every row whose bytes have arrived, then the expansion runs in bands
+typedef struct
+{
+   stbi__png *a;
+   stbi__zbuf z;
+   stbi_uc *raw;
+   stbi__uint32 img_len, row_len, y;
+   int img_n, out_n, depth, parse_header;
+   stbi__atomic roles;
+   stbi__atomic progress;
+   // 0 while inflating, 1 once it succeeded, -1 if it failed
+   stbi__atomic inflated;
+   int unfiltered;
+} stbi__png_pipeline;
+
+static void stbi__png_pipeline_task(void *user, int index)
+{
+   stbi__png_pipeline *p = (stbi__png_pipeline *) user;
+   stbi__uint32 j = 0;
+   STBI_NOTUSED(index);
+   // the first task to start inflates, so a parallel-for that runs the tasks one after the other in any
+   // order still finishes: the unfilter side then simply finds everything inflated already
+   if (stbi__atomic_add(&p->roles, 1) == 0) {
+      int ok = stbi__do_zlib_published(&p->z, (char *) p->raw, (int) p->img_len, p->parse_header, &p->progress);
+      // data past the image is ignored, like the serial path does
+      if (!ok && p->z.z_overflow) ok = 1;
+      if (ok && (stbi__uint32) (p->z.zout - p->z.zout_start) < p->img_len) ok = stbi__err("not enough pixels","Corrupt PNG");
+      stbi__atomic_store(&p->progress, (long) (p->z.zout - p->z.zout_start));
+      stbi__atomic_store(&p->inflated, ok ? 1 : -1);
+      return;
+   }
+   p->unfiltered = 0;
+   while (j < p->y) {
+      long inflated = stbi__atomic_load(&p->inflated);
+      stbi__uint32 rows = (stbi__uint32) stbi__atomic_load(&p->progress) / p->row_len;
+      if (rows > p->y) rows = p->y;
+      if (rows > j) {
+         if (!stbi__png_unfilter_rows(p->a->out, p->raw + j * p->row_len, p->img_n, p->out_n, p->a->s->img_x, p->y, j, rows, p->depth, p->a->s->flip_vertically)) return;
+         j = rows;
+      } else if (inflated == 0) {
+         stbi__yield();
+      } else {
+         return; // failed, or the stream had fewer rows
       }
    }
-   a->out = final;
+   p->unfiltered = 1;
+}
 
+static int stbi__create_png_image_pipelined(stbi__png *a, stbi__uint32 idata_len, int parse_header, int out_n, int depth, int color)
+{
+   int bytes = (depth == 16 ? 2 : 1);
+   stbi__context *s = a->s;
+   stbi__png_pipeline p;
+   int ok;
+   memset(&p, 0, sizeof(p));
+   p.a = a;
+   p.img_n = s->img_n;
+   p.out_n = out_n;
+   p.depth = depth;
+   p.y = s->img_y;
+   p.parse_header = parse_header;
+   if (!stbi__mad3sizes_valid(s->img_n, s->img_x, depth, 7)) return stbi__err("too large", "Corrupt PNG");
+   p.row_len = (((s->img_n * s->img_x * depth) + 7) >> 3) + 1;
+   p.img_len = p.row_len * s->img_y;
+   p.z.zbuffer = a->idata;
+   p.z.zbuffer_end = a->idata + idata_len;
+   p.raw = (stbi_uc *) stbi__malloc(p.img_len);
+   a->out = (stbi_uc *) stbi__malloc_mad3(s->img_x, s->img_y, out_n*bytes, 0);
+   if (!p.raw || !a->out) {
+      STBI_FREE(p.raw);
+      return stbi__err("outofmem", "Out of memory");
+   }
+   stbi__parallel_run(stbi__parallel_user, stbi__png_pipeline_task, &p, 2);
+   ok = stbi__atomic_load(&p.inflated) > 0 && p.unfiltered;
+   STBI_FREE(p.raw);
+   if (!ok) return 0;
+   stbi__png_expand_image(a->out, s->img_n, out_n, s->img_x, s->img_y, depth, color, s->flip_vertically);
    return 1;
 }
+#endif
 
 static int stbi__compute_transparency(stbi__png *z, stbi_uc tc[3], int out_n)
 {
@@ -4670,9 +6084,6 @@ static int stbi__expand_png_palette(stbi__png *a, stbi_uc *palette, int len, int
    return 1;
 }
 
-static int stbi__unpremultiply_on_load = 0;
-static int stbi__de_iphone_flag = 0;
-
 STBIDEF void stbi_set_unpremultiply_on_load(int flag_true_if_should_unpremultiply)
 {
    stbi__unpremultiply_on_load = flag_true_if_should_unpremultiply;
@@ -4698,7 +6109,7 @@ static void stbi__de_iphone(stbi__png *z)
       }
    } else {
       STBI_ASSERT(s->img_out_n == 4);
-      if (stbi__unpremultiply_on_load) {
+      if (s->unpremultiply) {
          // convert bgr to rgb and unpremultiply
          for (i=0; i < pixel_count; ++i) {
             stbi_uc a = p[3];
@@ -4843,17 +6254,26 @@ static int stbi__parse_png_file(stbi__png *z, int scan, int req_comp)
             if (first) return stbi__err("first not IHDR", "Corrupt PNG");
             if (scan != STBI__SCAN_load) return 1;
             if (z->idata == NULL) return stbi__err("no IDAT","Corrupt PNG");
-            // initial guess for decoded data size to avoid unnecessary reallocs
-            bpl = (s->img_x * z->depth + 7) / 8; // bytes per line, per component
-            raw_len = bpl * s->img_y * s->img_n /* pixels */ + s->img_y /* filter mode per row */;
-            z->expanded = (stbi_uc *) stbi_zlib_decode_malloc_guesssize_headerflag((char *) z->idata, ioff, raw_len, (int *) &raw_len, !is_iphone);
-            if (z->expanded == NULL) return 0; // zlib should set error
-            STBI_FREE(z->idata); z->idata = NULL;
             if ((req_comp == s->img_n+1 && req_comp != 3 && !pal_img_n) || has_trans)
                s->img_out_n = s->img_n+1;
             else
                s->img_out_n = s->img_n;
-            if (!stbi__create_png_image(z, z->expanded, raw_len, s->img_out_n, z->depth, color, interlace)) return 0;
+#ifndef STBI_NO_THREADS
+            if (stbi__parallel_run && !interlace) {
+               // unfilter rows while the rest of the image is still being inflated
+               if (!stbi__create_png_image_pipelined(z, ioff, !is_iphone, s->img_out_n, z->depth, color)) return 0;
+               STBI_FREE(z->idata); z->idata = NULL;
+            } else
+#endif
+            {
+               // initial guess for decoded data size to avoid unnecessary reallocs
+               bpl = (s->img_x * z->depth + 7) / 8; // bytes per line, per component
+               raw_len = bpl * s->img_y * s->img_n /* pixels */ + s->img_y /* filter mode per row */;
+               z->expanded = (stbi_uc *) stbi_zlib_decode_malloc_guesssize_headerflag((char *) z->idata, ioff, raw_len, (int *) &raw_len, !is_iphone);
+               if (z->expanded == NULL) return 0; // zlib should set error
+               STBI_FREE(z->idata); z->idata = NULL;
+               if (!stbi__create_png_image(z, z->expanded, raw_len, s->img_out_n, z->depth, color, interlace)) return 0;
+            }
             if (has_trans) {
                if (z->depth == 16) {
                   if (!stbi__compute_transparency16(z, tc16, s->img_out_n)) return 0;
@@ -4861,7 +6281,7 @@ static int stbi__parse_png_file(stbi__png *z, int scan, int req_comp)
                   if (!stbi__compute_transparency(z, tc, s->img_out_n)) return 0;
                }
             }
-            if (is_iphone && stbi__de_iphone_flag && s->img_out_n > 2)
+            if (is_iphone && s->de_iphone && s->img_out_n > 2)
                stbi__de_iphone(z);
             if (pal_img_n) {
                // pal_img_n == 3 or 4
@@ -4911,6 +6331,7 @@ static void *stbi__do_png(stbi__png *p, int *x, int *y, int *n, int req_comp, st
          ri->bits_per_channel = p->depth;
       result = p->out;
       p->out = NULL;
+      ri->flipped = p->s->flip_vertically;
       if (req_comp && req_comp != p->s->img_out_n) {
          if (ri->bits_per_channel == 8)
             result = stbi__convert_format((unsigned char *) result, p->s->img_out_n, req_comp, p->s->img_x, p->s->img_y);
@@ -5148,7 +6569,6 @@ static void *stbi__bmp_load(stbi__context *s, int *x, int *y, int *comp, int req
    int psize=0,i,j,width;
    int flip_vertically, pad, target;
    stbi__bmp_data info;
-   STBI_NOTUSED(ri);
 
    info.all_a = 255;
    if (stbi__bmp_parse_header(s, &info) == NULL)
@@ -5156,6 +6576,11 @@ static void *stbi__bmp_load(stbi__context *s, int *x, int *y, int *comp, int req
 
    flip_vertically = ((int) s->img_y) > 0;
    s->img_y = abs((int) s->img_y);
+   // bottom-up files are then already the right way round
+   if (s->flip_vertically) {
+      flip_vertically = !flip_vertically;
+      ri->flipped = 1;
+   }
 
    mr = info.mr;
    mg = info.mg;
@@ -5478,7 +6903,6 @@ static void *stbi__tga_load(stbi__context *s, int *x, int *y, int *comp, int req
    int RLE_count = 0;
    int RLE_repeating = 0;
    int read_next_pixel = 1;
-   STBI_NOTUSED(ri);
 
    //   do a tiny bit of precessing
    if ( tga_image_type >= 8 )
@@ -5487,6 +6911,10 @@ static void *stbi__tga_load(stbi__context *s, int *x, int *y, int *comp, int req
       tga_is_RLE = 1;
    }
    tga_inverted = 1 - ((tga_inverted >> 5) & 1);
+   if (s->flip_vertically) {
+      tga_inverted = !tga_inverted;
+      ri->flipped = 1;
+   }
 
    //   If I'm paletted, then I'll use the number of bits from the palette
    if ( tga_indexed ) tga_comp = stbi__tga_get_comp(tga_palette_bits, 0, &tga_rgb16);
@@ -7009,7 +8437,7 @@ static int      stbi__pnm_test(stbi__context *s)
 static void *stbi__pnm_load(stbi__context *s, int *x, int *y, int *comp, int req_comp, stbi__result_info *ri)
 {
    stbi_uc *out;
-   STBI_NOTUSED(ri);
+   stbi__uint32 j, stride;
 
    if (!stbi__pnm_info(s, (int *)&s->img_x, (int *)&s->img_y, (int *)&s->img_n))
       return 0;
@@ -7023,7 +8451,14 @@ static void *stbi__pnm_load(stbi__context *s, int *x, int *y, int *comp, int req
 
    out = (stbi_uc *) stbi__malloc_mad3(s->img_n, s->img_x, s->img_y, 0);
    if (!out) return stbi__errpuc("outofmem", "Out of memory");
-   stbi__getn(s, out, s->img_n * s->img_x * s->img_y);
+   stride = s->img_n * s->img_x;
+   if (s->flip_vertically) {
+      for (j=0; j < s->img_y; ++j)
+         stbi__getn(s, out + (size_t) stride * (s->img_y-1-j), stride);
+      ri->flipped = 1;
+   } else {
+      stbi__getn(s, out, stride * s->img_y);
+   }
 
    if (req_comp && req_comp != s->img_n) {
       out = stbi__convert_format(out, s->img_n, req_comp, s->img_x, s->img_y);
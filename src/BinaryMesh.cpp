@@ -0,0 +1,244 @@
+#include "BinaryMesh.h"
+#include "ModelImporter.h"
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+static uint64_t AlignFileOffset(uint64_t offset)
+{
+	return (offset + MeshFileAlignment - 1) & ~(uint64_t)(MeshFileAlignment - 1);
+}
+
+static bool RangeInFile(uint64_t offset, uint64_t bytes, size_t fileSize)
+{
+	return offset <= fileSize && bytes <= fileSize - offset;
+}
+
+//bytes one attribute takes in a vertex, 0 for anything the layouts here never write
+static uint64_t AttributeBytes(uint32_t type, int32_t components)
+{
+	if (components < 1 || components > 4)
+		return 0;
+	switch (type)
+	{
+	case GL_BYTE:
+	case GL_UNSIGNED_BYTE:
+		return components;
+	case GL_SHORT:
+	case GL_UNSIGNED_SHORT:
+	case GL_HALF_FLOAT:
+		return components * 2;
+	case GL_INT:
+	case GL_UNSIGNED_INT:
+	case GL_FLOAT:
+		return components * 4;
+	case GL_INT_2_10_10_10_REV:
+	case GL_UNSIGNED_INT_2_10_10_10_REV:
+		return components == 4 ? 4 : 0;
+	}
+	return 0;
+}
+
+bool BinaryMesh::Open(const char* path)
+{
+	this->header = NULL;
+	if (!this->file.Open(path, MappedSequential))
+		return false;
+	auto size = this->file.Size();
+	auto h = (const MeshFileHeader*)this->file.Data();
+	if (size < sizeof(MeshFileHeader) || h->Magic != MeshFileMagic || h->Version != MeshFileVersion || h->HeaderSize != sizeof(MeshFileHeader))
+	{
+		this->file.Close();
+		return false;
+	}
+	//a truncated or hostile file must not send the GL upload past the end of the mapping
+	bool valid = RangeInFile(h->AttributeOffset, (uint64_t)h->AttributeCount * sizeof(MeshFileAttribute), size)
+		&& RangeInFile(h->LodOffset, (uint64_t)h->LodCount * sizeof(MeshFileLod), size)
+		&& RangeInFile(h->VertexOffset, h->VertexBytes, size)
+		&& RangeInFile(h->IndexOffset, h->IndexBytes, size)
+		&& h->VertexBytes == (uint64_t)h->VertexCount * h->Stride
+		&& h->IndexBytes == (uint64_t)h->IndexCount * sizeof(GLuint);
+	auto lods = (const MeshFileLod*)(this->file.Data() + h->LodOffset);
+	for (uint32_t i = 0; valid && i < h->LodCount; i++)
+		valid = (uint64_t)lods[i].FirstIndex + lods[i].IndexCount <= h->IndexCount;
+	//an attribute reaching past its vertex would read the next one, or past the buffer for the last
+	auto attributes = (const MeshFileAttribute*)(this->file.Data() + h->AttributeOffset);
+	for (uint32_t i = 0; valid && i < h->AttributeCount; i++)
+	{
+		auto bytes = AttributeBytes(attributes[i].Type, attributes[i].Components);
+		valid = bytes > 0 && (uint64_t)attributes[i].Offset + bytes <= h->Stride;
+	}
+	//and an index past the vertices makes the GPU read outside the mesh's part of the vertex buffer
+	auto indices = (const GLuint*)(this->file.Data() + h->IndexOffset);
+	for (uint32_t i = 0; valid && i < h->IndexCount; i++)
+		valid = indices[i] < h->VertexCount;
+	if (!valid)
+	{
+		this->file.Close();
+		return false;
+	}
+	this->header = h;
+	return true;
+}
+
+const MeshFileAttribute* BinaryMesh::Attributes() const
+{
+	return this->header ? (const MeshFileAttribute*)(this->file.Data() + this->header->AttributeOffset) : NULL;
+}
+
+const MeshFileLod* BinaryMesh::Lods() const
+{
+	return this->header ? (const MeshFileLod*)(this->file.Data() + this->header->LodOffset) : NULL;
+}
+
+const void* BinaryMesh::Vertices() const
+{
+	return this->header ? this->file.Data() + this->header->VertexOffset : NULL;
+}
+
+const GLuint* BinaryMesh::Indices() const
+{
+	return this->header ? (const GLuint*)(this->file.Data() + this->header->IndexOffset) : NULL;
+}
+
+std::vector<MeshLod> BinaryMesh::LodList() const
+{
+	std::vector<MeshLod> lods;
+	auto table = this->Lods();
+	for (uint32_t i = 0; table && i < this->header->LodCount; i++)
+	{
+		MeshLod lod;
+		lod.FirstIndex = table[i].FirstIndex;
+		lod.IndexCount = table[i].IndexCount;
+		lod.Error = table[i].Error;
+		lods.push_back(lod);
+	}
+	return lods;
+}
+
+std::vector<MeshAttribute> BinaryMesh::Layout() const
+{
+	std::vector<MeshAttribute> layout;
+	if (this->header == NULL)
+		return layout;
+	auto attributes = this->Attributes();
+	for (uint32_t i = 0; i < this->header->AttributeCount; i++)
+	{
+		MeshAttribute a;
+		a.Location = attributes[i].Location;
+		a.Components = attributes[i].Components;
+		a.Type = attributes[i].Type;
+		a.Normalized = attributes[i].Normalized ? GL_TRUE : GL_FALSE;
+		a.Integer = attributes[i].Integer ? GL_TRUE : GL_FALSE;
+		a.Offset = attributes[i].Offset;
+		layout.push_back(a);
+	}
+	return layout;
+}
+
+MeshHandle BinaryMesh::UploadTo(MeshBuffer* buffer) const
+{
+	if (this->header == NULL || buffer == NULL || (uint32_t)buffer->GetStride() != this->header->Stride)
+		return MeshHandle();
+	return buffer->Upload(this->Vertices(), (GLsizei)this->header->VertexCount, this->Indices(), (GLsizei)this->header->IndexCount);
+}
+
+static bool WriteAt(FILE* f, uint64_t offset, const void* data, size_t bytes)
+{
+	//pad with zeros up to the blob's aligned start
+	static const char zeros[MeshFileAlignment] = {};
+	auto pos = (uint64_t)ftell(f);
+	while (pos < offset)
+	{
+		auto n = (size_t)(offset - pos < MeshFileAlignment ? offset - pos : MeshFileAlignment);
+		if (fwrite(zeros, 1, n, f) != n)
+			return false;
+		pos += n;
+	}
+	return bytes == 0 || fwrite(data, 1, bytes, f) == bytes;
+}
+
+bool WriteBinaryMesh(const char* path, const BuiltMesh& mesh)
+{
+	std::vector<MeshFileLod> table;
+	for (auto& lod : mesh.Lods)
+	{
+		MeshFileLod entry = {};
+		entry.FirstIndex = lod.FirstIndex;
+		entry.IndexCount = lod.IndexCount;
+		entry.Error = lod.Error;
+		table.push_back(entry);
+	}
+	if (table.empty())
+	{
+		MeshFileLod full = {};
+		full.IndexCount = (uint32_t)mesh.Indices.size();
+		table.push_back(full);
+	}
+	std::vector<MeshFileAttribute> attributes;
+	for (auto& a : mesh.Layout)
+	{
+		MeshFileAttribute fa = {};
+		fa.Location = a.Location;
+		fa.Components = a.Components;
+		fa.Type = a.Type;
+		fa.Normalized = a.Normalized ? 1 : 0;
+		fa.Integer = a.Integer ? 1 : 0;
+		fa.Offset = a.Offset;
+		attributes.push_back(fa);
+	}
+
+	MeshFileHeader h = {};
+	h.Magic = MeshFileMagic;
+	h.Version = MeshFileVersion;
+	h.HeaderSize = sizeof(MeshFileHeader);
+	h.AttributeCount = (uint32_t)attributes.size();
+	h.Stride = (uint32_t)mesh.Stride;
+	h.VertexCount = (uint32_t)mesh.VertexCount;
+	h.IndexCount = (uint32_t)mesh.Indices.size();
+	h.LodCount = (uint32_t)table.size();
+	h.AttributeOffset = sizeof(MeshFileHeader);
+	h.LodOffset = h.AttributeOffset + attributes.size() * sizeof(MeshFileAttribute);
+	h.VertexOffset = AlignFileOffset(h.LodOffset + table.size() * sizeof(MeshFileLod));
+	h.VertexBytes = mesh.Vertices.size();
+	h.IndexOffset = AlignFileOffset(h.VertexOffset + h.VertexBytes);
+	h.IndexBytes = mesh.Indices.size() * sizeof(GLuint);
+	for (int i = 0; i < 3; i++)
+	{
+		h.BoundsMin[i] = mesh.BoundsMin[i];
+		h.BoundsMax[i] = mesh.BoundsMax[i];
+		h.PositionScale[i] = mesh.PositionScale[i];
+		h.PositionBias[i] = mesh.PositionBias[i];
+	}
+
+	auto f = fopen(path, "wb");
+	if (f == NULL)
+		return false;
+	bool ok = WriteAt(f, 0, &h, sizeof(h))
+		&& WriteAt(f, h.AttributeOffset, attributes.data(), attributes.size() * sizeof(MeshFileAttribute))
+		&& WriteAt(f, h.LodOffset, table.data(), table.size() * sizeof(MeshFileLod))
+		&& WriteAt(f, h.VertexOffset, mesh.Vertices.data(), mesh.Vertices.size())
+		&& WriteAt(f, h.IndexOffset, mesh.Indices.data(), (size_t)h.IndexBytes);
+	return fclose(f) == 0 && ok;
+}
+
+bool ConvertModelToBinaryMesh(const char* modelPath, const char* meshPath, const MeshCompression& compression, const LodSettings& lods, JobSystem* jobs)
+{
+	ModelImporter importer(jobs, compression);
+	importer.SetMergeObjects(true);
+	importer.SetLodSettings(lods);
+	if (!importer.Start(modelPath))
+		return false;
+	importer.Wait();
+	bool ok = !importer.HasFailed();
+	bool any = false;
+	ImportedMesh mesh;
+	while (importer.Poll(mesh))
+	{
+		//a merged OBJ is one mesh, glTF primitives after the first get the file index appended
+		auto path = mesh.Index == 0 ? std::string(meshPath) : std::string(meshPath) + "." + std::to_string(mesh.Index);
+		ok = WriteBinaryMesh(path.c_str(), mesh.Mesh) && ok;
+		any = true;
+	}
+	return ok && any;
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include "../include/glad/glad.h"
+#include "MappedFile.h"
+#include "MeshBuilder.h"
+#include "MeshSimplifier.h"
+#include <cstdint>
+#include <vector>
+
+//on disk layout, little endian, every blob starts on a MeshFileAlignment boundary so it can be
+//used straight out of the mapping:
+//  MeshFileHeader | MeshFileAttribute[AttributeCount] | MeshFileLod[LodCount] | vertices | indices
+
+static const uint32_t MeshFileMagic = 0x4d4c474f; // "OGLM"
+static const uint32_t MeshFileVersion = 1;
+static const uint32_t MeshFileAlignment = 64;
+
+struct MeshFileHeader
+{
+	uint32_t Magic;
+	uint32_t Version;
+	uint32_t HeaderSize;
+	uint32_t AttributeCount;
+	uint32_t Stride;
+	uint32_t VertexCount;
+	uint32_t IndexCount;
+	uint32_t LodCount;
+	uint64_t AttributeOffset;
+	uint64_t LodOffset;
+	uint64_t VertexOffset;
+	uint64_t VertexBytes;
+	uint64_t IndexOffset;
+	uint64_t IndexBytes;
+	float BoundsMin[3];
+	float BoundsMax[3];
+	float PositionScale[3];
+	float PositionBias[3];
+};
+
+struct MeshFileAttribute
+{
+	uint32_t Location;
+	int32_t Components;
+	uint32_t Type;
+	uint8_t Normalized;
+	uint8_t Integer;
+	uint16_t Reserved;
+	uint32_t Offset;
+};
+
+///one level of detail, a range of the shared index blob, LOD 0 is full detail
+struct MeshFileLod
+{
+	uint32_t FirstIndex;
+	uint32_t IndexCount;
+	///object space error of this level, 0 for the full mesh
+	float Error;
+	uint32_t Reserved;
+};
+
+///mapped binary mesh, the accessors point into the file mapping so uploading from them
+///(glBufferData/glBufferSubData) is the only copy the data ever makes
+class BinaryMesh
+{
+public:
+	bool Open(const char* path);
+	void Close() { this->file.Close(); this->header = NULL; }
+	const MeshFileHeader* Header() const { return this->header; }
+	const MeshFileAttribute* Attributes() const;
+	const MeshFileLod* Lods() const;
+	///the LOD table as MeshLod, ranges are relative to the mesh's own indices like BuiltMesh::Lods
+	std::vector<MeshLod> LodList() const;
+	const void* Vertices() const;
+	const GLuint* Indices() const;
+	std::vector<MeshAttribute> Layout() const;
+	///sub-allocates in a MeshBuffer whose layout matches, straight from the mapping
+	MeshHandle UploadTo(MeshBuffer* buffer) const;
+	///drop the mapped pages once the GPU has its copy
+	void ReleasePages() { this->file.Release(); }
+private:
+	MappedFile file;
+	const MeshFileHeader* header = NULL;
+};
+
+///writes mesh.Lods, or the whole index list as the single LOD 0 when it has none
+bool WriteBinaryMesh(const char* path, const BuiltMesh& mesh);
+class JobSystem;
+///OBJ/glTF -> ModelImporter (+ LODs) -> binary mesh file, OBJ objects are merged into one mesh
+bool ConvertModelToBinaryMesh(const char* modelPath, const char* meshPath, const MeshCompression& compression, const LodSettings& lods, JobSystem* jobs);
@@ -0,0 +1,774 @@
+#include "BlockCompression.h"
+#include "GLExtensions.h"
+#include "JobSystem.h"
+#include "MappedFile.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#define BLOCK_SSE 1
+#include <emmintrin.h>
+#endif
+
+size_t BlockBytes(BlockFormat format)
+{
+	return format == BlockBC1 || format == BlockBC4 ? 8 : 16;
+}
+
+int BlockChannels(BlockFormat format)
+{
+	static const int channels[] = { 3, 4, 1, 2 };
+	return channels[format];
+}
+
+BlockFormat ChooseBlockFormat(const unsigned char* pixels, int width, int height, int channels)
+{
+	if (channels == 1)
+		return BlockBC4;
+	if (channels == 2)
+		return BlockBC5;
+	if (channels == 4)
+	{
+		auto count = (size_t)width * height;
+		for (size_t i = 0; i < count; i++)
+		{
+			if (pixels[i * 4 + 3] != 255)
+				return BlockBC3;
+		}
+	}
+	return BlockBC1;
+}
+
+///the encoder's view of a pixel as rgba, Measure compares against the same view
+static void FetchPixel(const unsigned char* pixel, int channels, uint8_t* rgba)
+{
+	if (channels < 3)
+	{
+		rgba[0] = pixel[0];
+		rgba[1] = channels == 2 ? pixel[1] : pixel[0];
+		rgba[2] = pixel[0];
+	}
+	else
+	{
+		rgba[0] = pixel[0];
+		rgba[1] = pixel[1];
+		rgba[2] = pixel[2];
+	}
+	rgba[3] = channels == 4 ? pixel[3] : 255;
+}
+
+///16 rgba pixels of the block at (bx, by), edges clamp for sizes that are not a multiple of 4
+static void FetchBlock(const unsigned char* pixels, int width, int height, int channels, int bx, int by, uint8_t* block)
+{
+	for (int y = 0; y < 4; y++)
+	{
+		auto sy = std::min(by * 4 + y, height - 1);
+		for (int x = 0; x < 4; x++)
+		{
+			auto sx = std::min(bx * 4 + x, width - 1);
+			FetchPixel(pixels + ((size_t)sy * width + sx) * channels, channels, block + (y * 4 + x) * 4);
+		}
+	}
+}
+
+static uint16_t To565(float r, float g, float b)
+{
+	auto q = [](float v, int max) { return (int)std::min(std::max(v * max / 255.0f + 0.5f, 0.0f), (float)max); };
+	return (uint16_t)((q(r, 31) << 11) | (q(g, 63) << 5) | q(b, 31));
+}
+
+static void From565(uint16_t c, int* rgb)
+{
+	int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+	rgb[0] = (r << 3) | (r >> 2);
+	rgb[1] = (g << 2) | (g >> 4);
+	rgb[2] = (b << 3) | (b >> 2);
+}
+
+///integer palette exactly as the decoder builds it, 4 colour mode when c0 > c1
+static void ColorPalette(uint16_t c0, uint16_t c1, bool forceFourColor, int palette[4][3])
+{
+	From565(c0, palette[0]);
+	From565(c1, palette[1]);
+	for (int i = 0; i < 3; i++)
+	{
+		if (c0 > c1 || forceFourColor)
+		{
+			palette[2][i] = (2 * palette[0][i] + palette[1][i] + 1) / 3;
+			palette[3][i] = (palette[0][i] + 2 * palette[1][i] + 1) / 3;
+		}
+		else
+		{
+			palette[2][i] = (palette[0][i] + palette[1][i]) / 2;
+			palette[3][i] = 0;
+		}
+	}
+}
+
+///2 bit index per pixel into the 4 entry palette, error gets the summed squared rgb error
+static uint32_t SelectColorIndices(const float* r, const float* g, const float* b, const int palette[4][3], float* error)
+{
+	uint32_t indices = 0;
+#ifdef BLOCK_SSE
+	__m128 total = _mm_setzero_ps();
+	for (int i = 0; i < 16; i += 4)
+	{
+		auto pr = _mm_loadu_ps(r + i), pg = _mm_loadu_ps(g + i), pb = _mm_loadu_ps(b + i);
+		auto best = _mm_set1_ps(FLT_MAX);
+		auto bestIndex = _mm_setzero_si128();
+		for (int p = 0; p < 4; p++)
+		{
+			auto dr = _mm_sub_ps(pr, _mm_set1_ps((float)palette[p][0]));
+			auto dg = _mm_sub_ps(pg, _mm_set1_ps((float)palette[p][1]));
+			auto db = _mm_sub_ps(pb, _mm_set1_ps((float)palette[p][2]));
+			auto d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dr, dr), _mm_mul_ps(dg, dg)), _mm_mul_ps(db, db));
+			auto less = _mm_castps_si128(_mm_cmplt_ps(d, best));
+			best = _mm_min_ps(d, best);
+			bestIndex = _mm_or_si128(_mm_andnot_si128(less, bestIndex), _mm_and_si128(less, _mm_set1_epi32(p)));
+		}
+		total = _mm_add_ps(total, best);
+		int32_t lanes[4];
+		_mm_storeu_si128((__m128i*)lanes, bestIndex);
+		for (int k = 0; k < 4; k++)
+			indices |= (uint32_t)lanes[k] << (2 * (i + k));
+	}
+	float sums[4];
+	_mm_storeu_ps(sums, total);
+	*error = sums[0] + sums[1] + sums[2] + sums[3];
+#else
+	float total = 0.0f;
+	for (int i = 0; i < 16; i++)
+	{
+		float best = FLT_MAX;
+		int bestIndex = 0;
+		for (int p = 0; p < 4; p++)
+		{
+			float dr = r[i] - palette[p][0], dg = g[i] - palette[p][1], db = b[i] - palette[p][2];
+			float d = dr * dr + dg * dg + db * db;
+			if (d < best)
+			{
+				best = d;
+				bestIndex = p;
+			}
+		}
+		total += best;
+		indices |= (uint32_t)bestIndex << (2 * i);
+	}
+	*error = total;
+#endif
+	return indices;
+}
+
+struct ColorCandidate
+{
+	uint16_t C0;
+	uint16_t C1;
+	uint32_t Indices;
+	float Error;
+};
+
+static ColorCandidate TryColorEndpoints(const float* e0, const float* e1, const float* r, const float* g, const float* b)
+{
+	ColorCandidate c;
+	c.C0 = To565(e0[0], e0[1], e0[2]);
+	c.C1 = To565(e1[0], e1[1], e1[2]);
+	//c0 > c1 selects the 4 colour mode, the only one BC3 has
+	if (c.C0 < c.C1)
+		std::swap(c.C0, c.C1);
+	int palette[4][3];
+	ColorPalette(c.C0, c.C1, true, palette);
+	if (c.C0 == c.C1)
+	{
+		//every entry but black in 3 colour mode is c0, index 0 is right for both modes
+		c.Indices = 0;
+		c.Error = 0.0f;
+		for (int i = 0; i < 16; i++)
+		{
+			float dr = r[i] - palette[0][0], dg = g[i] - palette[0][1], db = b[i] - palette[0][2];
+			c.Error += dr * dr + dg * dg + db * db;
+		}
+		return c;
+	}
+	c.Indices = SelectColorIndices(r, g, b, palette, &c.Error);
+	return c;
+}
+
+///least squares endpoints for fixed indices, false when the system is degenerate (one index used)
+static bool RefineColorEndpoints(uint32_t indices, const float* r, const float* g, const float* b, float* e0, float* e1)
+{
+	static const float weights[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+	float aa = 0.0f, bb = 0.0f, ab = 0.0f;
+	float ax[3] = { 0.0f, 0.0f, 0.0f }, bx[3] = { 0.0f, 0.0f, 0.0f };
+	for (int i = 0; i < 16; i++)
+	{
+		float alpha = weights[(indices >> (2 * i)) & 3], beta = 1.0f - alpha;
+		aa += alpha * alpha;
+		bb += beta * beta;
+		ab += alpha * beta;
+		float x[3] = { r[i], g[i], b[i] };
+		for (int c = 0; c < 3; c++)
+		{
+			ax[c] += alpha * x[c];
+			bx[c] += beta * x[c];
+		}
+	}
+	float det = aa * bb - ab * ab;
+	if (std::fabs(det) < 1e-6f)
+		return false;
+	for (int c = 0; c < 3; c++)
+	{
+		e0[c] = std::min(std::max((bb * ax[c] - ab * bx[c]) / det, 0.0f), 255.0f);
+		e1[c] = std::min(std::max((aa * bx[c] - ab * ax[c]) / det, 0.0f), 255.0f);
+	}
+	return true;
+}
+
+///block is 16 rgba pixels, out gets the 8 byte BC1 colour block
+static void EncodeColorBlock(const uint8_t* block, BlockQuality quality, uint8_t* out)
+{
+	float r[16], g[16], b[16];
+	float mean[3] = { 0.0f, 0.0f, 0.0f }, lo[3] = { 255.0f, 255.0f, 255.0f }, hi[3] = { 0.0f, 0.0f, 0.0f };
+	for (int i = 0; i < 16; i++)
+	{
+		r[i] = block[i * 4];
+		g[i] = block[i * 4 + 1];
+		b[i] = block[i * 4 + 2];
+		float x[3] = { r[i], g[i], b[i] };
+		for (int c = 0; c < 3; c++)
+		{
+			mean[c] += x[c] / 16.0f;
+			lo[c] = std::min(lo[c], x[c]);
+			hi[c] = std::max(hi[c], x[c]);
+		}
+	}
+	float cov[6] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+	for (int i = 0; i < 16; i++)
+	{
+		float dr = r[i] - mean[0], dg = g[i] - mean[1], db = b[i] - mean[2];
+		cov[0] += dr * dr;
+		cov[1] += dr * dg;
+		cov[2] += dr * db;
+		cov[3] += dg * dg;
+		cov[4] += dg * db;
+		cov[5] += db * db;
+	}
+
+	ColorCandidate best;
+	best.Error = FLT_MAX;
+	if (quality == BlockFast || quality == BlockHigh)
+	{
+		//bounding box diagonal, flipping g/b when they fall as r rises, inset by 1/16 of the range
+		//since the extremes are rarely hit exactly
+		float e0[3] = { hi[0], hi[1], hi[2] }, e1[3] = { lo[0], lo[1], lo[2] };
+		if (cov[1] < 0.0f)
+			std::swap(e0[1], e1[1]);
+		if (cov[2] < 0.0f)
+			std::swap(e0[2], e1[2]);
+		for (int c = 0; c < 3; c++)
+		{
+			float inset = (e0[c] - e1[c]) / 16.0f;
+			e0[c] -= inset;
+			e1[c] += inset;
+		}
+		auto candidate = TryColorEndpoints(e0, e1, r, g, b);
+		if (candidate.Error < best.Error)
+			best = candidate;
+	}
+	if (quality != BlockFast)
+	{
+		//principal axis by power iteration, the endpoints are the pixels furthest along it
+		float axis[3] = { hi[0] - lo[0], hi[1] - lo[1], hi[2] - lo[2] };
+		for (int iteration = 0; iteration < 4; iteration++)
+		{
+			float x = cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2];
+			float y = cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2];
+			float z = cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2];
+			float length = std::max(std::max(std::fabs(x), std::fabs(y)), std::fabs(z));
+			if (length < 1e-6f)
+				break;
+			axis[0] = x / length;
+			axis[1] = y / length;
+			axis[2] = z / length;
+		}
+		int minIndex = 0, maxIndex = 0;
+		float minDot = FLT_MAX, maxDot = -FLT_MAX;
+		for (int i = 0; i < 16; i++)
+		{
+			float d = r[i] * axis[0] + g[i] * axis[1] + b[i] * axis[2];
+			if (d < minDot)
+			{
+				minDot = d;
+				minIndex = i;
+			}
+			if (d > maxDot)
+			{
+				maxDot = d;
+				maxIndex = i;
+			}
+		}
+		float e0[3] = { r[maxIndex], g[maxIndex], b[maxIndex] }, e1[3] = { r[minIndex], g[minIndex], b[minIndex] };
+		auto candidate = TryColorEndpoints(e0, e1, r, g, b);
+		if (candidate.Error < best.Error)
+			best = candidate;
+		int passes = quality == BlockHigh ? 3 : 1;
+		for (int pass = 0; pass < passes && best.Error > 0.0f; pass++)
+		{
+			if (!RefineColorEndpoints(best.Indices, r, g, b, e0, e1))
+				break;
+			candidate = TryColorEndpoints(e0, e1, r, g, b);
+			if (candidate.Error >= best.Error)
+				break;
+			best = candidate;
+		}
+	}
+	out[0] = (uint8_t)best.C0;
+	out[1] = (uint8_t)(best.C0 >> 8);
+	out[2] = (uint8_t)best.C1;
+	out[3] = (uint8_t)(best.C1 >> 8);
+	for (int i = 0; i < 4; i++)
+		out[4 + i] = (uint8_t)(best.Indices >> (8 * i));
+}
+
+///integer palette as the decoder builds it, 8 interpolated values when a0 > a1, else 6 plus 0 and 255
+static void ValuePalette(int a0, int a1, int* palette)
+{
+	palette[0] = a0;
+	palette[1] = a1;
+	if (a0 > a1)
+	{
+		for (int i = 2; i < 8; i++)
+			palette[i] = ((8 - i) * a0 + (i - 1) * a1 + 3) / 7;
+	}
+	else
+	{
+		for (int i = 2; i < 6; i++)
+			palette[i] = ((6 - i) * a0 + (i - 1) * a1 + 2) / 5;
+		palette[6] = 0;
+		palette[7] = 255;
+	}
+}
+
+struct ValueCandidate
+{
+	int A0;
+	int A1;
+	uint64_t Indices;
+	int Error;
+};
+
+static ValueCandidate TryValueEndpoints(int a0, int a1, const uint8_t* values)
+{
+	ValueCandidate c;
+	c.A0 = a0;
+	c.A1 = a1;
+	c.Indices = 0;
+	c.Error = 0;
+	int palette[8];
+	ValuePalette(a0, a1, palette);
+	for (int i = 0; i < 16; i++)
+	{
+		int best = INT32_MAX, bestIndex = 0;
+		for (int p = 0; p < 8; p++)
+		{
+			int d = (values[i] - palette[p]) * (values[i] - palette[p]);
+			if (d < best)
+			{
+				best = d;
+				bestIndex = p;
+			}
+		}
+		c.Error += best;
+		c.Indices |= (uint64_t)bestIndex << (3 * i);
+	}
+	return c;
+}
+
+///least squares a0/a1 for the 8 value mode with fixed indices
+static bool RefineValueEndpoints(uint64_t indices, const uint8_t* values, int* a0, int* a1)
+{
+	float aa = 0.0f, bb = 0.0f, ab = 0.0f, ax = 0.0f, bx = 0.0f;
+	for (int i = 0; i < 16; i++)
+	{
+		int index = (int)((indices >> (3 * i)) & 7);
+		float alpha = index == 0 ? 1.0f : index == 1 ? 0.0f : (8 - index) / 7.0f, beta = 1.0f - alpha;
+		aa += alpha * alpha;
+		bb += beta * beta;
+		ab += alpha * beta;
+		ax += alpha * values[i];
+		bx += beta * values[i];
+	}
+	float det = aa * bb - ab * ab;
+	if (std::fabs(det) < 1e-6f)
+		return false;
+	*a0 = (int)std::min(std::max((bb * ax - ab * bx) / det + 0.5f, 0.0f), 255.0f);
+	*a1 = (int)std::min(std::max((aa * bx - ab * ax) / det + 0.5f, 0.0f), 255.0f);
+	return *a0 > *a1;
+}
+
+///16 values, out gets the 8 byte BC4 block
+static void EncodeValueBlock(const uint8_t* values, BlockQuality quality, uint8_t* out)
+{
+	int lo = 255, hi = 0, innerLo = 255, innerHi = 0;
+	for (int i = 0; i < 16; i++)
+	{
+		lo = std::min(lo, (int)values[i]);
+		hi = std::max(hi, (int)values[i]);
+		if (values[i] != 0 && values[i] != 255)
+		{
+			innerLo = std::min(innerLo, (int)values[i]);
+			innerHi = std::max(innerHi, (int)values[i]);
+		}
+	}
+	auto best = TryValueEndpoints(hi, lo, values);
+	if (quality != BlockFast)
+	{
+		int passes = quality == BlockHigh ? 2 : 1;
+		for (int pass = 0; pass < passes && best.Error > 0; pass++)
+		{
+			int a0, a1;
+			if (!RefineValueEndpoints(best.Indices, values, &a0, &a1))
+				break;
+			auto candidate = TryValueEndpoints(a0, a1, values);
+			if (candidate.Error >= best.Error)
+				break;
+			best = candidate;
+		}
+	}
+	//blocks that touch 0 or 255 spend the 6 value mode's range on what lies between
+	if (quality == BlockHigh && best.Error > 0 && innerLo <= innerHi && (lo == 0 || hi == 255))
+	{
+		auto candidate = TryValueEndpoints(innerLo, innerHi, values);
+		if (candidate.Error < best.Error)
+			best = candidate;
+	}
+	out[0] = (uint8_t)best.A0;
+	out[1] = (uint8_t)best.A1;
+	for (int i = 0; i < 6; i++)
+		out[2 + i] = (uint8_t)(best.Indices >> (8 * i));
+}
+
+static void EncodeBlock(const uint8_t* block, BlockFormat format, BlockQuality quality, uint8_t* out)
+{
+	uint8_t values[16];
+	switch (format)
+	{
+	case BlockBC1:
+		EncodeColorBlock(block, quality, out);
+		break;
+	case BlockBC3:
+		for (int i = 0; i < 16; i++)
+			values[i] = block[i * 4 + 3];
+		EncodeValueBlock(values, quality, out);
+		EncodeColorBlock(block, quality, out + 8);
+		break;
+	case BlockBC4:
+	case BlockBC5:
+		for (int i = 0; i < 16; i++)
+			values[i] = block[i * 4];
+		EncodeValueBlock(values, quality, out);
+		if (format == BlockBC4)
+			break;
+		for (int i = 0; i < 16; i++)
+			values[i] = block[i * 4 + 1];
+		EncodeValueBlock(values, quality, out + 8);
+		break;
+	}
+}
+
+CompressedLevel BlockEncoder::CompressLevel(const unsigned char* pixels, int width, int height, int channels, BlockFormat format, BlockQuality quality, JobSystem* jobs)
+{
+	CompressedLevel level;
+	level.Width = width;
+	level.Height = height;
+	int blocksWide = (width + 3) / 4, blocksHigh = (height + 3) / 4;
+	auto blockBytes = BlockBytes(format);
+	level.Data.resize((size_t)blocksWide * blocksHigh * blockBytes);
+	auto data = level.Data.data();
+	auto encodeRows = [=](size_t first, size_t last)
+	{
+		uint8_t block[64];
+		for (size_t by = first; by < last; by++)
+		{
+			for (int bx = 0; bx < blocksWide; bx++)
+			{
+				FetchBlock(pixels, width, height, channels, bx, (int)by, block);
+				EncodeBlock(block, format, quality, data + ((size_t)by * blocksWide + bx) * blockBytes);
+			}
+		}
+	};
+	if (jobs == NULL)
+	{
+		encodeRows(0, blocksHigh);
+		return level;
+	}
+	//about a thousand blocks per job keeps the scheduling cost out of sight
+	JobCounter encoded;
+	jobs->ParallelFor(0, blocksHigh, std::max(1, 1024 / blocksWide), encodeRows, &encoded);
+	jobs->Wait(&encoded);
+	return level;
+}
+
+CompressedImage BlockEncoder::Compress(const unsigned char* pixels, int width, int height, int channels, BlockFormat format, BlockQuality quality, JobSystem* jobs, const MipSettings* mips)
+{
+	CompressedImage image;
+	image.Format = format;
+	image.Levels.push_back(CompressLevel(pixels, width, height, channels, format, quality, jobs));
+	if (mips == NULL)
+		return image;
+	auto chain = MipGenerator::Generate(pixels, width, height, channels, *mips, jobs);
+	for (auto& level : chain.Levels)
+		image.Levels.push_back(CompressLevel(level.Pixels.data(), level.Width, level.Height, channels, format, quality, jobs));
+	return image;
+}
+
+static void DecodeColorBlock(const uint8_t* in, bool forceFourColor, uint8_t* out, int stride)
+{
+	uint16_t c0 = (uint16_t)(in[0] | (in[1] << 8)), c1 = (uint16_t)(in[2] | (in[3] << 8));
+	uint32_t indices = in[4] | (in[5] << 8) | (in[6] << 16) | ((uint32_t)in[7] << 24);
+	int palette[4][3];
+	ColorPalette(c0, c1, forceFourColor, palette);
+	for (int i = 0; i < 16; i++)
+	{
+		auto entry = palette[(indices >> (2 * i)) & 3];
+		for (int c = 0; c < 3; c++)
+			out[i * stride + c] = (uint8_t)entry[c];
+	}
+}
+
+static void DecodeValueBlock(const uint8_t* in, uint8_t* out, int stride)
+{
+	int palette[8];
+	ValuePalette(in[0], in[1], palette);
+	uint64_t indices = 0;
+	for (int i = 0; i < 6; i++)
+		indices |= (uint64_t)in[2 + i] << (8 * i);
+	for (int i = 0; i < 16; i++)
+		out[i * stride] = (uint8_t)palette[(indices >> (3 * i)) & 7];
+}
+
+std::vector<unsigned char> BlockEncoder::Decompress(const CompressedLevel& level, BlockFormat format)
+{
+	int channels = BlockChannels(format);
+	int blocksWide = (level.Width + 3) / 4, blocksHigh = (level.Height + 3) / 4;
+	auto blockBytes = BlockBytes(format);
+	std::vector<unsigned char> pixels((size_t)level.Width * level.Height * channels);
+	if (level.Data.size() < (size_t)blocksWide * blocksHigh * blockBytes)
+		return pixels;
+	uint8_t block[16 * 4];
+	for (int by = 0; by < blocksHigh; by++)
+	{
+		for (int bx = 0; bx < blocksWide; bx++)
+		{
+			auto in = level.Data.data() + ((size_t)by * blocksWide + bx) * blockBytes;
+			switch (format)
+			{
+			case BlockBC1:
+				DecodeColorBlock(in, false, block, channels);
+				break;
+			case BlockBC3:
+				DecodeValueBlock(in, block + 3, channels);
+				DecodeColorBlock(in + 8, true, block, channels);
+				break;
+			case BlockBC4:
+				DecodeValueBlock(in, block, channels);
+				break;
+			case BlockBC5:
+				DecodeValueBlock(in, block, channels);
+				DecodeValueBlock(in + 8, block + 1, channels);
+				break;
+			}
+			for (int y = 0; y < 4 && by * 4 + y < level.Height; y++)
+			{
+				for (int x = 0; x < 4 && bx * 4 + x < level.Width; x++)
+					memcpy(&pixels[((size_t)(by * 4 + y) * level.Width + bx * 4 + x) * channels], block + (y * 4 + x) * channels, channels);
+			}
+		}
+	}
+	return pixels;
+}
+
+BlockCompressionReport BlockEncoder::Measure(const unsigned char* pixels, int width, int height, int channels, const CompressedLevel& level, BlockFormat format)
+{
+	BlockCompressionReport report;
+	report.Channels = BlockChannels(format);
+	auto decoded = Decompress(level, format);
+	double error[4] = { 0.0, 0.0, 0.0, 0.0 };
+	auto count = (size_t)width * height;
+	for (size_t i = 0; i < count; i++)
+	{
+		uint8_t rgba[4];
+		FetchPixel(pixels + i * channels, channels, rgba);
+		for (int c = 0; c < report.Channels; c++)
+		{
+			double d = (double)rgba[c] - decoded[i * report.Channels + c];
+			error[c] += d * d;
+		}
+	}
+	auto psnr = [](double mse) { return mse <= 0.0 ? 99.0 : std::min(99.0, 10.0 * std::log10(255.0 * 255.0 / mse)); };
+	double total = 0.0;
+	for (int c = 0; c < 4; c++)
+	{
+		report.PSNR[c] = c < report.Channels ? psnr(error[c] / count) : 0.0;
+		if (c < report.Channels)
+			total += error[c];
+	}
+	report.Combined = psnr(total / ((double)count * report.Channels));
+	return report;
+}
+
+GLenum BlockInternalFormat(BlockFormat format, TextureUsage usage)
+{
+	bool srgb = usage == TextureColor;
+	switch (format)
+	{
+	case BlockBC1:
+		if (!GLExt.CompressionS3TC)
+			return 0;
+		return srgb && GLExt.CompressionS3TCsRGB ? GL_COMPRESSED_SRGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+	case BlockBC3:
+		if (!GLExt.CompressionS3TC)
+			return 0;
+		return srgb && GLExt.CompressionS3TCsRGB ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+	case BlockBC4:
+		return GL_COMPRESSED_RED_RGTC1;
+	case BlockBC5:
+		return GL_COMPRESSED_RG_RGTC2;
+	}
+	return 0;
+}
+
+GLuint UploadCompressedTexture(const CompressedImage& image, TextureUsage usage, int firstLevel)
+{
+	auto internalFormat = BlockInternalFormat(image.Format, usage);
+	if (internalFormat == 0 || firstLevel < 0 || firstLevel >= (int)image.Levels.size())
+		return 0;
+	auto levels = (int)image.Levels.size();
+	GLuint texture = 0;
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	for (int i = firstLevel; i < levels; i++)
+	{
+		auto& level = image.Levels[i];
+		glCompressedTexImage2D(GL_TEXTURE_2D, i, internalFormat, level.Width, level.Height, 0, (GLsizei)level.Data.size(), level.Data.data());
+	}
+	//levels above the base stay undefined, completeness only looks at base to max
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, firstLevel);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	return texture;
+}
+
+size_t CompressedImageBytes(const CompressedImage& image, int firstLevel)
+{
+	size_t bytes = 0;
+	for (size_t i = std::max(firstLevel, 0); i < image.Levels.size(); i++)
+		bytes += (size_t)((image.Levels[i].Width + 3) / 4) * ((image.Levels[i].Height + 3) / 4) * BlockBytes(image.Format);
+	return bytes;
+}
+
+//DDS_HEADER after the "DDS " magic, only the fields a fourcc texture needs are filled
+struct DDSHeader
+{
+	uint32_t Size;
+	uint32_t Flags;
+	uint32_t Height;
+	uint32_t Width;
+	uint32_t PitchOrLinearSize;
+	uint32_t Depth;
+	uint32_t MipMapCount;
+	uint32_t Reserved1[11];
+	uint32_t FormatSize;
+	uint32_t FormatFlags;
+	uint32_t FourCC;
+	uint32_t BitCount;
+	uint32_t Masks[4];
+	uint32_t Caps;
+	uint32_t Caps2;
+	uint32_t Caps3;
+	uint32_t Caps4;
+	uint32_t Reserved2;
+};
+
+static const uint32_t DDSMagic = 0x20534444;
+static const uint32_t DDSFlags = 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000 | 0x80000;
+static const uint32_t DDSFourCCFlag = 0x4;
+
+static uint32_t FourCC(const char* code)
+{
+	return (uint32_t)code[0] | ((uint32_t)code[1] << 8) | ((uint32_t)code[2] << 16) | ((uint32_t)code[3] << 24);
+}
+
+static const char* const DDSFourCCs[] = { "DXT1", "DXT5", "ATI1", "ATI2" };
+
+bool WriteCompressedImage(const char* path, const CompressedImage& image)
+{
+	if (image.Levels.empty())
+		return false;
+	DDSHeader header;
+	memset(&header, 0, sizeof(header));
+	header.Size = sizeof(DDSHeader);
+	header.Flags = DDSFlags;
+	header.Width = (uint32_t)image.Levels[0].Width;
+	header.Height = (uint32_t)image.Levels[0].Height;
+	header.PitchOrLinearSize = (uint32_t)image.Levels[0].Data.size();
+	header.MipMapCount = (uint32_t)image.Levels.size();
+	header.FormatSize = 32;
+	header.FormatFlags = DDSFourCCFlag;
+	header.FourCC = FourCC(DDSFourCCs[image.Format]);
+	//DDSCAPS_TEXTURE, plus COMPLEX | MIPMAP for a chain
+	header.Caps = 0x1000 | (image.Levels.size() > 1 ? 0x8 | 0x400000 : 0);
+	auto f = fopen(path, "wb");
+	if (f == NULL)
+		return false;
+	bool ok = fwrite(&DDSMagic, sizeof(DDSMagic), 1, f) == 1 && fwrite(&header, sizeof(header), 1, f) == 1;
+	for (size_t i = 0; ok && i < image.Levels.size(); i++)
+		ok = fwrite(image.Levels[i].Data.data(), 1, image.Levels[i].Data.size(), f) == image.Levels[i].Data.size();
+	return fclose(f) == 0 && ok;
+}
+
+bool ReadCompressedImage(const char* path, CompressedImage* image, int firstLevel, int lastLevel)
+{
+	MappedFile file;
+	if (!file.Open(path, MappedSequential) || file.Size() < sizeof(DDSMagic) + sizeof(DDSHeader))
+		return false;
+	uint32_t magic;
+	DDSHeader header;
+	memcpy(&magic, file.Data(), sizeof(magic));
+	memcpy(&header, file.Data() + sizeof(magic), sizeof(header));
+	if (magic != DDSMagic || header.Size != sizeof(DDSHeader) || (header.FormatFlags & DDSFourCCFlag) == 0 || header.Width == 0 || header.Height == 0)
+		return false;
+	int format = 0;
+	while (format < 4 && header.FourCC != FourCC(DDSFourCCs[format]))
+		format++;
+	if (format == 4)
+		return false;
+	image->Format = (BlockFormat)format;
+	image->Levels.clear();
+	size_t offset = sizeof(magic) + sizeof(header);
+	int width = (int)header.Width, height = (int)header.Height;
+	uint32_t levels = std::max(header.MipMapCount, 1u);
+	for (uint32_t i = 0; i < levels; i++)
+	{
+		auto bytes = (size_t)((width + 3) / 4) * ((height + 3) / 4) * BlockBytes(image->Format);
+		if (bytes > file.Size() - offset)
+			return false;
+		CompressedLevel level;
+		level.Width = width;
+		level.Height = height;
+		if ((int)i >= firstLevel && (int)i <= lastLevel)
+			level.Data.assign(file.Data() + offset, file.Data() + offset + bytes);
+		image->Levels.push_back(std::move(level));
+		offset += bytes;
+		if (width == 1 && height == 1)
+			break;
+		width = std::max(width / 2, 1);
+		height = std::max(height / 2, 1);
+	}
+	return true;
+}
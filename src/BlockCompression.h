@@ -0,0 +1,92 @@
+#pragma once
+#include "../include/glad/glad.h"
+#include "MipChain.h"
+#include "TextureFormat.h"
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class JobSystem;
+
+///4x4 texel block formats, what each is for decides the pick in ChooseBlockFormat
+enum BlockFormat
+{
+	///RGB, 8 bytes a block, opaque albedo
+	BlockBC1,
+	///BC1 colour plus a BC4 style alpha block, 16 bytes
+	BlockBC3,
+	///one channel, 8 bytes, masks like the specular map
+	BlockBC4,
+	///two BC4 blocks, 16 bytes, tangent space normal xy
+	BlockBC5,
+};
+
+enum BlockQuality
+{
+	///bounding box endpoints, one pass
+	BlockFast,
+	///principal axis endpoints refined once by least squares
+	BlockNormal,
+	///tries both endpoint guesses, refines further, BC4 also tries its 6 value mode
+	BlockHigh,
+};
+
+struct CompressedLevel
+{
+	int Width = 0;
+	int Height = 0;
+	std::vector<uint8_t> Data;
+};
+
+struct CompressedImage
+{
+	BlockFormat Format = BlockBC1;
+	///level 0 first
+	std::vector<CompressedLevel> Levels;
+};
+
+///decoded against source, in dB, 99 for a lossless channel
+struct BlockCompressionReport
+{
+	///channels the format stores, PSNR past this is unused
+	int Channels = 0;
+	double PSNR[4];
+	///over all stored channels together
+	double Combined = 0.0;
+};
+
+size_t BlockBytes(BlockFormat format);
+///channels the format stores and Decompress returns
+int BlockChannels(BlockFormat format);
+///BC4/BC5 for 1/2 channel images, BC3 when any alpha is below 255, BC1 otherwise
+BlockFormat ChooseBlockFormat(const unsigned char* pixels, int width, int height, int channels);
+
+///CPU BCn encoder for offline texture baking. pixels are tightly packed 8 bit rows with 1-4 channels,
+///a grey image feeds all of rgb, missing alpha is opaque. BC4 reads the first channel, BC5 the first two
+class BlockEncoder
+{
+public:
+	///jobs may be NULL to encode on the calling thread, otherwise rows of blocks are spread over the workers
+	static CompressedLevel CompressLevel(const unsigned char* pixels, int width, int height, int channels, BlockFormat format, BlockQuality quality, JobSystem* jobs);
+	///level 0 plus, unless mips is NULL, the MipGenerator chain down to 1x1 (compressed textures can not glGenerateMipmap)
+	static CompressedImage Compress(const unsigned char* pixels, int width, int height, int channels, BlockFormat format, BlockQuality quality, JobSystem* jobs, const MipSettings* mips);
+	///back to tightly packed pixels with BlockChannels(format) channels
+	static std::vector<unsigned char> Decompress(const CompressedLevel& level, BlockFormat format);
+	///PSNR of a compressed level 0 against the pixels it was made from
+	static BlockCompressionReport Measure(const unsigned char* pixels, int width, int height, int channels, const CompressedLevel& level, BlockFormat format);
+};
+
+///glCompressedTexImage2D internal format, 0 when the driver can not take it (S3TC is an extension)
+GLenum BlockInternalFormat(BlockFormat format, TextureUsage usage);
+///GL thread, a 2D texture with the levels of image from firstLevel on, 0 when the format is unsupported.
+///levels keep their numbers and GL_TEXTURE_BASE_LEVEL starts sampling at firstLevel, so the finer ones can
+///be added later with glCompressedTexImage2D into the same texture
+GLuint UploadCompressedTexture(const CompressedImage& image, TextureUsage usage, int firstLevel = 0);
+///GPU bytes of the levels from firstLevel on, from their sizes so it also works on a header only read
+size_t CompressedImageBytes(const CompressedImage& image, int firstLevel = 0);
+///DDS with DXT1/DXT5/ATI1/ATI2 fourcc so baked textures open in the usual tools
+bool WriteCompressedImage(const char* path, const CompressedImage& image);
+///levels outside firstLevel..lastLevel only get their size and leave Data empty, a firstLevel past the last
+///level reads just the header
+bool ReadCompressedImage(const char* path, CompressedImage* image, int firstLevel = 0, int lastLevel = INT_MAX);
@@ -0,0 +1,279 @@
+#include "../include/glad/glad.h"
+#include "CommandBuffer.h"
+#include "IndirectDraw.h"
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+LinearArena::LinearArena(size_t chunkSize)
+	: chunkSize(chunkSize)
+{
+}
+
+LinearArena::~LinearArena()
+{
+	for (auto& c : this->chunks)
+		free(c.Data);
+}
+
+void* LinearArena::Allocate(size_t size, size_t align)
+{
+	while (this->current < this->chunks.size())
+	{
+		auto& c = this->chunks[this->current];
+		auto base = (uintptr_t)c.Data;
+		size_t aligned = (size_t)(((base + this->offset + align - 1) & ~(uintptr_t)(align - 1)) - base);
+		if (aligned + size <= c.Size)
+		{
+			this->offset = aligned + size;
+			this->bytesUsed += size;
+			return c.Data + aligned;
+		}
+		this->current++;
+		this->offset = 0;
+	}
+	Chunk c;
+	c.Size = size + align > this->chunkSize ? size + align : this->chunkSize;
+	c.Data = (char*)malloc(c.Size);
+	if (c.Data == NULL)
+		throw std::bad_alloc();
+	this->chunks.push_back(c);
+	this->current = this->chunks.size() - 1;
+	this->offset = 0;
+	return this->Allocate(size, align);
+}
+
+void LinearArena::Reset()
+{
+	this->current = 0;
+	this->offset = 0;
+	this->bytesUsed = 0;
+}
+
+CommandBuffer::CommandBuffer(LinearArena* arena)
+	: arena(arena)
+{
+}
+
+void* CommandBuffer::Push(CommandType type, size_t size)
+{
+	size = (size + 7) & ~(size_t)7;
+	if (this->tail == nullptr || this->tail->Used + size > this->tail->Capacity)
+	{
+		auto block = (Block*)this->arena->Allocate(sizeof(Block) + BlockSize, 16);
+		block->Next = nullptr;
+		block->Used = 0;
+		block->Capacity = BlockSize;
+		if (this->tail == nullptr)
+			this->head = block;
+		else
+			this->tail->Next = block;
+		this->tail = block;
+	}
+	auto header = (CommandHeader*)(this->tail->Data() + this->tail->Used);
+	header->Type = type;
+	header->Size = (uint16_t)size;
+	this->tail->Used += (uint32_t)size;
+	this->commandCount++;
+	return header;
+}
+
+void CommandBuffer::BindProgram(unsigned program)
+{
+	auto cmd = (BindProgramCommand*)this->Push(CmdBindProgram, sizeof(BindProgramCommand));
+	cmd->Program = program;
+}
+
+void CommandBuffer::BindVertexArray(unsigned vertexArray)
+{
+	auto cmd = (BindVertexArrayCommand*)this->Push(CmdBindVertexArray, sizeof(BindVertexArrayCommand));
+	cmd->VertexArray = vertexArray;
+}
+
+void CommandBuffer::BindTexture(unsigned texture, int location, int unit, CommandTextureTarget target)
+{
+	auto cmd = (BindTextureCommand*)this->Push(CmdBindTexture, sizeof(BindTextureCommand));
+	cmd->Texture = texture;
+	cmd->Location = location;
+	cmd->Unit = unit;
+	cmd->Target = target;
+}
+
+void CommandBuffer::SetUniform(int location, int value)
+{
+	auto cmd = (UniformIntCommand*)this->Push(CmdUniformInt, sizeof(UniformIntCommand));
+	cmd->Location = location;
+	cmd->Value = value;
+}
+
+void CommandBuffer::SetUniform(int location, float value)
+{
+	auto cmd = (UniformFloatCommand*)this->Push(CmdUniformFloat, sizeof(UniformFloatCommand));
+	cmd->Location = location;
+	cmd->Value = value;
+}
+
+void CommandBuffer::SetUniform(int location, const float* vec3)
+{
+	auto cmd = (UniformVec3Command*)this->Push(CmdUniformVec3, sizeof(UniformVec3Command));
+	cmd->Location = location;
+	memcpy(cmd->Value, vec3, sizeof(cmd->Value));
+}
+
+void CommandBuffer::SetUniformVec4(int location, const float* vec4)
+{
+	auto cmd = (UniformVec4Command*)this->Push(CmdUniformVec4, sizeof(UniformVec4Command));
+	cmd->Location = location;
+	memcpy(cmd->Value, vec4, sizeof(cmd->Value));
+}
+
+void CommandBuffer::SetUniformMat4(int location, const float* mat4)
+{
+	auto cmd = (UniformMat4Command*)this->Push(CmdUniformMat4, sizeof(UniformMat4Command));
+	cmd->Location = location;
+	memcpy(cmd->Value, mat4, sizeof(cmd->Value));
+}
+
+void CommandBuffer::DrawArrays(CommandPrimitive primitive, int first, int count)
+{
+	auto cmd = (DrawArraysCommand*)this->Push(CmdDrawArrays, sizeof(DrawArraysCommand));
+	cmd->Primitive = primitive;
+	cmd->First = first;
+	cmd->Count = count;
+}
+
+void CommandBuffer::DrawElements(CommandPrimitive primitive, int count, size_t offset, int baseVertex)
+{
+	auto cmd = (DrawElementsCommand*)this->Push(CmdDrawElements, sizeof(DrawElementsCommand));
+	cmd->Primitive = primitive;
+	cmd->Count = count;
+	cmd->Offset = offset;
+	cmd->BaseVertex = baseVertex;
+}
+
+void CommandBuffer::DrawIndirect(IndirectDrawList* list, MeshBuffer* meshes, int drawIdLocation, CommandPrimitive primitive)
+{
+	auto cmd = (DrawIndirectListCommand*)this->Push(CmdDrawIndirect, sizeof(DrawIndirectListCommand));
+	cmd->Primitive = primitive;
+	cmd->List = list;
+	cmd->Meshes = meshes;
+	cmd->DrawIdLocation = drawIdLocation;
+}
+
+CommandRecorder::CommandRecorder(size_t threadCount)
+{
+	for (size_t i = 0; i < threadCount; i++)
+		this->arenas.push_back(new LinearArena());
+}
+
+size_t CommandRecorder::ReserveSlot()
+{
+	this->slots.push_back(nullptr);
+	return this->slots.size() - 1;
+}
+
+CommandBuffer* CommandRecorder::Begin(size_t slot, size_t threadIndex)
+{
+	auto arena = this->arenas[threadIndex];
+	//placement in the arena itself, the buffer dies with the frame like its commands
+	auto buffer = new (arena->Allocate(sizeof(CommandBuffer))) CommandBuffer(arena);
+	this->slots[slot] = buffer;
+	return buffer;
+}
+
+void CommandRecorder::Reset()
+{
+	this->slots.clear();
+	for (auto arena : this->arenas)
+		arena->Reset();
+}
+
+static GLenum ToGLPrimitive(CommandPrimitive primitive)
+{
+	switch (primitive)
+	{
+	case PrimLines: return GL_LINES;
+	case PrimPoints: return GL_POINTS;
+	default: return GL_TRIANGLES;
+	}
+}
+
+static GLenum ToGLTextureTarget(CommandTextureTarget target)
+{
+	switch (target)
+	{
+	case TexTarget2DArray: return GL_TEXTURE_2D_ARRAY;
+	case TexTargetBuffer: return GL_TEXTURE_BUFFER;
+	default: return GL_TEXTURE_2D;
+	}
+}
+
+void ReplayCommandBufferGL(const CommandBuffer& buffer)
+{
+	buffer.ForEach([](const CommandHeader* header)
+	{
+		switch (header->Type)
+		{
+		case CmdBindProgram:
+			glUseProgram(((const BindProgramCommand*)header)->Program);
+			break;
+		case CmdBindVertexArray:
+			glBindVertexArray(((const BindVertexArrayCommand*)header)->VertexArray);
+			break;
+		case CmdBindTexture:
+		{
+			auto cmd = (const BindTextureCommand*)header;
+			glActiveTexture(GL_TEXTURE0 + cmd->Unit);
+			glBindTexture(ToGLTextureTarget(cmd->Target), cmd->Texture);
+			glUniform1i(cmd->Location, cmd->Unit);
+			break;
+		}
+		case CmdUniformInt:
+			glUniform1i(((const UniformIntCommand*)header)->Location, ((const UniformIntCommand*)header)->Value);
+			break;
+		case CmdUniformFloat:
+			glUniform1f(((const UniformFloatCommand*)header)->Location, ((const UniformFloatCommand*)header)->Value);
+			break;
+		case CmdUniformVec3:
+			glUniform3fv(((const UniformVec3Command*)header)->Location, 1, ((const UniformVec3Command*)header)->Value);
+			break;
+		case CmdUniformVec4:
+			glUniform4fv(((const UniformVec4Command*)header)->Location, 1, ((const UniformVec4Command*)header)->Value);
+			break;
+		case CmdUniformMat4:
+			glUniformMatrix4fv(((const UniformMat4Command*)header)->Location, 1, GL_FALSE, ((const UniformMat4Command*)header)->Value);
+			break;
+		case CmdDrawArrays:
+		{
+			auto cmd = (const DrawArraysCommand*)header;
+			glDrawArrays(ToGLPrimitive(cmd->Primitive), cmd->First, cmd->Count);
+			break;
+		}
+		case CmdDrawElements:
+		{
+			auto cmd = (const DrawElementsCommand*)header;
+			if (cmd->BaseVertex != 0)
+				glDrawElementsBaseVertex(ToGLPrimitive(cmd->Primitive), cmd->Count, GL_UNSIGNED_INT, (void*)cmd->Offset, cmd->BaseVertex);
+			else
+				glDrawElements(ToGLPrimitive(cmd->Primitive), cmd->Count, GL_UNSIGNED_INT, (void*)cmd->Offset);
+			break;
+		}
+		case CmdDrawIndirect:
+		{
+			auto cmd = (const DrawIndirectListCommand*)header;
+			cmd->List->Submit(cmd->Meshes, cmd->DrawIdLocation, ToGLPrimitive(cmd->Primitive));
+			break;
+		}
+		}
+	});
+}
+
+void ReplayCommandRecorderGL(CommandRecorder& recorder)
+{
+	for (size_t i = 0; i < recorder.SlotCount(); i++)
+	{
+		auto buffer = recorder.GetSlot(i);
+		if (buffer != nullptr)
+			ReplayCommandBufferGL(*buffer);
+	}
+}
@@ -0,0 +1,161 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class IndirectDrawList;
+class MeshBuffer;
+
+///bump allocator, Reset() frees everything at once and keeps the chunks for the next frame
+///not thread safe, give every recording thread its own
+class LinearArena
+{
+public:
+	explicit LinearArena(size_t chunkSize = 64 * 1024);
+	~LinearArena();
+	LinearArena(const LinearArena&) = delete;
+	LinearArena& operator=(const LinearArena&) = delete;
+	void* Allocate(size_t size, size_t align = 16);
+	void Reset();
+	size_t BytesUsed() { return this->bytesUsed; }
+private:
+	struct Chunk
+	{
+		char* Data;
+		size_t Size;
+	};
+	std::vector<Chunk> chunks;
+	size_t current = 0;
+	size_t offset = 0;
+	size_t chunkSize;
+	size_t bytesUsed = 0;
+};
+
+enum CommandType : uint16_t
+{
+	CmdBindProgram,
+	CmdBindVertexArray,
+	CmdBindTexture,
+	CmdUniformInt,
+	CmdUniformFloat,
+	CmdUniformVec3,
+	CmdUniformVec4,
+	CmdUniformMat4,
+	CmdDrawArrays,
+	CmdDrawElements,
+	CmdDrawIndirect,
+};
+
+enum CommandPrimitive : uint16_t
+{
+	PrimTriangles,
+	PrimLines,
+	PrimPoints,
+};
+
+enum CommandTextureTarget : uint16_t
+{
+	TexTarget2D,
+	TexTarget2DArray,
+	///samplerBuffer over a buffer object
+	TexTargetBuffer,
+};
+
+struct CommandHeader
+{
+	CommandType Type;
+	///whole command including this header, keeps the walk independent of the command set
+	uint16_t Size;
+};
+
+struct BindProgramCommand { CommandHeader Header; unsigned Program; };
+struct BindVertexArrayCommand { CommandHeader Header; unsigned VertexArray; };
+struct BindTextureCommand { CommandHeader Header; unsigned Texture; int Location; int Unit; CommandTextureTarget Target; };
+struct UniformIntCommand { CommandHeader Header; int Location; int Value; };
+struct UniformFloatCommand { CommandHeader Header; int Location; float Value; };
+struct UniformVec3Command { CommandHeader Header; int Location; float Value[3]; };
+struct UniformVec4Command { CommandHeader Header; int Location; float Value[4]; };
+struct UniformMat4Command { CommandHeader Header; int Location; float Value[16]; };
+struct DrawArraysCommand { CommandHeader Header; CommandPrimitive Primitive; int First; int Count; };
+///index type is always 32 bit, Offset is in bytes into the bound element buffer
+struct DrawElementsCommand { CommandHeader Header; CommandPrimitive Primitive; int Count; size_t Offset; int BaseVertex; };
+///the whole list in one IndirectDrawList::Submit, binds the MeshBuffer's VAO
+struct DrawIndirectListCommand { CommandHeader Header; CommandPrimitive Primitive; IndirectDrawList* List; MeshBuffer* Meshes; int DrawIdLocation; };
+
+///list of render commands recorded into a LinearArena, no graphics api calls happen while recording
+///so any thread may fill one, the GL thread plays it back later with ReplayCommandBufferGL
+class CommandBuffer
+{
+public:
+	explicit CommandBuffer(LinearArena* arena);
+	void BindProgram(unsigned program);
+	void BindVertexArray(unsigned vertexArray);
+	void BindTexture(unsigned texture, int location, int unit, CommandTextureTarget target = TexTarget2D);
+	void SetUniform(int location, int value);
+	void SetUniform(int location, float value);
+	void SetUniform(int location, const float* vec3);
+	void SetUniformVec4(int location, const float* vec4);
+	void SetUniformMat4(int location, const float* mat4);
+	void DrawArrays(CommandPrimitive primitive, int first, int count);
+	void DrawElements(CommandPrimitive primitive, int count, size_t offset, int baseVertex = 0);
+	///only the pointers are recorded, list has to stay filled until the replay
+	void DrawIndirect(IndirectDrawList* list, MeshBuffer* meshes, int drawIdLocation = -1, CommandPrimitive primitive = PrimTriangles);
+	size_t CommandCount() { return this->commandCount; }
+
+	///walks the recorded commands in order, visitor gets a const CommandHeader*
+	template <typename Visitor>
+	void ForEach(Visitor visitor) const;
+private:
+	struct Block
+	{
+		Block* Next;
+		uint32_t Used;
+		uint32_t Capacity;
+		char* Data() { return reinterpret_cast<char*>(this + 1); }
+	};
+	static const uint32_t BlockSize = 4096;
+	void* Push(CommandType type, size_t size);
+	LinearArena* arena;
+	Block* head = nullptr;
+	Block* tail = nullptr;
+	size_t commandCount = 0;
+};
+
+template <typename Visitor>
+void CommandBuffer::ForEach(Visitor visitor) const
+{
+	for (auto block = this->head; block != nullptr; block = block->Next)
+	{
+		uint32_t pos = 0;
+		while (pos < block->Used)
+		{
+			auto header = reinterpret_cast<const CommandHeader*>(block->Data() + pos);
+			visitor(header);
+			pos += header->Size;
+		}
+	}
+}
+
+///one frame worth of command buffers, slots are handed out in submission order on the
+///scheduling thread, recorded in any order on workers and replayed by slot on the GL thread
+class CommandRecorder
+{
+public:
+	explicit CommandRecorder(size_t threadCount);
+	///called on the scheduling thread, the returned slot fixes the replay order
+	size_t ReserveSlot();
+	///called on a worker, threadIndex picks that thread's arena so no two threads share one
+	CommandBuffer* Begin(size_t slot, size_t threadIndex);
+	size_t SlotCount() { return this->slots.size(); }
+	CommandBuffer* GetSlot(size_t slot) { return this->slots[slot]; }
+	///GL thread, once every slot was recorded and replayed
+	void Reset();
+private:
+	std::vector<LinearArena*> arenas;
+	std::vector<CommandBuffer*> slots;
+};
+
+///plays the buffer back on the current GL context, must run on the GL thread
+void ReplayCommandBufferGL(const CommandBuffer& buffer);
+///replays every slot of the recorder in slot order, skipping slots that were never recorded
+void ReplayCommandRecorderGL(CommandRecorder& recorder);
@@ -0,0 +1,47 @@
+#include "GLExtensions.h"
+#include <cstring>
+
+GLExtensionSet GLExt;
+
+bool HasGLVersion(int major, int minor)
+{
+	return GLVersion.major > major || (GLVersion.major == major && GLVersion.minor >= minor);
+}
+
+bool HasGLExtension(const char* name)
+{
+	GLint count = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+	for (GLint i = 0; i < count; i++)
+	{
+		auto ext = (const char*)glGetStringi(GL_EXTENSIONS, i);
+		if (ext != NULL && strcmp(ext, name) == 0)
+			return true;
+	}
+	return false;
+}
+
+bool LoadGLExtensions(GLADloadproc load)
+{
+	if (HasGLVersion(4, 4) || HasGLExtension("GL_ARB_buffer_storage"))
+	{
+		GLExt.glBufferStorage = (PFNGLBUFFERSTORAGEPROC)load("glBufferStorage");
+		GLExt.BufferStorage = GLExt.glBufferStorage != NULL;
+	}
+	GLExt.BaseInstance = HasGLVersion(4, 2) || HasGLExtension("GL_ARB_base_instance");
+	//the extension alone does not promise baseInstance is honoured, IndirectDrawList loops without it
+	if (GLExt.BaseInstance && (HasGLVersion(4, 3) || HasGLExtension("GL_ARB_multi_draw_indirect")))
+	{
+		GLExt.glMultiDrawElementsIndirect = (PFNGLMULTIDRAWELEMENTSINDIRECTPROC)load("glMultiDrawElementsIndirect");
+		GLExt.MultiDrawIndirect = GLExt.glMultiDrawElementsIndirect != NULL;
+	}
+	if (HasGLVersion(4, 2) || HasGLExtension("GL_ARB_texture_storage"))
+	{
+		GLExt.glTexStorage2D = (PFNGLTEXSTORAGE2DPROC)load("glTexStorage2D");
+		GLExt.glTexStorage3D = (PFNGLTEXSTORAGE3DPROC)load("glTexStorage3D");
+		GLExt.TextureStorage = GLExt.glTexStorage2D != NULL && GLExt.glTexStorage3D != NULL;
+	}
+	GLExt.CompressionS3TC = HasGLExtension("GL_EXT_texture_compression_s3tc");
+	GLExt.CompressionS3TCsRGB = GLExt.CompressionS3TC && (HasGLExtension("GL_EXT_texture_sRGB") || HasGLExtension("GL_EXT_texture_compression_s3tc_srgb"));
+	return true;
+}
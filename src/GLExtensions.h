@@ -0,0 +1,72 @@
+#pragma once
+#include "../include/glad/glad.h"
+
+//glad in this tree is generated for core 3.3 without extensions, so anything newer is loaded here
+
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+#ifndef GL_DYNAMIC_STORAGE_BIT
+#define GL_DYNAMIC_STORAGE_BIT 0x0100
+#endif
+#ifndef GL_CLIENT_STORAGE_BIT
+#define GL_CLIENT_STORAGE_BIT 0x0200
+#endif
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+//EXT_texture_compression_s3tc and the sRGB variants from EXT_texture_sRGB, RGTC (BC4/BC5) is core
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_SRGB_S3TC_DXT1_EXT 0x8C4C
+#endif
+#ifndef GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT 0x8C4F
+#endif
+//GL_NVX_gpu_memory_info and GL_ATI_meminfo, both in KB
+#ifndef GL_GPU_MEMORY_INFO_DEDICATED_VIDMEM_NVX
+#define GL_GPU_MEMORY_INFO_DEDICATED_VIDMEM_NVX 0x9047
+#endif
+#ifndef GL_TEXTURE_FREE_MEMORY_ATI
+#define GL_TEXTURE_FREE_MEMORY_ATI 0x87FC
+#endif
+
+typedef void (APIENTRYP PFNGLBUFFERSTORAGEPROC)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+typedef void (APIENTRYP PFNGLMULTIDRAWELEMENTSINDIRECTPROC)(GLenum mode, GLenum type, const void* indirect, GLsizei drawcount, GLsizei stride);
+typedef void (APIENTRYP PFNGLTEXSTORAGE2DPROC)(GLenum target, GLsizei levels, GLenum internalformat, GLsizei width, GLsizei height);
+typedef void (APIENTRYP PFNGLTEXSTORAGE3DPROC)(GLenum target, GLsizei levels, GLenum internalformat, GLsizei width, GLsizei height, GLsizei depth);
+
+struct GLExtensionSet
+{
+	///GL 4.4 or GL_ARB_buffer_storage
+	bool BufferStorage = false;
+	PFNGLBUFFERSTORAGEPROC glBufferStorage = NULL;
+	///GL 4.2 or GL_ARB_base_instance, a command's baseInstance offsets instanced attributes
+	bool BaseInstance = false;
+	///GL 4.3 or GL_ARB_multi_draw_indirect, only set together with BaseInstance since the draw ids ride on it
+	bool MultiDrawIndirect = false;
+	PFNGLMULTIDRAWELEMENTSINDIRECTPROC glMultiDrawElementsIndirect = NULL;
+	///GL 4.2 or GL_ARB_texture_storage, immutable textures with every level allocated up front
+	bool TextureStorage = false;
+	PFNGLTEXSTORAGE2DPROC glTexStorage2D = NULL;
+	PFNGLTEXSTORAGE3DPROC glTexStorage3D = NULL;
+	///GL_EXT_texture_compression_s3tc, BC1/BC3 uploads
+	bool CompressionS3TC = false;
+	///sRGB decode of S3TC blocks, GL_EXT_texture_sRGB on top of the above
+	bool CompressionS3TCsRGB = false;
+};
+
+extern GLExtensionSet GLExt;
+
+///call once after gladLoadGLLoader with the same loader, fills GLExt
+bool LoadGLExtensions(GLADloadproc load);
+bool HasGLExtension(const char* name);
+bool HasGLVersion(int major, int minor);
@@ -0,0 +1,91 @@
+#include "IndirectDraw.h"
+
+IndirectDrawList::IndirectDrawList()
+{
+	glGenBuffers(1, &this->indirectBuffer);
+	glGenBuffers(1, &this->drawIdBuffer);
+}
+
+IndirectDrawList::~IndirectDrawList()
+{
+	glDeleteBuffers(1, &this->indirectBuffer);
+	glDeleteBuffers(1, &this->drawIdBuffer);
+}
+
+DrawElementsIndirectCommand IndirectDrawList::MakeCommand(const MeshHandle& mesh, GLuint drawId, GLuint instanceCount)
+{
+	DrawElementsIndirectCommand cmd;
+	cmd.Count = (GLuint)mesh.IndexCount;
+	cmd.InstanceCount = instanceCount;
+	cmd.FirstIndex = mesh.FirstIndex;
+	cmd.BaseVertex = mesh.BaseVertex;
+	cmd.BaseInstance = drawId;
+	return cmd;
+}
+
+size_t IndirectDrawList::Add(const MeshHandle& mesh, GLuint instanceCount)
+{
+	this->commands.push_back(MakeCommand(mesh, (GLuint)this->commands.size(), instanceCount));
+	return this->commands.size() - 1;
+}
+
+void IndirectDrawList::EnsureDrawIds(GLuint count)
+{
+	if (count <= this->drawIdCapacity)
+		return;
+	auto capacity = this->drawIdCapacity > 0 ? this->drawIdCapacity : 1024u;
+	while (capacity < count)
+		capacity *= 2;
+	std::vector<GLuint> ids(capacity);
+	for (GLuint i = 0; i < capacity; i++)
+		ids[i] = i;
+	glBindBuffer(GL_ARRAY_BUFFER, this->drawIdBuffer);
+	glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(GLuint), ids.data(), GL_STATIC_DRAW);
+	this->drawIdCapacity = capacity;
+}
+
+void IndirectDrawList::Submit(MeshBuffer* meshes, GLint drawIdLocation, GLenum mode)
+{
+	if (this->commands.empty())
+		return;
+	meshes->UseThisVAO();
+	auto count = (GLsizei)this->commands.size();
+	if (GLExt.MultiDrawIndirect && !this->forceFallback)
+	{
+		if (drawIdLocation >= 0)
+		{
+			//instance i of a draw reads element BaseInstance + i / divisor, with a divisor no instance count
+			//gets to every instance reads BaseInstance, the same id the fallback sets
+			GLuint maxId = 0;
+			for (auto& c : this->commands)
+				maxId = c.BaseInstance + 1 > maxId ? c.BaseInstance + 1 : maxId;
+			this->EnsureDrawIds(maxId);
+			glBindBuffer(GL_ARRAY_BUFFER, this->drawIdBuffer);
+			glVertexAttribIPointer(drawIdLocation, 1, GL_UNSIGNED_INT, sizeof(GLuint), (void*)0);
+			glVertexAttribDivisor(drawIdLocation, 0x7fffffffu);
+			glEnableVertexAttribArray(drawIdLocation);
+		}
+		//orphan then fill, the previous frame's commands may still be in flight
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, this->indirectBuffer);
+		glBufferData(GL_DRAW_INDIRECT_BUFFER, count * sizeof(DrawElementsIndirectCommand), NULL, GL_STREAM_DRAW);
+		glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, count * sizeof(DrawElementsIndirectCommand), this->commands.data());
+		GLExt.glMultiDrawElementsIndirect(mode, GL_UNSIGNED_INT, (void*)0, count, 0);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+		return;
+	}
+	//3.3 has no base instance, so the id becomes the attribute's current value instead of an array
+	if (drawIdLocation >= 0)
+		glDisableVertexAttribArray(drawIdLocation);
+	for (auto& c : this->commands)
+	{
+		if (c.Count == 0 || c.InstanceCount == 0)
+			continue;
+		if (drawIdLocation >= 0)
+			glVertexAttribI1ui(drawIdLocation, c.BaseInstance);
+		auto offset = (void*)((size_t)c.FirstIndex * sizeof(GLuint));
+		if (c.InstanceCount == 1)
+			glDrawElementsBaseVertex(mode, c.Count, GL_UNSIGNED_INT, offset, c.BaseVertex);
+		else
+			glDrawElementsInstancedBaseVertex(mode, c.Count, GL_UNSIGNED_INT, offset, c.InstanceCount, c.BaseVertex);
+	}
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include "GLExtensions.h"
+#include "MeshBuffer.h"
+#include <vector>
+
+///same layout as the GL indirect buffer expects
+struct DrawElementsIndirectCommand
+{
+	GLuint Count;
+	GLuint InstanceCount;
+	GLuint FirstIndex;
+	GLint BaseVertex;
+	///draw id, index of the draw's per-draw data the shader reads through the draw id attribute
+	GLuint BaseInstance;
+};
+
+///list of indexed draws out of one MeshBuffer, submitted with a single glMultiDrawElementsIndirect
+///when the context has it together with base instance, and as a plain loop of draws otherwise.
+///per-draw data is looked up in the shader through an integer attribute (e.g. "in uint aDrawId") that
+///holds the command's draw id for every vertex and every instance of it, on both paths: the indirect
+///path reads element BaseInstance of an 0..N-1 array with a divisor no instance count reaches, the
+///fallback disables the array and sets the id as the constant value. instances of one command tell
+///themselves apart with gl_InstanceID, which starts at 0 either way. several commands may share an id,
+///e.g. the meshlet runs of one mesh
+class IndirectDrawList
+{
+public:
+	IndirectDrawList();
+	~IndirectDrawList();
+	void Clear() { this->commands.clear(); }
+	///draw id defaults to the command's index
+	size_t Add(const MeshHandle& mesh, GLuint instanceCount = 1);
+	///for building on worker threads: Resize once, then every job fills its own range through At
+	void Resize(size_t count) { this->commands.resize(count); }
+	DrawElementsIndirectCommand& At(size_t index) { return this->commands[index]; }
+	///for emitters that append their own commands, like ClusterCuller::EmitCommands
+	std::vector<DrawElementsIndirectCommand>& Commands() { return this->commands; }
+	static DrawElementsIndirectCommand MakeCommand(const MeshHandle& mesh, GLuint drawId, GLuint instanceCount = 1);
+	size_t Count() { return this->commands.size(); }
+	///GL thread, drawIdLocation may be -1 if the shader needs no per-draw data
+	void Submit(MeshBuffer* meshes, GLint drawIdLocation, GLenum mode = GL_TRIANGLES);
+	///forces the 3.3 loop even when indirect drawing is available, for comparisons
+	void SetForceFallback(bool force) { this->forceFallback = force; }
+private:
+	void EnsureDrawIds(GLuint count);
+	std::vector<DrawElementsIndirectCommand> commands;
+	GLuint indirectBuffer = 0;
+	///0..drawIdCapacity-1, sourced per instance for the draw id attribute
+	GLuint drawIdBuffer = 0;
+	GLuint drawIdCapacity = 0;
+	bool forceFallback = false;
+};
@@ -0,0 +1,263 @@
+#include "JobSystem.h"
+#include <algorithm>
+
+struct Job
+{
+	std::function<void()> Work;
+	JobCounter* Counter;
+	JobAffinity Affinity;
+};
+
+static thread_local int currentThreadIndex = -1;
+
+WorkStealingDeque::WorkStealingDeque(size_t capacity)
+	: buffer(capacity),
+	top(0),
+	bottom(0)
+{
+	//capacity has to be a power of two for the mask
+	size_t c = 1;
+	while (c < capacity)
+		c <<= 1;
+	if (c != capacity)
+		this->buffer = std::vector<std::atomic<Job*>>(c);
+	this->mask = (int64_t)c - 1;
+}
+
+bool WorkStealingDeque::Push(Job* job)
+{
+	auto b = this->bottom.load(std::memory_order_relaxed);
+	auto t = this->top.load(std::memory_order_acquire);
+	if (b - t > this->mask)
+		return false;
+	this->buffer[b & this->mask].store(job, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	this->bottom.store(b + 1, std::memory_order_relaxed);
+	return true;
+}
+
+Job* WorkStealingDeque::Pop()
+{
+	auto b = this->bottom.load(std::memory_order_relaxed) - 1;
+	this->bottom.store(b, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	auto t = this->top.load(std::memory_order_relaxed);
+	if (t > b)
+	{
+		this->bottom.store(b + 1, std::memory_order_relaxed);
+		return NULL;
+	}
+	auto job = this->buffer[b & this->mask].load(std::memory_order_relaxed);
+	if (t == b)
+	{
+		//last item, race the thieves for it
+		if (!this->top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+			job = NULL;
+		this->bottom.store(b + 1, std::memory_order_relaxed);
+	}
+	return job;
+}
+
+Job* WorkStealingDeque::Steal()
+{
+	auto t = this->top.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	auto b = this->bottom.load(std::memory_order_acquire);
+	if (t >= b)
+		return NULL;
+	auto job = this->buffer[t & this->mask].load(std::memory_order_relaxed);
+	if (!this->top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+		return NULL;
+	return job;
+}
+
+JobSystem::JobSystem(size_t workerCount)
+	: queuedJobs(0),
+	running(true)
+{
+	if (workerCount == 0)
+	{
+		auto cores = std::thread::hardware_concurrency();
+		workerCount = cores > 1 ? cores - 1 : 1;
+	}
+	currentThreadIndex = 0;
+	for (size_t i = 0; i <= workerCount; i++)
+		this->deques.push_back(new WorkStealingDeque());
+	for (size_t i = 1; i <= workerCount; i++)
+		this->workers.push_back(std::thread(&JobSystem::WorkerMain, this, i));
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> guard(this->sleepLock);
+		this->running.store(false);
+	}
+	this->wake.notify_all();
+	for (auto& t : this->workers)
+		t.join();
+	for (auto d : this->deques)
+		delete d;
+}
+
+int JobSystem::ThreadIndex()
+{
+	return currentThreadIndex;
+}
+
+void JobSystem::Enqueue(Job* job)
+{
+	if (job->Affinity == JobGLThread)
+	{
+		std::lock_guard<std::mutex> guard(this->glLock);
+		this->glJobs.push_back(job);
+		return;
+	}
+	this->queuedJobs.fetch_add(1, std::memory_order_release);
+	auto index = currentThreadIndex;
+	if (index < 0 || !this->deques[index]->Push(job))
+	{
+		std::lock_guard<std::mutex> guard(this->injectLock);
+		this->injected.push_back(job);
+	}
+	//taking the lock orders the notify against a worker that is about to sleep
+	{
+		std::lock_guard<std::mutex> guard(this->sleepLock);
+	}
+	this->wake.notify_one();
+}
+
+void JobSystem::Schedule(std::function<void()> work, JobCounter* counter, JobCounter* dependency, JobAffinity affinity)
+{
+	auto job = new Job();
+	job->Work = std::move(work);
+	job->Counter = counter;
+	job->Affinity = affinity;
+	if (counter != NULL)
+		counter->pending.fetch_add(1, std::memory_order_relaxed);
+	if (dependency != NULL)
+	{
+		std::lock_guard<std::mutex> guard(dependency->lock);
+		if (dependency->pending.load(std::memory_order_acquire) != 0)
+		{
+			dependency->dependents.push_back(job);
+			return;
+		}
+	}
+	this->Enqueue(job);
+}
+
+void JobSystem::ParallelFor(size_t begin, size_t end, size_t grain, std::function<void(size_t, size_t)> body, JobCounter* counter, JobCounter* dependency)
+{
+	if (grain == 0)
+		grain = 1;
+	for (size_t first = begin; first < end; first += grain)
+	{
+		auto last = std::min(end, first + grain);
+		this->Schedule([body, first, last]() { body(first, last); }, counter, dependency);
+	}
+}
+
+Job* JobSystem::FindJob(size_t index)
+{
+	Job* job = NULL;
+	if (index == 0)
+	{
+		std::lock_guard<std::mutex> guard(this->glLock);
+		if (!this->glJobs.empty())
+		{
+			job = this->glJobs.front();
+			this->glJobs.pop_front();
+			return job;
+		}
+	}
+	job = this->deques[index]->Pop();
+	if (job != NULL)
+		return job;
+	{
+		std::lock_guard<std::mutex> guard(this->injectLock);
+		if (!this->injected.empty())
+		{
+			job = this->injected.back();
+			this->injected.pop_back();
+			return job;
+		}
+	}
+	//start stealing next to ourselves so thieves spread out over the victims
+	auto count = this->deques.size();
+	for (size_t i = 1; i < count; i++)
+	{
+		job = this->deques[(index + i) % count]->Steal();
+		if (job != NULL)
+			return job;
+	}
+	return NULL;
+}
+
+void JobSystem::Release(JobCounter* counter)
+{
+	//a Wait that sees pending at zero still holds off until releasing is back to zero, so the counter
+	//(often on the waiter's stack) outlives the lock and dependents used below
+	counter->releasing.fetch_add(1, std::memory_order_acq_rel);
+	std::vector<Job*> ready;
+	if (counter->pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+	{
+		std::lock_guard<std::mutex> guard(counter->lock);
+		ready.swap(counter->dependents);
+	}
+	//last access to the counter
+	counter->releasing.fetch_sub(1, std::memory_order_acq_rel);
+	for (auto job : ready)
+		this->Enqueue(job);
+}
+
+void JobSystem::Execute(Job* job)
+{
+	if (job->Affinity != JobGLThread)
+		this->queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+	job->Work();
+	auto counter = job->Counter;
+	delete job;
+	if (counter != NULL)
+		this->Release(counter);
+}
+
+void JobSystem::WorkerMain(size_t index)
+{
+	currentThreadIndex = (int)index;
+	int idle = 0;
+	while (this->running.load(std::memory_order_relaxed))
+	{
+		auto job = this->FindJob(index);
+		if (job != NULL)
+		{
+			this->Execute(job);
+			idle = 0;
+			continue;
+		}
+		if (++idle < 64)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+		std::unique_lock<std::mutex> guard(this->sleepLock);
+		this->wake.wait(guard, [this]()
+		{
+			return !this->running.load(std::memory_order_relaxed) || this->queuedJobs.load(std::memory_order_acquire) > 0;
+		});
+		idle = 0;
+	}
+}
+
+void JobSystem::Wait(JobCounter* counter)
+{
+	auto index = currentThreadIndex;
+	while (!counter->IsDone())
+	{
+		Job* job = index >= 0 ? this->FindJob(index) : NULL;
+		if (job != NULL)
+			this->Execute(job);
+		else
+			std::this_thread::yield();
+	}
+}
@@ -0,0 +1,103 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct Job;
+
+///counts unfinished jobs, jobs scheduled against it only start once it reaches zero
+class JobCounter
+{
+public:
+	JobCounter() : pending(0), releasing(0) {}
+	JobCounter(const JobCounter&) = delete;
+	JobCounter& operator=(const JobCounter&) = delete;
+	///once true the counter may be destroyed, no Release is still touching it
+	bool IsDone() const { return this->pending.load(std::memory_order_acquire) == 0 && this->releasing.load(std::memory_order_acquire) == 0; }
+	int Pending() const { return this->pending.load(std::memory_order_acquire); }
+private:
+	friend class JobSystem;
+	std::atomic<int> pending;
+	///Release calls between their decrement and their last access, pending alone reaching zero does not
+	///mean the finishing thread is done with lock and dependents
+	std::atomic<int> releasing;
+	std::mutex lock;
+	///jobs waiting for this counter to reach zero
+	std::vector<Job*> dependents;
+};
+
+enum JobAffinity
+{
+	///any worker, including the GL thread while it waits
+	JobAnyThread,
+	///only the thread that created the JobSystem, which owns the GL context
+	JobGLThread,
+};
+
+///Chase-Lev work stealing deque, the owner pushes and pops at the bottom, thieves steal from the top
+class WorkStealingDeque
+{
+public:
+	explicit WorkStealingDeque(size_t capacity = 4096);
+	///owner only, false when full
+	bool Push(Job* job);
+	///owner only
+	Job* Pop();
+	///any thread
+	Job* Steal();
+private:
+	std::vector<std::atomic<Job*>> buffer;
+	int64_t mask;
+	///padding instead of alignas so the deque can still be created with plain new
+	char pad0[64];
+	std::atomic<int64_t> top;
+	char pad1[64 - sizeof(std::atomic<int64_t>)];
+	std::atomic<int64_t> bottom;
+};
+
+///work stealing scheduler, one deque per worker thread plus the creating (GL) thread as index 0
+class JobSystem
+{
+public:
+	///workerCount 0 means one per core besides the calling thread
+	explicit JobSystem(size_t workerCount = 0);
+	~JobSystem();
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	///counter may be NULL, dependency may be NULL, both must outlive the job
+	void Schedule(std::function<void()> work, JobCounter* counter, JobCounter* dependency = NULL, JobAffinity affinity = JobAnyThread);
+	///splits [begin, end) into grain sized ranges, body gets (rangeBegin, rangeEnd)
+	void ParallelFor(size_t begin, size_t end, size_t grain, std::function<void(size_t, size_t)> body, JobCounter* counter, JobCounter* dependency = NULL);
+	///runs other jobs until counter hits zero, GL thread jobs only run here when called from the GL thread
+	void Wait(JobCounter* counter);
+
+	///deque/arena index of the calling thread, 0 is the GL thread, -1 for threads the scheduler does not own
+	static int ThreadIndex();
+	size_t ThreadCount() { return this->deques.size(); }
+private:
+	void WorkerMain(size_t index);
+	void Enqueue(Job* job);
+	Job* FindJob(size_t index);
+	void Execute(Job* job);
+	void Release(JobCounter* counter);
+	std::vector<WorkStealingDeque*> deques;
+	std::vector<std::thread> workers;
+	///overflow and submissions from foreign threads
+	std::mutex injectLock;
+	std::vector<Job*> injected;
+	///JobGLThread jobs, only popped by thread 0 and in the order they were scheduled
+	std::mutex glLock;
+	std::deque<Job*> glJobs;
+	///jobs a worker could pick up, JobGLThread ones are left out since only thread 0 runs them
+	std::atomic<int> queuedJobs;
+	std::atomic<bool> running;
+	std::mutex sleepLock;
+	std::condition_variable wake;
+};
@@ -0,0 +1,158 @@
+#include "MappedFile.h"
+#include <utility>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(MappedFile&& other)
+{
+	*this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other)
+{
+	if (this == &other)
+		return *this;
+	this->Close();
+	std::swap(this->data, other.data);
+	std::swap(this->size, other.size);
+	std::swap(this->opened, other.opened);
+#ifdef _WIN32
+	std::swap(this->fileHandle, other.fileHandle);
+	std::swap(this->mappingHandle, other.mappingHandle);
+#else
+	std::swap(this->fd, other.fd);
+#endif
+	return *this;
+}
+
+#ifdef _WIN32
+bool MappedFile::Open(const char* path, MappedFileAccess access)
+{
+	this->Close();
+	DWORD flags = access == MappedSequential ? FILE_FLAG_SEQUENTIAL_SCAN : FILE_FLAG_RANDOM_ACCESS;
+	auto file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, flags, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize))
+	{
+		CloseHandle(file);
+		return false;
+	}
+	this->fileHandle = file;
+	this->size = (size_t)fileSize.QuadPart;
+	this->opened = true;
+	if (this->size == 0)
+		return true;
+	this->mappingHandle = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (this->mappingHandle == NULL)
+	{
+		this->Close();
+		return false;
+	}
+	this->data = (const unsigned char*)MapViewOfFile(this->mappingHandle, FILE_MAP_READ, 0, 0, 0);
+	if (this->data == NULL)
+	{
+		this->Close();
+		return false;
+	}
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (this->data != NULL)
+		UnmapViewOfFile(this->data);
+	if (this->mappingHandle != NULL)
+		CloseHandle(this->mappingHandle);
+	if (this->fileHandle != NULL)
+		CloseHandle(this->fileHandle);
+	this->data = NULL;
+	this->mappingHandle = NULL;
+	this->fileHandle = NULL;
+	this->size = 0;
+	this->opened = false;
+}
+
+void MappedFile::Prefetch()
+{
+	if (this->data == NULL)
+		return;
+	//PrefetchVirtualMemory is Windows 8+, look it up so the binary still starts on 7
+	typedef BOOL(WINAPI* PrefetchProc)(HANDLE, ULONG_PTR, PWIN32_MEMORY_RANGE_ENTRY, ULONG);
+	static auto prefetch = (PrefetchProc)GetProcAddress(GetModuleHandleA("kernel32.dll"), "PrefetchVirtualMemory");
+	if (prefetch == NULL)
+		return;
+	WIN32_MEMORY_RANGE_ENTRY range;
+	range.VirtualAddress = (PVOID)this->data;
+	range.NumberOfBytes = this->size;
+	prefetch(GetCurrentProcess(), 1, &range, 0);
+}
+
+void MappedFile::Release()
+{
+	//unlocking pages that were never locked trims them from the working set, the documented way to drop them
+	if (this->data != NULL)
+		VirtualUnlock((LPVOID)this->data, this->size);
+}
+#else
+bool MappedFile::Open(const char* path, MappedFileAccess access)
+{
+	this->Close();
+	int file = open(path, O_RDONLY);
+	if (file < 0)
+		return false;
+	struct stat st;
+	if (fstat(file, &st) != 0)
+	{
+		close(file);
+		return false;
+	}
+	this->fd = file;
+	this->size = (size_t)st.st_size;
+	this->opened = true;
+	if (this->size == 0)
+		return true;
+	auto p = mmap(NULL, this->size, PROT_READ, MAP_PRIVATE, file, 0);
+	if (p == MAP_FAILED)
+	{
+		this->Close();
+		return false;
+	}
+	this->data = (const unsigned char*)p;
+	madvise(p, this->size, access == MappedSequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (this->data != NULL)
+		munmap((void*)this->data, this->size);
+	if (this->fd >= 0)
+		close(this->fd);
+	this->data = NULL;
+	this->fd = -1;
+	this->size = 0;
+	this->opened = false;
+}
+
+void MappedFile::Prefetch()
+{
+	if (this->data != NULL)
+		madvise((void*)this->data, this->size, MADV_WILLNEED);
+}
+
+void MappedFile::Release()
+{
+	if (this->data != NULL)
+		madvise((void*)this->data, this->size, MADV_DONTNEED);
+}
+#endif
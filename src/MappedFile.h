@@ -0,0 +1,41 @@
+#pragma once
+#include <cstddef>
+
+enum MappedFileAccess
+{
+	///read front to back once, lets the OS read ahead aggressively and drop pages behind us
+	MappedSequential,
+	MappedRandom,
+};
+
+///read only memory mapping of a whole file, the pointer stays valid until Close or destruction
+class MappedFile
+{
+public:
+	MappedFile() {}
+	~MappedFile() { this->Close(); }
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	MappedFile(MappedFile&& other);
+	MappedFile& operator=(MappedFile&& other);
+	bool Open(const char* path, MappedFileAccess access = MappedSequential);
+	void Close();
+	///asks the OS to start reading the pages in now, e.g. before handing the file to a decoder on another thread
+	void Prefetch();
+	///tells the OS the pages can be dropped, after the data was uploaded or decoded
+	void Release();
+	const unsigned char* Data() const { return this->data; }
+	size_t Size() const { return this->size; }
+	bool IsOpen() const { return this->data != NULL || this->opened; }
+private:
+	const unsigned char* data = NULL;
+	size_t size = 0;
+	///an empty file opens fine but has nothing to map
+	bool opened = false;
+#ifdef _WIN32
+	void* fileHandle = NULL;
+	void* mappingHandle = NULL;
+#else
+	int fd = -1;
+#endif
+};
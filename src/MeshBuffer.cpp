@@ -0,0 +1,152 @@
+#include "MeshBuffer.h"
+
+MeshBuffer::MeshBuffer(const std::vector<MeshAttribute>& layout, GLsizei stride, GLuint vertexCapacity, GLuint indexCapacity)
+	: layout(layout),
+	stride(stride),
+	vertexRanges(vertexCapacity),
+	indexRanges(indexCapacity)
+{
+	glGenVertexArrays(1, &this->VAOID);
+	glGenBuffers(1, &this->VBOID);
+	glGenBuffers(1, &this->EBOID);
+	glBindVertexArray(this->VAOID);
+	glBindBuffer(GL_ARRAY_BUFFER, this->VBOID);
+	glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)vertexCapacity * stride, NULL, GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->EBOID);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)indexCapacity * sizeof(GLuint), NULL, GL_STATIC_DRAW);
+	this->SetupAttributes();
+	glBindVertexArray(0);
+}
+
+MeshBuffer::~MeshBuffer()
+{
+	glDeleteVertexArrays(1, &this->VAOID);
+	glDeleteBuffers(1, &this->VBOID);
+	glDeleteBuffers(1, &this->EBOID);
+}
+
+bool MeshBuffer::HasLayout(const std::vector<MeshAttribute>& layout, GLsizei stride) const
+{
+	if (stride != this->stride || layout.size() != this->layout.size())
+		return false;
+	for (size_t i = 0; i < layout.size(); i++)
+	{
+		auto& a = layout[i];
+		auto& b = this->layout[i];
+		if (a.Location != b.Location || a.Components != b.Components || a.Type != b.Type || a.Normalized != b.Normalized || a.Integer != b.Integer || a.Offset != b.Offset)
+			return false;
+	}
+	return true;
+}
+
+void MeshBuffer::SetupAttributes()
+{
+	//VAO must be bound, the element buffer binding is part of its state
+	glBindBuffer(GL_ARRAY_BUFFER, this->VBOID);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->EBOID);
+	for (auto& a : this->layout)
+	{
+		if (a.Integer)
+			glVertexAttribIPointer(a.Location, a.Components, a.Type, this->stride, (void*)(size_t)a.Offset);
+		else
+			glVertexAttribPointer(a.Location, a.Components, a.Type, a.Normalized, this->stride, (void*)(size_t)a.Offset);
+		glEnableVertexAttribArray(a.Location);
+	}
+}
+
+GLuint MeshBuffer::ResizeBuffer(GLuint oldBuffer, GLsizeiptr oldSize, GLsizeiptr newSize)
+{
+	//copy through the dedicated copy targets so no VAO or draw binding is disturbed
+	GLuint buffer;
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+	glBufferData(GL_COPY_WRITE_BUFFER, newSize, NULL, GL_STATIC_DRAW);
+	glBindBuffer(GL_COPY_READ_BUFFER, oldBuffer);
+	if (oldSize > 0)
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, oldSize);
+	glDeleteBuffers(1, &oldBuffer);
+	return buffer;
+}
+
+bool MeshBuffer::GrowVertices(GLuint minCapacity)
+{
+	auto old = this->vertexRanges.GetCapacity();
+	auto capacity = old > 0 ? old : 1024u;
+	while (capacity < minCapacity)
+	{
+		if (capacity > 0x7fffffffu)
+			return false;
+		capacity *= 2;
+	}
+	this->VBOID = ResizeBuffer(this->VBOID, (GLsizeiptr)old * this->stride, (GLsizeiptr)capacity * this->stride);
+	this->vertexRanges.Grow(capacity);
+	glBindVertexArray(this->VAOID);
+	this->SetupAttributes();
+	glBindVertexArray(0);
+	return true;
+}
+
+bool MeshBuffer::GrowIndices(GLuint minCapacity)
+{
+	auto old = this->indexRanges.GetCapacity();
+	auto capacity = old > 0 ? old : 4096u;
+	while (capacity < minCapacity)
+	{
+		if (capacity > 0x7fffffffu)
+			return false;
+		capacity *= 2;
+	}
+	this->EBOID = ResizeBuffer(this->EBOID, (GLsizeiptr)old * sizeof(GLuint), (GLsizeiptr)capacity * sizeof(GLuint));
+	this->indexRanges.Grow(capacity);
+	glBindVertexArray(this->VAOID);
+	this->SetupAttributes();
+	glBindVertexArray(0);
+	return true;
+}
+
+MeshHandle MeshBuffer::Upload(const void* vertices, GLsizei vertexCount, const GLuint* indices, GLsizei indexCount)
+{
+	MeshHandle handle;
+	if (vertexCount <= 0 || indexCount <= 0)
+		return handle;
+	handle.Vertices = this->vertexRanges.Allocate(vertexCount);
+	if (!handle.Vertices.IsValid())
+	{
+		//twice the request leaves room for the allocator's bin rounding even if nothing at the end was free
+		if (!this->GrowVertices(this->vertexRanges.GetCapacity() + 2 * (GLuint)vertexCount))
+			return handle;
+		handle.Vertices = this->vertexRanges.Allocate(vertexCount);
+	}
+	handle.Indices = this->indexRanges.Allocate(indexCount);
+	if (!handle.Indices.IsValid())
+	{
+		if (this->GrowIndices(this->indexRanges.GetCapacity() + 2 * (GLuint)indexCount))
+			handle.Indices = this->indexRanges.Allocate(indexCount);
+	}
+	if (!handle.IsValid())
+	{
+		this->Free(handle);
+		return handle;
+	}
+	handle.BaseVertex = (GLint)handle.Vertices.Offset;
+	handle.FirstIndex = handle.Indices.Offset;
+	handle.VertexCount = vertexCount;
+	handle.IndexCount = indexCount;
+	glBindBuffer(GL_COPY_WRITE_BUFFER, this->VBOID);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)handle.Vertices.Offset * this->stride, (GLsizeiptr)vertexCount * this->stride, vertices);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, this->EBOID);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)handle.Indices.Offset * sizeof(GLuint), (GLsizeiptr)indexCount * sizeof(GLuint), indices);
+	return handle;
+}
+
+void MeshBuffer::Free(MeshHandle& handle)
+{
+	this->vertexRanges.Free(handle.Vertices);
+	this->indexRanges.Free(handle.Indices);
+	handle = MeshHandle();
+}
+
+void MeshBuffer::Draw(const MeshHandle& handle)
+{
+	glDrawElementsBaseVertex(GL_TRIANGLES, handle.IndexCount, GL_UNSIGNED_INT, (void*)IndexByteOffset(handle), handle.BaseVertex);
+}
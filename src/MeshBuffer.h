@@ -0,0 +1,64 @@
+#pragma once
+#include "../include/glad/glad.h"
+#include "RangeAllocator.h"
+#include <vector>
+
+///one interleaved vertex attribute of a MeshBuffer layout
+struct MeshAttribute
+{
+	GLuint Location;
+	GLint Components;
+	GLenum Type;
+	GLboolean Normalized;
+	///read with glVertexAttribIPointer, for integer attributes the shader sees as ivec/uvec
+	GLboolean Integer;
+	GLuint Offset;
+};
+
+///where a mesh lives inside the shared buffers, everything glDrawElementsBaseVertex needs
+struct MeshHandle
+{
+	RangeAllocator::Allocation Vertices;
+	RangeAllocator::Allocation Indices;
+	GLint BaseVertex = 0;
+	GLuint FirstIndex = 0;
+	GLsizei IndexCount = 0;
+	GLsizei VertexCount = 0;
+	bool IsValid() const { return this->Vertices.IsValid() && this->Indices.IsValid(); }
+};
+
+///packs many meshes with the same vertex layout into one big vertex buffer and one big 32 bit
+///index buffer behind a single VAO, so drawing them needs no VAO/VBO rebinds in between
+class MeshBuffer
+{
+public:
+	MeshBuffer(const std::vector<MeshAttribute>& layout, GLsizei stride, GLuint vertexCapacity, GLuint indexCapacity);
+	~MeshBuffer();
+	///indices are relative to the mesh's own vertices, the handle's BaseVertex offsets them at draw time.
+	///grows the buffers when full, returns an invalid handle only if that fails too
+	MeshHandle Upload(const void* vertices, GLsizei vertexCount, const GLuint* indices, GLsizei indexCount);
+	void Free(MeshHandle& handle);
+	bool UseThisVAO() { glBindVertexArray(this->VAOID); return true; }
+	///VAO has to be bound
+	void Draw(const MeshHandle& handle);
+	GLuint GetVAOId() { return this->VAOID; }
+	GLuint GetVertexBufferId() { return this->VBOID; }
+	GLuint GetIndexBufferId() { return this->EBOID; }
+	GLsizei GetStride() { return this->stride; }
+	///meshes can only share this buffer when their vertices look exactly like this
+	bool HasLayout(const std::vector<MeshAttribute>& layout, GLsizei stride) const;
+	///byte offset of the handle's first index in the element buffer
+	static size_t IndexByteOffset(const MeshHandle& handle) { return (size_t)handle.FirstIndex * sizeof(GLuint); }
+private:
+	void SetupAttributes();
+	bool GrowVertices(GLuint minCapacity);
+	bool GrowIndices(GLuint minCapacity);
+	static GLuint ResizeBuffer(GLuint oldBuffer, GLsizeiptr oldSize, GLsizeiptr newSize);
+	std::vector<MeshAttribute> layout;
+	GLsizei stride;
+	GLuint VAOID = 0;
+	GLuint VBOID = 0;
+	GLuint EBOID = 0;
+	RangeAllocator vertexRanges;
+	RangeAllocator indexRanges;
+};
@@ -0,0 +1,335 @@
+#include "MeshBuilder.h"
+#include "../include/glm/gtc/packing.hpp"
+#include <cstring>
+#include <unordered_map>
+
+//welding keys are the packed vertices themselves, hashed and compared in place instead of copied into strings
+struct PackedVertexHash
+{
+	size_t stride;
+	size_t operator()(const uint8_t* v) const
+	{
+		//FNV-1a
+		uint64_t hash = 14695981039346656037ull;
+		for (size_t i = 0; i < this->stride; i++)
+			hash = (hash ^ v[i]) * 1099511628211ull;
+		return (size_t)hash;
+	}
+};
+
+struct PackedVertexEqual
+{
+	size_t stride;
+	bool operator()(const uint8_t* a, const uint8_t* b) const { return memcmp(a, b, this->stride) == 0; }
+};
+
+std::vector<uint32_t> MeshBuilder::PackHalf2(const float* data, size_t count)
+{
+	std::vector<uint32_t> packed(count);
+	for (size_t i = 0; i < count; i++)
+		packed[i] = glm::packHalf2x16(glm::vec2(data[i * 2], data[i * 2 + 1]));
+	return packed;
+}
+
+std::vector<uint32_t> MeshBuilder::PackSnorm10Normals(const float* data, size_t count)
+{
+	std::vector<uint32_t> packed(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		auto n = glm::vec3(data[i * 3], data[i * 3 + 1], data[i * 3 + 2]);
+		auto len = glm::length(n);
+		packed[i] = glm::packSnorm3x10_1x2(glm::vec4(len > 0 ? n / len : n, 0.0f));
+	}
+	return packed;
+}
+
+std::vector<uint32_t> MeshBuilder::PackSnorm10Tangents(const float* data, size_t count)
+{
+	std::vector<uint32_t> packed(count);
+	for (size_t i = 0; i < count; i++)
+		packed[i] = PackSnorm10Tangent(data + i * 4);
+	return packed;
+}
+
+uint32_t MeshBuilder::PackSnorm10Tangent(const float* tangent)
+{
+	auto t = glm::vec3(tangent[0], tangent[1], tangent[2]);
+	auto len = glm::length(t);
+	return glm::packSnorm3x10_1x2(glm::vec4(len > 0 ? t / len : t, tangent[3] < 0 ? -1.0f : 1.0f));
+}
+
+uint32_t MeshBuilder::OctahedralEncode(glm::vec3 n)
+{
+	n /= (fabs(n.x) + fabs(n.y) + fabs(n.z));
+	glm::vec2 e(n.x, n.y);
+	if (n.z < 0)
+	{
+		e = glm::vec2((1.0f - fabs(n.y)) * (n.x >= 0 ? 1.0f : -1.0f),
+			(1.0f - fabs(n.x)) * (n.y >= 0 ? 1.0f : -1.0f));
+	}
+	return glm::packSnorm2x16(e);
+}
+
+glm::vec3 MeshBuilder::OctahedralDecode(uint32_t packed)
+{
+	//same math the shader needs:
+	//vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y)); if (n.z < 0) n.xy = (1.0 - abs(n.yx)) * sign(n.xy); normalize(n)
+	auto e = glm::unpackSnorm2x16(packed);
+	glm::vec3 n(e.x, e.y, 1.0f - fabs(e.x) - fabs(e.y));
+	if (n.z < 0)
+	{
+		auto x = (1.0f - fabs(n.y)) * (n.x >= 0 ? 1.0f : -1.0f);
+		auto y = (1.0f - fabs(n.x)) * (n.y >= 0 ? 1.0f : -1.0f);
+		n.x = x;
+		n.y = y;
+	}
+	return glm::normalize(n);
+}
+
+static void AddAttribute(std::vector<MeshAttribute>& layout, GLint location, GLint components, GLenum type, GLboolean normalized, GLuint& offset, GLuint size)
+{
+	MeshAttribute a;
+	a.Location = (GLuint)location;
+	a.Components = components;
+	a.Type = type;
+	a.Normalized = normalized;
+	a.Integer = GL_FALSE;
+	a.Offset = offset;
+	layout.push_back(a);
+	offset += size;
+}
+
+bool MeshBuilder::Build(const MeshSource& source, const MeshCompression& compression, const MeshAttributeLocations& locations, BuiltMesh* mesh)
+{
+	if (source.Positions == NULL || source.VertexCount == 0 || mesh == NULL)
+		return false;
+	auto count = source.VertexCount;
+	*mesh = BuiltMesh();
+
+	glm::vec3 lo(source.Positions[0], source.Positions[1], source.Positions[2]);
+	glm::vec3 hi = lo;
+	for (size_t i = 1; i < count; i++)
+	{
+		glm::vec3 p(source.Positions[i * 3], source.Positions[i * 3 + 1], source.Positions[i * 3 + 2]);
+		lo = glm::min(lo, p);
+		hi = glm::max(hi, p);
+	}
+	mesh->BoundsMin = lo;
+	mesh->BoundsMax = hi;
+
+	bool usePos = locations.Position >= 0;
+	bool useUV = locations.TexCoord >= 0 && source.TexCoords != NULL;
+	bool useNormal = locations.Normal >= 0 && source.Normals != NULL;
+	bool useTangent = locations.Tangent >= 0 && source.Tangents != NULL;
+
+	//widest attributes first, every size here is a multiple of 4 so nothing needs padding
+	GLuint offset = 0;
+	GLuint posOffset = 0, normalOffset = 0, tangentOffset = 0, uvOffset = 0;
+	if (usePos)
+	{
+		posOffset = offset;
+		if (compression.Positions == PositionUnorm16)
+			AddAttribute(mesh->Layout, locations.Position, 3, GL_UNSIGNED_SHORT, GL_TRUE, offset, 8);
+		else
+			AddAttribute(mesh->Layout, locations.Position, 3, GL_FLOAT, GL_FALSE, offset, 12);
+	}
+	if (useNormal)
+	{
+		normalOffset = offset;
+		if (compression.Normals == NormalSnorm10)
+			AddAttribute(mesh->Layout, locations.Normal, 4, GL_INT_2_10_10_10_REV, GL_TRUE, offset, 4);
+		else if (compression.Normals == NormalOctahedral16)
+			AddAttribute(mesh->Layout, locations.Normal, 2, GL_SHORT, GL_TRUE, offset, 4);
+		else
+			AddAttribute(mesh->Layout, locations.Normal, 3, GL_FLOAT, GL_FALSE, offset, 12);
+	}
+	if (useTangent)
+	{
+		tangentOffset = offset;
+		if (compression.Normals == NormalFloat)
+			AddAttribute(mesh->Layout, locations.Tangent, 4, GL_FLOAT, GL_FALSE, offset, 16);
+		else
+			AddAttribute(mesh->Layout, locations.Tangent, 4, GL_INT_2_10_10_10_REV, GL_TRUE, offset, 4);
+	}
+	if (useUV)
+	{
+		uvOffset = offset;
+		if (compression.HalfTexCoords)
+			AddAttribute(mesh->Layout, locations.TexCoord, 2, GL_HALF_FLOAT, GL_FALSE, offset, 4);
+		else
+			AddAttribute(mesh->Layout, locations.TexCoord, 2, GL_FLOAT, GL_FALSE, offset, 8);
+	}
+	mesh->Stride = (GLsizei)offset;
+
+	glm::vec3 extent = hi - lo;
+	glm::vec3 invExtent(extent.x > 0 ? 1.0f / extent.x : 0.0f, extent.y > 0 ? 1.0f / extent.y : 0.0f, extent.z > 0 ? 1.0f / extent.z : 0.0f);
+	if (compression.Positions == PositionUnorm16)
+	{
+		mesh->PositionScale = extent;
+		mesh->PositionBias = lo;
+	}
+
+	//pack every source vertex, then weld identical packed vertices, quantization often merges more of them
+	std::vector<unsigned char> packed(count * offset);
+	for (size_t i = 0; i < count; i++)
+	{
+		auto v = packed.data() + i * offset;
+		if (usePos)
+		{
+			glm::vec3 p(source.Positions[i * 3], source.Positions[i * 3 + 1], source.Positions[i * 3 + 2]);
+			if (compression.Positions == PositionUnorm16)
+			{
+				auto q = glm::packUnorm4x16(glm::vec4((p - lo) * invExtent, 0.0f));
+				memcpy(v + posOffset, &q, 8);
+			}
+			else
+				memcpy(v + posOffset, &p, 12);
+		}
+		if (useNormal)
+		{
+			auto n = glm::vec3(source.Normals[i * 3], source.Normals[i * 3 + 1], source.Normals[i * 3 + 2]);
+			auto len = glm::length(n);
+			if (len > 0)
+				n /= len;
+			if (compression.Normals == NormalSnorm10)
+			{
+				auto q = glm::packSnorm3x10_1x2(glm::vec4(n, 0.0f));
+				memcpy(v + normalOffset, &q, 4);
+			}
+			else if (compression.Normals == NormalOctahedral16)
+			{
+				auto q = OctahedralEncode(len > 0 ? n : glm::vec3(0, 0, 1));
+				memcpy(v + normalOffset, &q, 4);
+			}
+			else
+				memcpy(v + normalOffset, &n, 12);
+		}
+		if (useTangent)
+		{
+			auto t = source.Tangents + i * 4;
+			if (compression.Normals == NormalFloat)
+				memcpy(v + tangentOffset, t, 16);
+			else
+			{
+				auto q = PackSnorm10Tangent(t);
+				memcpy(v + tangentOffset, &q, 4);
+			}
+		}
+		if (useUV)
+		{
+			if (compression.HalfTexCoords)
+			{
+				auto q = glm::packHalf2x16(glm::vec2(source.TexCoords[i * 2], source.TexCoords[i * 2 + 1]));
+				memcpy(v + uvOffset, &q, 4);
+			}
+			else
+				memcpy(v + uvOffset, source.TexCoords + i * 2, 8);
+		}
+	}
+
+	std::vector<GLuint> remap(count);
+	PackedVertexHash hash = { offset };
+	PackedVertexEqual equal = { offset };
+	std::unordered_map<const uint8_t*, GLuint, PackedVertexHash, PackedVertexEqual> unique(count, hash, equal);
+	mesh->Vertices.reserve(count * offset);
+	for (size_t i = 0; i < count; i++)
+	{
+		//keys point into packed, which stays put until the loop is over
+		auto key = packed.data() + i * offset;
+		auto it = unique.find(key);
+		if (it != unique.end())
+		{
+			remap[i] = it->second;
+			continue;
+		}
+		auto index = (GLuint)mesh->VertexCount++;
+		unique.emplace(key, index);
+		remap[i] = index;
+		mesh->Vertices.insert(mesh->Vertices.end(), packed.begin() + i * offset, packed.begin() + (i + 1) * offset);
+	}
+
+	if (source.Indices != NULL)
+	{
+		mesh->Indices.resize(source.IndexCount);
+		for (size_t i = 0; i < source.IndexCount; i++)
+		{
+			if (source.Indices[i] >= count)
+				return false;
+			mesh->Indices[i] = remap[source.Indices[i]];
+		}
+	}
+	else
+		mesh->Indices = remap;
+	return true;
+}
+
+bool MeshBuilder::DecodeAttribute(const BuiltMesh& mesh, GLint location, int components, std::vector<float>& out)
+{
+	const MeshAttribute* attribute = NULL;
+	for (auto& a : mesh.Layout)
+	{
+		if (location >= 0 && a.Location == (GLuint)location)
+			attribute = &a;
+	}
+	if (attribute == NULL || components <= 0)
+		return false;
+	out.assign((size_t)mesh.VertexCount * components, 0.0f);
+	for (GLsizei i = 0; i < mesh.VertexCount; i++)
+	{
+		auto v = mesh.Vertices.data() + (size_t)i * mesh.Stride + attribute->Offset;
+		float decoded[4] = {};
+		int count = attribute->Components;
+		if (attribute->Type == GL_FLOAT)
+			memcpy(decoded, v, count * sizeof(float));
+		else if (attribute->Type == GL_HALF_FLOAT)
+		{
+			for (int c = 0; c < count; c++)
+			{
+				uint16_t h;
+				memcpy(&h, v + c * 2, 2);
+				decoded[c] = glm::unpackHalf1x16(h);
+			}
+		}
+		else if (attribute->Type == GL_UNSIGNED_SHORT)
+		{
+			for (int c = 0; c < count; c++)
+			{
+				uint16_t u;
+				memcpy(&u, v + c * 2, 2);
+				decoded[c] = attribute->Normalized ? u / 65535.0f : u;
+			}
+		}
+		else if (attribute->Type == GL_SHORT && count == 2 && components >= 3)
+		{
+			uint32_t packed;
+			memcpy(&packed, v, 4);
+			auto n = OctahedralDecode(packed);
+			decoded[0] = n.x;
+			decoded[1] = n.y;
+			decoded[2] = n.z;
+			count = 3;
+		}
+		else if (attribute->Type == GL_SHORT)
+		{
+			for (int c = 0; c < count; c++)
+			{
+				int16_t s;
+				memcpy(&s, v + c * 2, 2);
+				decoded[c] = attribute->Normalized ? glm::max(s / 32767.0f, -1.0f) : s;
+			}
+		}
+		else if (attribute->Type == GL_INT_2_10_10_10_REV)
+		{
+			uint32_t packed;
+			memcpy(&packed, v, 4);
+			auto n = glm::unpackSnorm3x10_1x2(packed);
+			for (int c = 0; c < 4; c++)
+				decoded[c] = n[c];
+		}
+		else
+			return false;
+		for (int c = 0; c < components && c < count; c++)
+			out[(size_t)i * components + c] = decoded[c];
+	}
+	return true;
+}
@@ -0,0 +1,103 @@
+#pragma once
+#include "../include/glad/glad.h"
+#include "../include/glm/glm.hpp"
+#include "MeshBuffer.h"
+#include <cstdint>
+#include <vector>
+
+enum PositionFormat
+{
+	///3 x float, 12 bytes
+	PositionFloat,
+	///4 x GL_UNSIGNED_SHORT normalized, 8 bytes, modelvertex.shader applies PositionScale/PositionBias per draw
+	PositionUnorm16,
+};
+
+enum NormalFormat
+{
+	///3 x float, 12 bytes
+	NormalFloat,
+	///GL_INT_2_10_10_10_REV normalized, 4 bytes, reads as a plain vec3/vec4 in the shader
+	NormalSnorm10,
+	///octahedral 2 x GL_SHORT normalized, 4 bytes, modelvertex.shader decodes it when octahedralNormals is set
+	NormalOctahedral16,
+};
+
+struct MeshCompression
+{
+	PositionFormat Positions = PositionFloat;
+	NormalFormat Normals = NormalSnorm10;
+	///2 x GL_HALF_FLOAT instead of 2 x float
+	bool HalfTexCoords = true;
+};
+
+///plain float streams like main's vertices/vertexMap/normals arrays, anything but Positions may be NULL
+struct MeshSource
+{
+	const float* Positions = NULL;
+	const float* TexCoords = NULL;
+	const float* Normals = NULL;
+	///xyz + handedness sign in w
+	const float* Tangents = NULL;
+	size_t VertexCount = 0;
+	///NULL means every three vertices are a triangle, as with glDrawArrays
+	const GLuint* Indices = NULL;
+	size_t IndexCount = 0;
+};
+
+///shader attribute locations, -1 leaves the stream out of the vertex
+struct MeshAttributeLocations
+{
+	GLint Position = 0;
+	GLint TexCoord = 1;
+	GLint Normal = 2;
+	GLint Tangent = -1;
+};
+
+///one level of detail, a range of BuiltMesh::Indices over the same vertices
+struct MeshLod
+{
+	GLuint FirstIndex = 0;
+	GLuint IndexCount = 0;
+	///object space distance the level may be off from the full mesh, 0 for LOD 0
+	float Error = 0;
+};
+
+struct BuiltMesh
+{
+	std::vector<unsigned char> Vertices;
+	std::vector<GLuint> Indices;
+	std::vector<MeshAttribute> Layout;
+	GLsizei Stride = 0;
+	GLsizei VertexCount = 0;
+	///position = stored * PositionScale + PositionBias, identity unless PositionUnorm16
+	glm::vec3 PositionScale = glm::vec3(1.0f);
+	glm::vec3 PositionBias = glm::vec3(0.0f);
+	glm::vec3 BoundsMin;
+	glm::vec3 BoundsMax;
+	///finest first, empty means all of Indices is the only level
+	std::vector<MeshLod> Lods;
+};
+
+///turns float streams into one interleaved, welded, indexed vertex blob ready for MeshBuffer,
+///quantizing attributes on the way (32 bytes per pos/uv/normal vertex down to 16 with everything on)
+class MeshBuilder
+{
+public:
+	static bool Build(const MeshSource& source, const MeshCompression& compression, const MeshAttributeLocations& locations, BuiltMesh* mesh);
+
+	///packers for code that keeps one VertexBufferObject per attribute
+	static std::vector<uint32_t> PackHalf2(const float* data, size_t count);
+	static std::vector<uint32_t> PackSnorm10Normals(const float* data, size_t count);
+	///xyz + sign in w packed into the 2 bit w field
+	static std::vector<uint32_t> PackSnorm10Tangents(const float* data, size_t count);
+	///one tangent of the above, no vector on the way
+	static uint32_t PackSnorm10Tangent(const float* tangent);
+
+	static uint32_t OctahedralEncode(glm::vec3 n);
+	static glm::vec3 OctahedralDecode(uint32_t packed);
+
+	///reads one attribute of every vertex back as components floats, octahedral normals come back as xyz.
+	///unorm16 positions come back in 0..1, PositionScale/PositionBias still need applying
+	static bool DecodeAttribute(const BuiltMesh& mesh, GLint location, int components, std::vector<float>& out);
+};
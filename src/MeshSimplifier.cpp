@@ -0,0 +1,349 @@
+#include "MeshSimplifier.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+//border planes get this much more weight than surface planes so open edges keep their outline
+static const double BorderWeight = 10.0;
+
+///symmetric 4x4 plane quadric plus the area it was accumulated over
+struct Quadric
+{
+	double A00 = 0, A01 = 0, A02 = 0, A11 = 0, A12 = 0, A22 = 0;
+	double B0 = 0, B1 = 0, B2 = 0;
+	double C = 0;
+	double Weight = 0;
+	void AddPlane(const glm::dvec3& n, double d, double w)
+	{
+		this->A00 += w * n.x * n.x;
+		this->A01 += w * n.x * n.y;
+		this->A02 += w * n.x * n.z;
+		this->A11 += w * n.y * n.y;
+		this->A12 += w * n.y * n.z;
+		this->A22 += w * n.z * n.z;
+		this->B0 += w * n.x * d;
+		this->B1 += w * n.y * d;
+		this->B2 += w * n.z * d;
+		this->C += w * d * d;
+		this->Weight += w;
+	}
+	void Add(const Quadric& q)
+	{
+		this->A00 += q.A00; this->A01 += q.A01; this->A02 += q.A02;
+		this->A11 += q.A11; this->A12 += q.A12; this->A22 += q.A22;
+		this->B0 += q.B0; this->B1 += q.B1; this->B2 += q.B2;
+		this->C += q.C;
+		this->Weight += q.Weight;
+	}
+	///area weighted mean squared distance of p to the planes
+	double Error(const glm::dvec3& p) const
+	{
+		double e = this->A00 * p.x * p.x + this->A11 * p.y * p.y + this->A22 * p.z * p.z
+			+ 2 * (this->A01 * p.x * p.y + this->A02 * p.x * p.z + this->A12 * p.y * p.z)
+			+ 2 * (this->B0 * p.x + this->B1 * p.y + this->B2 * p.z) + this->C;
+		return this->Weight > 0 ? fabs(e) / this->Weight : 0;
+	}
+};
+
+struct PositionKey
+{
+	uint32_t X, Y, Z;
+	bool operator==(const PositionKey& o) const { return this->X == o.X && this->Y == o.Y && this->Z == o.Z; }
+};
+
+struct PositionKeyHash
+{
+	size_t operator()(const PositionKey& k) const { return (size_t)(k.X * 73856093u ^ k.Y * 19349663u ^ k.Z * 83492791u); }
+};
+
+struct Collapse
+{
+	GLuint From;
+	GLuint To;
+	double Cost;
+	double Geometric;
+	bool operator<(const Collapse& o) const { return this->Cost < o.Cost; }
+};
+
+static uint64_t EdgeKey(GLuint a, GLuint b)
+{
+	return ((uint64_t)a << 32) | b;
+}
+
+std::vector<GLuint> MeshSimplifier::Simplify(const float* positions, const float* attributes, const float* attributeWeights, size_t attributeCount,
+	size_t vertexCount, const GLuint* indices, size_t indexCount, size_t targetIndexCount, float maxError, bool lockBorder, float* resultError)
+{
+	std::vector<GLuint> current(indices, indices + indexCount);
+	if (resultError)
+		*resultError = 0;
+	if (vertexCount == 0 || indexCount % 3 != 0 || indexCount <= targetIndexCount)
+		return current;
+
+	//work in a unit sized box so errors and attribute weights mean the same on every mesh
+	glm::dvec3 lo(DBL_MAX), hi(-DBL_MAX);
+	for (size_t i = 0; i < vertexCount; i++)
+	{
+		glm::dvec3 p(positions[i * 3], positions[i * 3 + 1], positions[i * 3 + 2]);
+		lo = glm::min(lo, p);
+		hi = glm::max(hi, p);
+	}
+	double scale = glm::max(hi.x - lo.x, glm::max(hi.y - lo.y, hi.z - lo.z));
+	double invScale = scale > 0 ? 1.0 / scale : 1.0;
+	std::vector<glm::dvec3> points(vertexCount);
+	for (size_t i = 0; i < vertexCount; i++)
+		points[i] = (glm::dvec3(positions[i * 3], positions[i * 3 + 1], positions[i * 3 + 2]) - lo) * invScale;
+
+	//vertices split by uv/normal seams share a position, topology and quadrics work on those groups
+	std::vector<GLuint> group(vertexCount);
+	std::vector<GLuint> groupSize(vertexCount, 0);
+	{
+		std::unordered_map<PositionKey, GLuint, PositionKeyHash> unique;
+		unique.reserve(vertexCount);
+		for (size_t i = 0; i < vertexCount; i++)
+		{
+			PositionKey key;
+			memcpy(&key, positions + i * 3, sizeof(key));
+			auto it = unique.emplace(key, (GLuint)i).first;
+			group[i] = it->second;
+			groupSize[it->second]++;
+		}
+	}
+	std::vector<bool> locked(vertexCount, false);
+	for (size_t i = 0; i < vertexCount; i++)
+		locked[i] = groupSize[group[i]] > 1;
+
+	std::unordered_map<uint64_t, int> directedEdges;
+	directedEdges.reserve(indexCount);
+	for (size_t i = 0; i < indexCount; i++)
+	{
+		auto a = group[indices[i]];
+		auto b = group[indices[i - i % 3 + (i + 1) % 3]];
+		directedEdges[EdgeKey(a, b)]++;
+	}
+
+	std::vector<Quadric> quadrics(vertexCount);
+	for (size_t t = 0; t < indexCount; t += 3)
+	{
+		GLuint g[3] = { group[indices[t]], group[indices[t + 1]], group[indices[t + 2]] };
+		auto n = glm::cross(points[g[1]] - points[g[0]], points[g[2]] - points[g[0]]);
+		auto length = glm::length(n);
+		if (length <= 0)
+			continue;
+		n /= length;
+		for (int k = 0; k < 3; k++)
+			quadrics[g[k]].AddPlane(n, -glm::dot(n, points[g[0]]), length * 0.5);
+		//an edge nobody walks the other way is open, pin it with a plane standing on it
+		for (int k = 0; k < 3; k++)
+		{
+			auto a = g[k], b = g[(k + 1) % 3];
+			if (directedEdges.count(EdgeKey(b, a)))
+				continue;
+			auto edge = points[b] - points[a];
+			auto edgeLength = glm::length(edge);
+			if (edgeLength <= 0)
+				continue;
+			auto side = glm::normalize(glm::cross(edge / edgeLength, n));
+			auto d = -glm::dot(side, points[a]);
+			quadrics[a].AddPlane(side, d, edgeLength * edgeLength * BorderWeight);
+			quadrics[b].AddPlane(side, d, edgeLength * edgeLength * BorderWeight);
+			if (lockBorder)
+			{
+				locked[a] = true;
+				locked[b] = true;
+			}
+		}
+	}
+	//border state was found per group, spread it to every vertex of the group
+	for (size_t i = 0; i < vertexCount; i++)
+		locked[i] = locked[i] || locked[group[i]];
+
+	double maxErrorSq = maxError < FLT_MAX ? (double)maxError * invScale * maxError * invScale : DBL_MAX;
+	double geometricMax = 0;
+	std::vector<GLuint> collapseTo(vertexCount);
+	std::vector<bool> touched(vertexCount);
+	std::vector<GLuint> triangleStart(vertexCount + 1), triangleList;
+	std::vector<Collapse> candidates;
+	while (current.size() > targetIndexCount)
+	{
+		//vertex -> triangle adjacency of the current index list
+		std::fill(triangleStart.begin(), triangleStart.end(), 0);
+		for (auto v : current)
+			triangleStart[v + 1]++;
+		for (size_t i = 0; i < vertexCount; i++)
+			triangleStart[i + 1] += triangleStart[i];
+		triangleList.resize(current.size());
+		{
+			std::vector<GLuint> fill(triangleStart.begin(), triangleStart.end() - 1);
+			for (size_t i = 0; i < current.size(); i++)
+				triangleList[fill[current[i]]++] = (GLuint)(i / 3);
+		}
+
+		candidates.clear();
+		for (size_t i = 0; i < current.size(); i++)
+		{
+			auto a = current[i];
+			auto b = current[i - i % 3 + (i + 1) % 3];
+			//interior edges show up once each way, only open edges need both directions from one triangle
+			for (int direction = 0; direction < (lockBorder ? 1 : 2); direction++, std::swap(a, b))
+			{
+				if (locked[a])
+					continue;
+				Quadric q = quadrics[a];
+				q.Add(quadrics[group[b]]);
+				Collapse c;
+				c.From = a;
+				c.To = b;
+				c.Geometric = q.Error(points[b]);
+				c.Cost = c.Geometric;
+				for (size_t k = 0; attributes && k < attributeCount; k++)
+				{
+					double delta = (attributes[a * attributeCount + k] - attributes[b * attributeCount + k]) * (attributeWeights ? attributeWeights[k] : 1.0f);
+					c.Cost += delta * delta;
+				}
+				candidates.push_back(c);
+			}
+		}
+		std::sort(candidates.begin(), candidates.end());
+
+		//each collapse removes about two triangles, stop the pass once enough are queued
+		size_t limit = glm::max((current.size() - targetIndexCount) / 6, (size_t)1);
+		size_t collapsed = 0;
+		std::fill(touched.begin(), touched.end(), false);
+		for (size_t i = 0; i < vertexCount; i++)
+			collapseTo[i] = (GLuint)i;
+		for (auto& c : candidates)
+		{
+			if (collapsed >= limit || c.Cost > maxErrorSq)
+				break;
+			if (touched[c.From] || touched[c.To])
+				continue;
+			//moving From onto To must not turn any surviving triangle around
+			bool flips = false;
+			for (auto t = triangleStart[c.From]; t < triangleStart[c.From + 1] && !flips; t++)
+			{
+				auto tri = &current[triangleList[t] * 3];
+				if (group[tri[0]] == group[c.To] || group[tri[1]] == group[c.To] || group[tri[2]] == group[c.To])
+					continue;
+				glm::dvec3 p[3] = { points[tri[0]], points[tri[1]], points[tri[2]] };
+				auto before = glm::cross(p[1] - p[0], p[2] - p[0]);
+				for (int k = 0; k < 3; k++)
+				{
+					if (tri[k] == c.From)
+						p[k] = points[c.To];
+				}
+				auto after = glm::cross(p[1] - p[0], p[2] - p[0]);
+				flips = glm::dot(before, after) <= 0;
+			}
+			if (flips)
+				continue;
+			collapseTo[c.From] = c.To;
+			quadrics[group[c.To]].Add(quadrics[c.From]);
+			geometricMax = glm::max(geometricMax, c.Geometric);
+			for (auto t = triangleStart[c.From]; t < triangleStart[c.From + 1]; t++)
+			{
+				auto tri = &current[triangleList[t] * 3];
+				touched[tri[0]] = touched[tri[1]] = touched[tri[2]] = true;
+			}
+			touched[c.To] = true;
+			collapsed++;
+		}
+		if (collapsed == 0)
+			break;
+
+		size_t write = 0;
+		for (size_t t = 0; t < current.size(); t += 3)
+		{
+			GLuint tri[3] = { collapseTo[current[t]], collapseTo[current[t + 1]], collapseTo[current[t + 2]] };
+			if (group[tri[0]] == group[tri[1]] || group[tri[1]] == group[tri[2]] || group[tri[0]] == group[tri[2]])
+				continue;
+			current[write++] = tri[0];
+			current[write++] = tri[1];
+			current[write++] = tri[2];
+		}
+		current.resize(write);
+	}
+	if (resultError)
+		*resultError = (float)(sqrt(geometricMax) * scale);
+	return current;
+}
+
+void MeshSimplifier::BuildLods(BuiltMesh* mesh, const MeshAttributeLocations& locations, const LodSettings& settings)
+{
+	if (mesh == NULL || settings.MaxLevels <= 1 || mesh->Indices.empty())
+		return;
+	//always rebuild from the full mesh
+	if (!mesh->Lods.empty())
+		mesh->Indices.resize(mesh->Lods[0].IndexCount);
+	mesh->Lods.clear();
+
+	std::vector<float> positions;
+	if (!MeshBuilder::DecodeAttribute(*mesh, locations.Position, 3, positions))
+		return;
+	for (size_t i = 0; i < positions.size(); i += 3)
+	{
+		for (int k = 0; k < 3; k++)
+			positions[i + k] = positions[i + k] * mesh->PositionScale[k] + mesh->PositionBias[k];
+	}
+	//normals and uvs side by side, one row per vertex
+	std::vector<float> normals, texCoords, attributes, weights;
+	bool hasNormals = MeshBuilder::DecodeAttribute(*mesh, locations.Normal, 3, normals);
+	bool hasTexCoords = MeshBuilder::DecodeAttribute(*mesh, locations.TexCoord, 2, texCoords);
+	size_t attributeCount = (hasNormals ? 3 : 0) + (hasTexCoords ? 2 : 0);
+	weights.insert(weights.end(), hasNormals ? 3 : 0, settings.NormalWeight);
+	weights.insert(weights.end(), hasTexCoords ? 2 : 0, settings.TexCoordWeight);
+	for (GLsizei i = 0; i < mesh->VertexCount && attributeCount > 0; i++)
+	{
+		if (hasNormals)
+			attributes.insert(attributes.end(), normals.begin() + i * 3, normals.begin() + i * 3 + 3);
+		if (hasTexCoords)
+			attributes.insert(attributes.end(), texCoords.begin() + i * 2, texCoords.begin() + i * 2 + 2);
+	}
+
+	std::vector<GLuint> full = mesh->Indices;
+	MeshLod lod0;
+	lod0.IndexCount = (GLuint)full.size();
+	mesh->Lods.push_back(lod0);
+	size_t target = full.size();
+	for (int level = 1; level < settings.MaxLevels; level++)
+	{
+		target = (size_t)(target * settings.Ratio) / 3 * 3;
+		if (target < settings.MinIndexCount)
+			break;
+		//every level starts from the full mesh so its error is measured against that, not the level before
+		float error = 0;
+		auto indices = Simplify(positions.data(), attributeCount ? attributes.data() : NULL, weights.data(), attributeCount,
+			mesh->VertexCount, full.data(), full.size(), target, FLT_MAX, settings.LockBorder, &error);
+		auto& previous = mesh->Lods.back();
+		//stalled on locked seams/borders, a level that barely shrinks is not worth keeping
+		if (indices.empty() || indices.size() > previous.IndexCount * 9 / 10)
+			break;
+		MeshLod lod;
+		lod.FirstIndex = (GLuint)mesh->Indices.size();
+		lod.IndexCount = (GLuint)indices.size();
+		lod.Error = glm::max(error, previous.Error);
+		mesh->Indices.insert(mesh->Indices.end(), indices.begin(), indices.end());
+		mesh->Lods.push_back(lod);
+		target = indices.size();
+	}
+}
+
+float LodProjectionScale(const glm::mat4& projection, float viewportHeight)
+{
+	//projection[1][1] is cot(fovy / 2), ndc spans 2 units over the viewport height
+	return projection[1][1] * viewportHeight * 0.5f;
+}
+
+size_t SelectLod(const std::vector<MeshLod>& lods, float distance, float projectionScale, float pixelThreshold)
+{
+	size_t selected = 0;
+	distance = glm::max(distance, 1e-4f);
+	for (size_t i = 1; i < lods.size(); i++)
+	{
+		if (lods[i].Error * projectionScale / distance > pixelThreshold)
+			break;
+		selected = i;
+	}
+	return selected;
+}
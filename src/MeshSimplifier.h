@@ -0,0 +1,40 @@
+#pragma once
+#include "../include/glad/glad.h"
+#include "../include/glm/glm.hpp"
+#include "MeshBuilder.h"
+#include <vector>
+
+struct LodSettings
+{
+	///levels including the full mesh, 1 turns generation off
+	int MaxLevels = 1;
+	///index count of each level relative to the one before
+	float Ratio = 0.5f;
+	///levels below this many indices are not worth a draw of their own
+	size_t MinIndexCount = 192;
+	///how much a normal/uv change costs next to a position change, in mesh size units
+	float NormalWeight = 0.5f;
+	float TexCoordWeight = 1.0f;
+	///keep open edges where they are, otherwise holes and mesh boundaries shrink
+	bool LockBorder = true;
+};
+
+///edge collapse simplifier driven by quadric error (Garland/Heckbert), collapses only ever move a vertex
+///onto a neighbour so every level indexes the original vertex buffer
+class MeshSimplifier
+{
+public:
+	///positions are xyz per vertex; attributes (may be NULL) are attributeCount floats per vertex scaled by
+	///attributeWeights. stops at targetIndexCount or once the next collapse would cost more than maxError
+	///(object units). vertices that share a position with another vertex (uv/normal seams) never move.
+	///resultError gets the geometric error of the result, object units
+	static std::vector<GLuint> Simplify(const float* positions, const float* attributes, const float* attributeWeights, size_t attributeCount,
+		size_t vertexCount, const GLuint* indices, size_t indexCount, size_t targetIndexCount, float maxError, bool lockBorder, float* resultError);
+	///simplifies LOD 0 into coarser levels, appends their indices to mesh->Indices and fills mesh->Lods
+	static void BuildLods(BuiltMesh* mesh, const MeshAttributeLocations& locations, const LodSettings& settings);
+};
+
+///pixels one world unit covers at distance 1, for SelectLod
+float LodProjectionScale(const glm::mat4& projection, float viewportHeight);
+///coarsest level whose error seen from distance stays under pixelThreshold pixels
+size_t SelectLod(const std::vector<MeshLod>& lods, float distance, float projectionScale, float pixelThreshold);
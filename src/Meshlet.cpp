@@ -0,0 +1,294 @@
+#include "Meshlet.h"
+#include <cfloat>
+#include <cmath>
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#define MESHLET_SSE 1
+#include <emmintrin.h>
+#endif
+
+std::vector<GLuint> MeshletMesh::ExpandIndices() const
+{
+	std::vector<GLuint> indices;
+	indices.reserve(this->Triangles.size());
+	for (auto& m : this->Meshlets)
+	{
+		for (uint32_t t = 0; t < m.TriangleCount * 3; t++)
+			indices.push_back(this->Vertices[m.VertexOffset + this->Triangles[(m.TriangleOffset * 3) + t]]);
+	}
+	return indices;
+}
+
+static glm::vec3 LoadPosition(const float* positions, GLuint v)
+{
+	return glm::vec3(positions[v * 3], positions[v * 3 + 1], positions[v * 3 + 2]);
+}
+
+static void ComputeBounds(Meshlet& m, const MeshletMesh& mesh, const float* positions)
+{
+	//sphere around the box center, a little loose but cheap and stable
+	glm::vec3 lo(FLT_MAX), hi(-FLT_MAX);
+	for (uint32_t i = 0; i < m.VertexCount; i++)
+	{
+		auto p = LoadPosition(positions, mesh.Vertices[m.VertexOffset + i]);
+		lo = glm::min(lo, p);
+		hi = glm::max(hi, p);
+	}
+	m.Center = (lo + hi) * 0.5f;
+	m.Radius = 0;
+	for (uint32_t i = 0; i < m.VertexCount; i++)
+		m.Radius = glm::max(m.Radius, glm::length(LoadPosition(positions, mesh.Vertices[m.VertexOffset + i]) - m.Center));
+
+	std::vector<glm::vec3> normals;
+	glm::vec3 sum(0.0f);
+	for (uint32_t t = 0; t < m.TriangleCount; t++)
+	{
+		auto tri = &mesh.Triangles[(m.TriangleOffset + t) * 3];
+		auto a = LoadPosition(positions, mesh.Vertices[m.VertexOffset + tri[0]]);
+		auto b = LoadPosition(positions, mesh.Vertices[m.VertexOffset + tri[1]]);
+		auto c = LoadPosition(positions, mesh.Vertices[m.VertexOffset + tri[2]]);
+		auto n = glm::cross(b - a, c - a);
+		auto length = glm::length(n);
+		if (length <= 0)
+			continue;
+		normals.push_back(n / length);
+		sum += n / length;
+	}
+	m.ConeAxis = glm::vec3(0, 0, 1);
+	m.ConeCutoff = 1.0f;
+	auto sumLength = glm::length(sum);
+	if (sumLength <= 0)
+		return;
+	m.ConeAxis = sum / sumLength;
+	float minDot = 1.0f;
+	for (auto& n : normals)
+		minDot = glm::min(minDot, glm::dot(n, m.ConeAxis));
+	//normals spread over more than a hemisphere, some triangle always faces the camera
+	if (minDot <= 0)
+		return;
+	m.ConeCutoff = sqrtf(1.0f - minDot * minDot);
+}
+
+MeshletMesh MeshletBuilder::Build(const GLuint* indices, size_t indexCount, const float* positions, size_t vertexCount, size_t maxVertices, size_t maxTriangles)
+{
+	MeshletMesh mesh;
+	size_t triangleCount = indexCount / 3;
+	if (triangleCount == 0 || maxVertices < 3 || maxVertices > 256 || maxTriangles == 0)
+		return mesh;
+
+	//vertex -> triangle adjacency and how many unused triangles each vertex still has
+	std::vector<uint32_t> start(vertexCount + 1, 0), live(vertexCount, 0);
+	for (size_t i = 0; i < triangleCount * 3; i++)
+		start[indices[i] + 1]++;
+	for (size_t v = 0; v < vertexCount; v++)
+	{
+		live[v] = start[v + 1];
+		start[v + 1] += start[v];
+	}
+	std::vector<uint32_t> adjacency(triangleCount * 3);
+	{
+		std::vector<uint32_t> fill(start.begin(), start.end() - 1);
+		for (size_t i = 0; i < triangleCount * 3; i++)
+			adjacency[fill[indices[i]]++] = (uint32_t)(i / 3);
+	}
+
+	std::vector<bool> used(triangleCount, false);
+	std::vector<int> local(vertexCount, -1);
+	size_t cursor = 0;
+	Meshlet current = {};
+	auto finish = [&]()
+	{
+		if (current.TriangleCount == 0)
+			return;
+		ComputeBounds(current, mesh, positions);
+		mesh.Meshlets.push_back(current);
+		for (uint32_t i = 0; i < current.VertexCount; i++)
+			local[mesh.Vertices[current.VertexOffset + i]] = -1;
+		current = Meshlet();
+		current.VertexOffset = (uint32_t)mesh.Vertices.size();
+		current.TriangleOffset = (uint32_t)(mesh.Triangles.size() / 3);
+	};
+	auto newVertices = [&](size_t t)
+	{
+		return (local[indices[t * 3]] < 0) + (local[indices[t * 3 + 1]] < 0) + (local[indices[t * 3 + 2]] < 0);
+	};
+
+	for (size_t emitted = 0; emitted < triangleCount; emitted++)
+	{
+		//best unused neighbour of the meshlet so far
+		size_t best = SIZE_MAX;
+		int bestNew = 4;
+		uint32_t bestLive = UINT32_MAX;
+		for (uint32_t i = 0; i < current.VertexCount && bestNew > 0; i++)
+		{
+			auto v = mesh.Vertices[current.VertexOffset + i];
+			for (auto a = start[v]; a < start[v + 1]; a++)
+			{
+				auto t = adjacency[a];
+				if (used[t])
+					continue;
+				int added = newVertices(t);
+				uint32_t remaining = live[indices[t * 3]] + live[indices[t * 3 + 1]] + live[indices[t * 3 + 2]];
+				if (added < bestNew || (added == bestNew && remaining < bestLive))
+				{
+					best = t;
+					bestNew = added;
+					bestLive = remaining;
+				}
+			}
+		}
+		if (best == SIZE_MAX)
+		{
+			while (used[cursor])
+				cursor++;
+			best = cursor;
+			bestNew = newVertices(best);
+		}
+		if (current.VertexCount + bestNew > maxVertices || current.TriangleCount + 1 > maxTriangles)
+		{
+			finish();
+			//a fresh meshlet grows best from the oldest unused triangle
+			while (used[cursor])
+				cursor++;
+			best = cursor;
+		}
+
+		used[best] = true;
+		for (int k = 0; k < 3; k++)
+		{
+			auto v = indices[best * 3 + k];
+			live[v]--;
+			if (local[v] < 0)
+			{
+				local[v] = (int)current.VertexCount++;
+				mesh.Vertices.push_back(v);
+			}
+			mesh.Triangles.push_back((uint8_t)local[v]);
+		}
+		current.TriangleCount++;
+	}
+	finish();
+	return mesh;
+}
+
+void ClusterCuller::SetMeshlets(const MeshletMesh& mesh)
+{
+	this->count = mesh.Meshlets.size();
+	size_t padded = (this->count + 3) & ~(size_t)3;
+	std::vector<float>* streams[] = { &this->centerX, &this->centerY, &this->centerZ, &this->radius, &this->axisX, &this->axisY, &this->axisZ, &this->cutoff };
+	for (auto s : streams)
+		s->assign(padded, 0.0f);
+	for (size_t i = 0; i < this->count; i++)
+	{
+		auto& m = mesh.Meshlets[i];
+		this->centerX[i] = m.Center.x;
+		this->centerY[i] = m.Center.y;
+		this->centerZ[i] = m.Center.z;
+		this->radius[i] = m.Radius;
+		this->axisX[i] = m.ConeAxis.x;
+		this->axisY[i] = m.ConeAxis.y;
+		this->axisZ[i] = m.ConeAxis.z;
+		this->cutoff[i] = m.ConeCutoff;
+	}
+}
+
+size_t ClusterCuller::Cull(const glm::mat4& modelViewProjection, const glm::vec3& cameraPosition, std::vector<uint32_t>& visible) const
+{
+	visible.clear();
+	//frustum planes straight out of the matrix (Gribb/Hartmann), normalized so radius compares in object units
+	glm::vec4 planes[6];
+	glm::vec4 row[4];
+	for (int r = 0; r < 4; r++)
+		row[r] = glm::vec4(modelViewProjection[0][r], modelViewProjection[1][r], modelViewProjection[2][r], modelViewProjection[3][r]);
+	planes[0] = row[3] + row[0];
+	planes[1] = row[3] - row[0];
+	planes[2] = row[3] + row[1];
+	planes[3] = row[3] - row[1];
+	planes[4] = row[3] + row[2];
+	planes[5] = row[3] - row[2];
+	for (auto& p : planes)
+	{
+		auto length = glm::length(glm::vec3(p));
+		if (length > 0)
+			p /= length;
+	}
+
+#ifdef MESHLET_SSE
+	__m128 camX = _mm_set1_ps(cameraPosition.x), camY = _mm_set1_ps(cameraPosition.y), camZ = _mm_set1_ps(cameraPosition.z);
+	for (size_t i = 0; i < this->count; i += 4)
+	{
+		__m128 cx = _mm_loadu_ps(&this->centerX[i]);
+		__m128 cy = _mm_loadu_ps(&this->centerY[i]);
+		__m128 cz = _mm_loadu_ps(&this->centerZ[i]);
+		__m128 r = _mm_loadu_ps(&this->radius[i]);
+		__m128 negR = _mm_sub_ps(_mm_setzero_ps(), r);
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (auto& p : planes)
+		{
+			__m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(cx, _mm_set1_ps(p.x)), _mm_mul_ps(cy, _mm_set1_ps(p.y))),
+				_mm_add_ps(_mm_mul_ps(cz, _mm_set1_ps(p.z)), _mm_set1_ps(p.w)));
+			inside = _mm_and_ps(inside, _mm_cmpgt_ps(d, negR));
+		}
+		//backfacing when dot(center - camera, axis) >= cutoff * |center - camera| + radius
+		__m128 vx = _mm_sub_ps(cx, camX), vy = _mm_sub_ps(cy, camY), vz = _mm_sub_ps(cz, camZ);
+		__m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy)), _mm_mul_ps(vz, vz)));
+		__m128 along = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, _mm_loadu_ps(&this->axisX[i])), _mm_mul_ps(vy, _mm_loadu_ps(&this->axisY[i]))),
+			_mm_mul_ps(vz, _mm_loadu_ps(&this->axisZ[i])));
+		__m128 limit = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&this->cutoff[i]), length), r);
+		inside = _mm_andnot_ps(_mm_cmpge_ps(along, limit), inside);
+		int mask = _mm_movemask_ps(inside);
+		if (this->count - i < 4)
+			mask &= (1 << (this->count - i)) - 1;
+		for (; mask; mask &= mask - 1)
+		{
+			unsigned long lane = 0;
+			while (!(mask & (1 << lane)))
+				lane++;
+			visible.push_back((uint32_t)(i + lane));
+		}
+	}
+#else
+	for (size_t i = 0; i < this->count; i++)
+	{
+		glm::vec3 c(this->centerX[i], this->centerY[i], this->centerZ[i]);
+		bool inside = true;
+		for (auto& p : planes)
+			inside = inside && glm::dot(glm::vec3(p), c) + p.w > -this->radius[i];
+		auto v = c - cameraPosition;
+		glm::vec3 axis(this->axisX[i], this->axisY[i], this->axisZ[i]);
+		if (inside && glm::dot(v, axis) < this->cutoff[i] * glm::length(v) + this->radius[i])
+			visible.push_back((uint32_t)i);
+	}
+#endif
+	return visible.size();
+}
+
+void ClusterCuller::EmitCommands(const MeshletMesh& mesh, const MeshHandle& handle, const std::vector<uint32_t>& visible, GLuint drawId, std::vector<DrawElementsIndirectCommand>& commands)
+{
+	for (size_t i = 0; i < visible.size();)
+	{
+		auto& first = mesh.Meshlets[visible[i]];
+		GLuint count = first.TriangleCount * 3;
+		size_t j = i + 1;
+		//neighbours in the index buffer merge into one draw
+		for (; j < visible.size() && visible[j] == visible[j - 1] + 1; j++)
+			count += mesh.Meshlets[visible[j]].TriangleCount * 3;
+		DrawElementsIndirectCommand command;
+		command.Count = count;
+		command.InstanceCount = 1;
+		command.FirstIndex = handle.FirstIndex + first.TriangleOffset * 3;
+		command.BaseVertex = handle.BaseVertex;
+		command.BaseInstance = drawId;
+		commands.push_back(command);
+		i = j;
+	}
+}
+
+void ClusterCuller::EmitIndices(const MeshletMesh& mesh, const std::vector<uint32_t>& visible, std::vector<GLuint>& indices)
+{
+	for (auto v : visible)
+	{
+		auto& m = mesh.Meshlets[v];
+		for (uint32_t t = 0; t < m.TriangleCount * 3; t++)
+			indices.push_back(mesh.Vertices[m.VertexOffset + mesh.Triangles[m.TriangleOffset * 3 + t]]);
+	}
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include "../include/glad/glad.h"
+#include "../include/glm/glm.hpp"
+#include "IndirectDraw.h"
+#include "MeshBuffer.h"
+#include <cstdint>
+#include <vector>
+
+static const size_t MeshletMaxVertices = 64;
+static const size_t MeshletMaxTriangles = 124;
+
+///a small cluster of triangles with everything needed to cull it as a unit, object space
+struct Meshlet
+{
+	///into MeshletMesh::Vertices
+	uint32_t VertexOffset;
+	uint32_t VertexCount;
+	///into MeshletMesh::Triangles (3 bytes each) and, times 3, into the expanded index list
+	uint32_t TriangleOffset;
+	uint32_t TriangleCount;
+	glm::vec3 Center;
+	float Radius;
+	///all triangle normals lie within the cone around ConeAxis, ConeCutoff is sin of its half angle,
+	///1 when the cluster faces too many ways to ever be backfacing as a whole
+	glm::vec3 ConeAxis;
+	float ConeCutoff;
+};
+
+struct MeshletMesh
+{
+	std::vector<Meshlet> Meshlets;
+	///meshlet local vertex -> mesh vertex
+	std::vector<GLuint> Vertices;
+	///3 meshlet local vertices per triangle
+	std::vector<uint8_t> Triangles;
+	///the mesh's triangles in meshlet order as plain 32 bit indices, upload these instead of the
+	///original index list so every meshlet is one contiguous index range
+	std::vector<GLuint> ExpandIndices() const;
+};
+
+class MeshletBuilder
+{
+public:
+	///greedy clustering that grows each meshlet through shared vertices, preferring triangles that
+	///add no new vertex and those whose vertices have few other triangles left
+	static MeshletMesh Build(const GLuint* indices, size_t indexCount, const float* positions, size_t vertexCount,
+		size_t maxVertices = MeshletMaxVertices, size_t maxTriangles = MeshletMaxTriangles);
+};
+
+///per frame CPU culling of one mesh's meshlets against the frustum and their normal cones,
+///4 meshlets at a time with SSE where available
+class ClusterCuller
+{
+public:
+	///copies the bounds into SoA arrays, call again when the mesh changes
+	void SetMeshlets(const MeshletMesh& mesh);
+	///modelViewProjection takes object space to clip space, cameraPosition is in object space.
+	///visible gets the indices of the meshlets that survive, returns how many
+	size_t Cull(const glm::mat4& modelViewProjection, const glm::vec3& cameraPosition, std::vector<uint32_t>& visible) const;
+	///one command per run of consecutive visible meshlets, against a mesh uploaded with ExpandIndices
+	static void EmitCommands(const MeshletMesh& mesh, const MeshHandle& handle, const std::vector<uint32_t>& visible, GLuint drawId, std::vector<DrawElementsIndirectCommand>& commands);
+	///the visible triangles as mesh vertex indices, for a per frame index stream
+	static void EmitIndices(const MeshletMesh& mesh, const std::vector<uint32_t>& visible, std::vector<GLuint>& indices);
+private:
+	size_t count = 0;
+	///padded to a multiple of 4, lanes past count are masked off
+	std::vector<float> centerX, centerY, centerZ, radius;
+	std::vector<float> axisX, axisY, axisZ, cutoff;
+};
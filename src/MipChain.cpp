@@ -0,0 +1,335 @@
+#include "MipChain.h"
+#include "JobSystem.h"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#define MIP_SSE 1
+#include <emmintrin.h>
+#endif
+
+static const float Pi = 3.14159265358979f;
+static const int LinearToSRGBSize = 16384;
+
+static const float* SRGBToLinearTable()
+{
+	static std::vector<float> table = []()
+	{
+		std::vector<float> t(256);
+		for (int i = 0; i < 256; i++)
+		{
+			float c = i / 255.0f;
+			t[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+		}
+		return t;
+	}();
+	return table.data();
+}
+
+static const unsigned char* LinearToSRGBTable()
+{
+	static std::vector<unsigned char> table = []()
+	{
+		std::vector<unsigned char> t(LinearToSRGBSize + 1);
+		for (int i = 0; i <= LinearToSRGBSize; i++)
+		{
+			float l = (float)i / LinearToSRGBSize;
+			float c = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.0f / 2.4f) - 0.055f;
+			t[i] = (unsigned char)std::min(std::max(c * 255.0f + 0.5f, 0.0f), 255.0f);
+		}
+		return t;
+	}();
+	return table.data();
+}
+
+static float Sinc(float x)
+{
+	if (std::fabs(x) < 1e-5f)
+		return 1.0f;
+	return std::sin(Pi * x) / (Pi * x);
+}
+
+///modified Bessel function of the first kind, order 0, by its power series
+static float BesselI0(float x)
+{
+	float sum = 1.0f, term = 1.0f, half = x * 0.5f;
+	for (int k = 1; k < 32; k++)
+	{
+		term *= (half / k) * (half / k);
+		sum += term;
+		if (term < sum * 1e-8f)
+			break;
+	}
+	return sum;
+}
+
+///radius in destination texels
+static float FilterSupport(MipFilter filter)
+{
+	return filter == MipBox ? 0.5f : 3.0f;
+}
+
+static float FilterWeight(MipFilter filter, float x)
+{
+	x = std::fabs(x);
+	switch (filter)
+	{
+	case MipBox:
+		return x < 0.5f ? 1.0f : x == 0.5f ? 0.5f : 0.0f;
+	case MipKaiser:
+	{
+		const float radius = 3.0f, alpha = 4.0f;
+		if (x >= radius)
+			return 0.0f;
+		float t = x / radius;
+		return Sinc(x) * BesselI0(alpha * std::sqrt(1.0f - t * t)) / BesselI0(alpha);
+	}
+	case MipLanczos:
+		return x < 3.0f ? Sinc(x) * Sinc(x / 3.0f) : 0.0f;
+	}
+	return 0.0f;
+}
+
+///a fixed number of taps per destination texel, unused ones carry weight 0
+struct FilterTaps
+{
+	int Taps;
+	std::vector<int> Index;
+	std::vector<float> Weight;
+};
+
+static FilterTaps BuildTaps(int source, int destination, MipFilter filter, bool wrap)
+{
+	FilterTaps taps;
+	float scale = (float)source / destination;
+	float radius = FilterSupport(filter) * scale;
+	taps.Taps = (int)std::ceil(radius * 2.0f) + 1;
+	taps.Index.resize((size_t)destination * taps.Taps);
+	taps.Weight.resize((size_t)destination * taps.Taps);
+	for (int x = 0; x < destination; x++)
+	{
+		float center = (x + 0.5f) * scale;
+		int first = (int)std::floor(center - radius);
+		float sum = 0.0f;
+		auto index = &taps.Index[(size_t)x * taps.Taps];
+		auto weight = &taps.Weight[(size_t)x * taps.Taps];
+		for (int t = 0; t < taps.Taps; t++)
+		{
+			int i = first + t;
+			weight[t] = FilterWeight(filter, (i + 0.5f - center) / scale);
+			index[t] = wrap ? ((i % source) + source) % source : std::min(std::max(i, 0), source - 1);
+			sum += weight[t];
+		}
+		for (int t = 0; t < taps.Taps; t++)
+			weight[t] = sum != 0.0f ? weight[t] / sum : (t == 0 ? 1.0f : 0.0f);
+	}
+	return taps;
+}
+
+static void RunRows(JobSystem* jobs, int rows, int rowCost, const std::function<void(size_t, size_t)>& body)
+{
+	if (jobs == NULL)
+	{
+		body(0, rows);
+		return;
+	}
+	JobCounter done;
+	jobs->ParallelFor(0, rows, std::max(1, 65536 / std::max(rowCost, 1)), body, &done);
+	jobs->Wait(&done);
+}
+
+///rgba float rows, level 0 and all sizes below it
+struct FloatImage
+{
+	int Width;
+	int Height;
+	std::vector<float> Texels;
+};
+
+static void FilterRows(const FloatImage& source, FloatImage& target, const FilterTaps& taps, size_t first, size_t last)
+{
+	for (size_t y = first; y < last; y++)
+	{
+		auto in = &source.Texels[y * source.Width * 4];
+		auto out = &target.Texels[y * target.Width * 4];
+		for (int x = 0; x < target.Width; x++)
+		{
+			auto index = &taps.Index[(size_t)x * taps.Taps];
+			auto weight = &taps.Weight[(size_t)x * taps.Taps];
+#ifdef MIP_SSE
+			auto sum = _mm_setzero_ps();
+			for (int t = 0; t < taps.Taps; t++)
+				sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(in + index[t] * 4), _mm_set1_ps(weight[t])));
+			_mm_storeu_ps(out + x * 4, sum);
+#else
+			float sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+			for (int t = 0; t < taps.Taps; t++)
+			{
+				for (int c = 0; c < 4; c++)
+					sum[c] += in[index[t] * 4 + c] * weight[t];
+			}
+			for (int c = 0; c < 4; c++)
+				out[x * 4 + c] = sum[c];
+#endif
+		}
+	}
+}
+
+///weighted sum of whole rows, so it vectorizes along the row; clamps since the sinc lobes overshoot
+static void FilterColumns(const FloatImage& source, FloatImage& target, const FilterTaps& taps, size_t first, size_t last)
+{
+	size_t floats = (size_t)target.Width * 4;
+	for (size_t y = first; y < last; y++)
+	{
+		auto index = &taps.Index[y * taps.Taps];
+		auto weight = &taps.Weight[y * taps.Taps];
+		auto out = &target.Texels[y * floats];
+		std::fill(out, out + floats, 0.0f);
+		for (int t = 0; t < taps.Taps; t++)
+		{
+			if (weight[t] == 0.0f)
+				continue;
+			auto in = &source.Texels[(size_t)index[t] * floats];
+#ifdef MIP_SSE
+			auto w = _mm_set1_ps(weight[t]);
+			for (size_t i = 0; i < floats; i += 4)
+				_mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(out + i), _mm_mul_ps(_mm_loadu_ps(in + i), w)));
+#else
+			for (size_t i = 0; i < floats; i++)
+				out[i] += in[i] * weight[t];
+#endif
+		}
+#ifdef MIP_SSE
+		auto zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+		for (size_t i = 0; i < floats; i += 4)
+			_mm_storeu_ps(out + i, _mm_min_ps(_mm_max_ps(_mm_loadu_ps(out + i), zero), one));
+#else
+		for (size_t i = 0; i < floats; i++)
+			out[i] = std::min(std::max(out[i], 0.0f), 1.0f);
+#endif
+	}
+}
+
+static float AlphaCoverage(const FloatImage& image, float cutoff, float scale)
+{
+	size_t count = (size_t)image.Width * image.Height, covered = 0;
+	for (size_t i = 0; i < count; i++)
+	{
+		if (image.Texels[i * 4 + 3] * scale > cutoff)
+			covered++;
+	}
+	return (float)covered / count;
+}
+
+///alpha scale that brings the level's coverage closest to target
+static float CoverageScale(const FloatImage& image, float cutoff, float target)
+{
+	float lo = 0.0f, hi = 4.0f, best = 1.0f, bestError = 2.0f;
+	for (int step = 0; step < 12; step++)
+	{
+		float scale = (lo + hi) * 0.5f;
+		float coverage = AlphaCoverage(image, cutoff, scale);
+		if (std::fabs(coverage - target) < bestError)
+		{
+			bestError = std::fabs(coverage - target);
+			best = scale;
+		}
+		if (coverage < target)
+			lo = scale;
+		else
+			hi = scale;
+	}
+	return best;
+}
+
+MipChain MipGenerator::Generate(const unsigned char* pixels, int width, int height, int channels, const MipSettings& settings, JobSystem* jobs)
+{
+	MipChain chain;
+	chain.Channels = channels;
+	//the sRGB colour formats are the 3-4 channel ones, SelectTextureFormat keeps 1-2 channels linear
+	int srgbChannels = settings.Usage == TextureColor && channels >= 3 ? 3 : 0;
+	bool coverage = settings.AlphaCoverageCutoff > 0.0f && channels == 4;
+	auto toLinear = SRGBToLinearTable();
+	auto toSRGB = LinearToSRGBTable();
+
+	FloatImage current;
+	current.Width = width;
+	current.Height = height;
+	current.Texels.assign((size_t)width * height * 4, 0.0f);
+	RunRows(jobs, height, width, [&](size_t first, size_t last)
+	{
+		for (size_t y = first; y < last; y++)
+		{
+			for (size_t x = 0; x < (size_t)width; x++)
+			{
+				auto in = pixels + (y * width + x) * channels;
+				auto out = &current.Texels[(y * width + x) * 4];
+				for (int c = 0; c < channels; c++)
+					out[c] = c < srgbChannels ? toLinear[in[c]] : in[c] / 255.0f;
+			}
+		}
+	});
+	float targetCoverage = coverage ? AlphaCoverage(current, settings.AlphaCoverageCutoff, 1.0f) : 0.0f;
+
+	while (current.Width > 1 || current.Height > 1)
+	{
+		FloatImage rows, next;
+		next.Width = std::max(current.Width / 2, 1);
+		next.Height = std::max(current.Height / 2, 1);
+		rows.Width = next.Width;
+		rows.Height = current.Height;
+		rows.Texels.resize((size_t)rows.Width * rows.Height * 4);
+		next.Texels.resize((size_t)next.Width * next.Height * 4);
+		auto horizontal = BuildTaps(current.Width, next.Width, settings.Filter, settings.Wrap);
+		auto vertical = BuildTaps(current.Height, next.Height, settings.Filter, settings.Wrap);
+		RunRows(jobs, rows.Height, rows.Width * horizontal.Taps, [&](size_t first, size_t last) { FilterRows(current, rows, horizontal, first, last); });
+		RunRows(jobs, next.Height, next.Width * vertical.Taps, [&](size_t first, size_t last) { FilterColumns(rows, next, vertical, first, last); });
+
+		//only the stored level gets the scaled alpha, the next one still filters the real one
+		float alphaScale = coverage ? CoverageScale(next, settings.AlphaCoverageCutoff, targetCoverage) : 1.0f;
+		MipLevel level;
+		level.Width = next.Width;
+		level.Height = next.Height;
+		level.Pixels.resize((size_t)next.Width * next.Height * channels);
+		RunRows(jobs, next.Height, next.Width, [&](size_t first, size_t last)
+		{
+			for (size_t i = first * next.Width; i < last * next.Width; i++)
+			{
+				auto in = &next.Texels[i * 4];
+				auto out = &level.Pixels[i * channels];
+				for (int c = 0; c < channels; c++)
+				{
+					float v = c == 3 ? std::min(in[c] * alphaScale, 1.0f) : in[c];
+					out[c] = c < srgbChannels ? toSRGB[(int)(v * LinearToSRGBSize + 0.5f)] : (unsigned char)(v * 255.0f + 0.5f);
+				}
+			}
+		});
+		chain.Levels.push_back(std::move(level));
+		current = std::move(next);
+	}
+	return chain;
+}
+
+GLuint UploadMipChain(const unsigned char* pixels, int width, int height, const MipChain& chain, TextureUsage usage)
+{
+	auto format = SelectTextureFormat(chain.Channels, usage);
+	GLuint texture = 0;
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	AllocateTexture2D(format, width, height, (GLsizei)chain.Levels.size() + 1);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, RowUnpackAlignment(width, chain.Channels));
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, format.Format, format.Type, pixels);
+	for (size_t i = 0; i < chain.Levels.size(); i++)
+	{
+		auto& level = chain.Levels[i];
+		glPixelStorei(GL_UNPACK_ALIGNMENT, RowUnpackAlignment(level.Width, chain.Channels));
+		glTexSubImage2D(GL_TEXTURE_2D, (GLint)i + 1, 0, 0, level.Width, level.Height, format.Format, format.Type, level.Pixels.data());
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)chain.Levels.size());
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	return texture;
+}
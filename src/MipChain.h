@@ -0,0 +1,54 @@
+#pragma once
+#include "../include/glad/glad.h"
+#include "TextureFormat.h"
+#include <vector>
+
+class JobSystem;
+
+enum MipFilter
+{
+	///2x2 average, what glGenerateMipmap usually does
+	MipBox,
+	///Kaiser windowed sinc, sharp without much ringing
+	MipKaiser,
+	///Lanczos 3, sharper, rings more on hard edges
+	MipLanczos,
+};
+
+struct MipSettings
+{
+	MipFilter Filter = MipKaiser;
+	///colour maps with 3-4 channels are filtered in linear space and encoded back to sRGB
+	TextureUsage Usage = TextureColor;
+	///sample across the edges as GL_REPEAT would, off for atlas pages and clamped textures
+	bool Wrap = true;
+	///above 0, alpha of every level is scaled so the share of texels past this cutoff matches level 0,
+	///which keeps alpha tested foliage/fences from thinning out in the distance
+	float AlphaCoverageCutoff = 0.0f;
+};
+
+struct MipLevel
+{
+	int Width = 0;
+	int Height = 0;
+	///tightly packed, same channel count as the source
+	std::vector<unsigned char> Pixels;
+};
+
+///level 1 down to 1x1, level 0 is the source image itself
+struct MipChain
+{
+	int Channels = 0;
+	std::vector<MipLevel> Levels;
+};
+
+class MipGenerator
+{
+public:
+	///pixels are tightly packed 8 bit rows with 1-4 channels. jobs may be NULL to run on the calling thread,
+	///otherwise each level's rows are spread over the workers (safe to call from inside a job)
+	static MipChain Generate(const unsigned char* pixels, int width, int height, int channels, const MipSettings& settings, JobSystem* jobs);
+};
+
+///GL thread, a 2D texture with level 0 from pixels and the rest from chain in one go, no glGenerateMipmap
+GLuint UploadMipChain(const unsigned char* pixels, int width, int height, const MipChain& chain, TextureUsage usage);
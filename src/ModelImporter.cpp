@@ -0,0 +1,985 @@
+#include "ModelImporter.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+//big enough that a chunk is worth a job, small enough that the first meshes show up quickly
+static const size_t ObjChunkBytes = 1 << 20;
+
+static const double Pow10Table[23] =
+{
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+static bool IsDigit(char c)
+{
+	return c >= '0' && c <= '9';
+}
+
+static const char* ParseFloatSlow(const char* p, const char* end, float* out)
+{
+	//strtod needs a terminator the mapping does not have
+	char buffer[128];
+	size_t n = (size_t)(end - p) < sizeof(buffer) - 1 ? (size_t)(end - p) : sizeof(buffer) - 1;
+	memcpy(buffer, p, n);
+	buffer[n] = 0;
+	char* stop = buffer;
+	*out = (float)strtod(buffer, &stop);
+	return p + (stop - buffer);
+}
+
+const char* ParseFloatFast(const char* p, const char* end, float* out)
+{
+	auto start = p;
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+'))
+		negative = *p++ == '-';
+	uint64_t mantissa = 0;
+	int digits = 0, exponent = 0;
+	bool any = false;
+	//leading zeros carry no precision
+	while (p < end && *p == '0')
+	{
+		p++;
+		any = true;
+	}
+	for (; p < end && IsDigit(*p); p++, any = true)
+	{
+		if (digits < 19)
+			mantissa = mantissa * 10 + (*p - '0'), digits++;
+		else
+			exponent++;
+	}
+	if (p < end && *p == '.')
+	{
+		p++;
+		if (digits == 0)
+			for (; p < end && *p == '0'; p++, any = true)
+				exponent--;
+		for (; p < end && IsDigit(*p); p++, any = true)
+		{
+			if (digits < 19)
+				mantissa = mantissa * 10 + (*p - '0'), digits++, exponent--;
+		}
+	}
+	//nan, inf and garbage
+	if (!any)
+		return ParseFloatSlow(start, end, out);
+	if (p < end && (*p == 'e' || *p == 'E'))
+	{
+		auto e = p + 1;
+		bool negativeExp = false;
+		if (e < end && (*e == '-' || *e == '+'))
+			negativeExp = *e++ == '-';
+		if (e < end && IsDigit(*e))
+		{
+			int value = 0;
+			for (; e < end && IsDigit(*e); e++)
+				value = value < 10000 ? value * 10 + (*e - '0') : value;
+			exponent += negativeExp ? -value : value;
+			p = e;
+		}
+	}
+	//a 53 bit mantissa times an exact power of ten rounds once, the classic Clinger fast path
+	if (mantissa > (1ull << 53) || exponent < -22 || exponent > 22)
+		return ParseFloatSlow(start, end, out);
+	double value = (double)mantissa;
+	value = exponent < 0 ? value / Pow10Table[-exponent] : value * Pow10Table[exponent];
+	*out = (float)(negative ? -value : value);
+	return p;
+}
+
+static const char* SkipBlanks(const char* p, const char* end)
+{
+	while (p < end && (*p == ' ' || *p == '\t'))
+		p++;
+	return p;
+}
+
+static const char* ParseIntFast(const char* p, const char* end, int* out)
+{
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+'))
+		negative = *p++ == '-';
+	int value = 0;
+	for (; p < end && IsDigit(*p); p++)
+		value = value * 10 + (*p - '0');
+	*out = negative ? -value : value;
+	return p;
+}
+
+//----------------------------------------------------------------------------- OBJ
+
+enum ObjCornerFlags
+{
+	ObjRelativeV = 1,
+	ObjRelativeT = 2,
+	ObjRelativeN = 4,
+	ObjHasT = 8,
+	ObjHasN = 16,
+};
+
+///positive OBJ indices are stored 0-based global, negative ones 0-based relative to the chunk's
+///first vertex because the chunk does not know yet how many vertices came before it
+struct ObjCorner
+{
+	int V;
+	int T;
+	int N;
+	uint32_t Flags;
+};
+
+struct ObjEvent
+{
+	///applies before this face of the chunk
+	size_t Face;
+	bool Material;
+	std::string Name;
+};
+
+struct ModelImporter::ObjChunk
+{
+	const char* Begin;
+	const char* End;
+	std::vector<float> Positions;
+	std::vector<float> TexCoords;
+	std::vector<float> Normals;
+	std::vector<ObjCorner> Corners;
+	std::vector<uint32_t> FaceSizes;
+	std::vector<ObjEvent> Events;
+	///global index of the chunk's first v/vt/vn, set by the resolve pass
+	size_t FirstPosition = 0;
+	size_t FirstTexCoord = 0;
+	size_t FirstNormal = 0;
+};
+
+///triangle soup of one mesh, MeshBuilder welds it back into indexed vertices
+struct ModelImporter::ObjSoup
+{
+	std::string Name;
+	std::string Material;
+	std::vector<float> Positions;
+	std::vector<float> TexCoords;
+	std::vector<float> Normals;
+	bool HasTexCoords = false;
+	bool HasNormals = false;
+};
+
+ModelImporter::ModelImporter(JobSystem* jobs, const MeshCompression& compression, const MeshAttributeLocations& locations)
+	: jobs(jobs),
+	compression(compression),
+	locations(locations),
+	failed(false)
+{
+}
+
+ModelImporter::~ModelImporter()
+{
+	this->Wait();
+	for (auto c : this->chunks)
+		delete c;
+	for (auto r : this->ready)
+		delete r;
+	for (auto m : this->results)
+		delete m;
+	delete this->soup;
+}
+
+void ModelImporter::Wait()
+{
+	if (!this->started)
+		return;
+	this->jobs->Wait(&this->parsed);
+	this->jobs->Wait(&this->built);
+}
+
+static bool EndsWith(const std::string& s, const char* suffix)
+{
+	auto n = strlen(suffix);
+	if (s.size() < n)
+		return false;
+	for (size_t i = 0; i < n; i++)
+	{
+		if (tolower((unsigned char)s[s.size() - n + i]) != suffix[i])
+			return false;
+	}
+	return true;
+}
+
+bool ModelImporter::Start(const char* path)
+{
+	if (this->started && !this->IsDone())
+		return false;
+	this->Wait();
+	for (auto c : this->chunks)
+		delete c;
+	for (auto r : this->ready)
+		delete r;
+	this->chunks.clear();
+	this->ready.clear();
+	this->buffers.clear();
+	this->meshCount = 0;
+	this->failed = false;
+	std::string name = path;
+	if (!this->file.Open(path, MappedSequential))
+		return false;
+	this->started = true;
+	if (EndsWith(name, ".glb"))
+		this->StartGltf(name, true);
+	else if (EndsWith(name, ".gltf"))
+		this->StartGltf(name, false);
+	else
+		this->StartObj();
+	return true;
+}
+
+bool ModelImporter::Poll(ImportedMesh& mesh)
+{
+	ImportedMesh* result = NULL;
+	{
+		std::lock_guard<std::mutex> guard(this->resultLock);
+		if (this->results.empty())
+			return false;
+		result = this->results.front();
+		this->results.pop_front();
+	}
+	mesh = std::move(*result);
+	delete result;
+	return true;
+}
+
+void ModelImporter::Push(ImportedMesh* mesh)
+{
+	std::lock_guard<std::mutex> guard(this->resultLock);
+	this->results.push_back(mesh);
+}
+
+void ModelImporter::Build(const MeshSource& source, ImportedMesh* result)
+{
+	if (MeshBuilder::Build(source, this->compression, this->locations, &result->Mesh))
+	{
+		MeshSimplifier::BuildLods(&result->Mesh, this->locations, this->lodSettings);
+		std::vector<float> positions;
+		if (this->buildMeshlets && MeshBuilder::DecodeAttribute(result->Mesh, this->locations.Position, 3, positions))
+		{
+			auto& mesh = result->Mesh;
+			for (size_t i = 0; i < positions.size(); i += 3)
+			{
+				for (int k = 0; k < 3; k++)
+					positions[i + k] = positions[i + k] * mesh.PositionScale[k] + mesh.PositionBias[k];
+			}
+			//same triangles reordered, so the LOD 0 range and the levels after it stay where they are
+			size_t lod0 = mesh.Lods.empty() ? mesh.Indices.size() : mesh.Lods[0].IndexCount;
+			result->Meshlets = MeshletBuilder::Build(mesh.Indices.data(), lod0, positions.data(), mesh.VertexCount);
+			auto ordered = result->Meshlets.ExpandIndices();
+			std::copy(ordered.begin(), ordered.end(), mesh.Indices.begin());
+		}
+		this->Push(result);
+	}
+	else
+	{
+		this->failed = true;
+		delete result;
+	}
+}
+
+void ModelImporter::StartObj()
+{
+	auto data = (const char*)this->file.Data();
+	auto end = data + this->file.Size();
+	//cut at line ends so no line straddles two chunks
+	for (auto p = data; p < end;)
+	{
+		auto chunk = new ObjChunk();
+		chunk->Begin = p;
+		auto cut = (size_t)(end - p) > ObjChunkBytes ? p + ObjChunkBytes : end;
+		auto eol = cut < end ? (const char*)memchr(cut, '\n', end - cut) : NULL;
+		chunk->End = eol ? eol + 1 : end;
+		p = chunk->End;
+		this->chunks.push_back(chunk);
+	}
+	delete this->soup;
+	this->soup = new ObjSoup();
+	for (size_t i = 0; i <= this->chunks.size(); i++)
+		this->ready.push_back(new JobCounter());
+	//chunks parse in parallel, resolving is a chain since each needs the vertex counts before it
+	for (size_t i = 0; i < this->chunks.size(); i++)
+		this->jobs->Schedule([this, i]() { this->ParseObjChunk(i); }, this->ready[i]);
+	for (size_t i = 0; i < this->chunks.size(); i++)
+		this->jobs->Schedule([this, i]() { this->ResolveObjChunk(i); }, this->ready[i + 1], this->ready[i]);
+	this->jobs->Schedule([this]() { this->FlushObjSoup(); }, &this->parsed, this->ready.back());
+}
+
+static int StoreObjIndex(int index, size_t localCount, uint32_t relativeFlag, uint32_t& flags)
+{
+	if (index < 0)
+	{
+		flags |= relativeFlag;
+		return (int)localCount + index;
+	}
+	return index - 1;
+}
+
+void ModelImporter::ParseObjChunk(size_t index)
+{
+	auto chunk = this->chunks[index];
+	auto p = chunk->Begin;
+	auto end = chunk->End;
+	while (p < end)
+	{
+		auto eol = (const char*)memchr(p, '\n', end - p);
+		auto lineEnd = eol ? eol : end;
+		auto next = eol ? eol + 1 : end;
+		if (lineEnd > p && lineEnd[-1] == '\r')
+			lineEnd--;
+		p = SkipBlanks(p, lineEnd);
+		if (lineEnd - p < 2)
+		{
+			p = next;
+			continue;
+		}
+		if (p[0] == 'v' && (p[1] == ' ' || p[1] == '\t'))
+		{
+			float xyz[3] = {};
+			auto q = p + 2;
+			for (int i = 0; i < 3; i++)
+				q = ParseFloatFast(SkipBlanks(q, lineEnd), lineEnd, &xyz[i]);
+			chunk->Positions.insert(chunk->Positions.end(), xyz, xyz + 3);
+		}
+		else if (p[0] == 'v' && p[1] == 't')
+		{
+			float uv[2] = {};
+			auto q = p + 2;
+			for (int i = 0; i < 2; i++)
+				q = ParseFloatFast(SkipBlanks(q, lineEnd), lineEnd, &uv[i]);
+			chunk->TexCoords.insert(chunk->TexCoords.end(), uv, uv + 2);
+		}
+		else if (p[0] == 'v' && p[1] == 'n')
+		{
+			float n[3] = {};
+			auto q = p + 2;
+			for (int i = 0; i < 3; i++)
+				q = ParseFloatFast(SkipBlanks(q, lineEnd), lineEnd, &n[i]);
+			chunk->Normals.insert(chunk->Normals.end(), n, n + 3);
+		}
+		else if (p[0] == 'f' && (p[1] == ' ' || p[1] == '\t'))
+		{
+			uint32_t corners = 0;
+			auto q = SkipBlanks(p + 2, lineEnd);
+			while (q < lineEnd)
+			{
+				ObjCorner c = {};
+				int value = 0;
+				auto r = ParseIntFast(q, lineEnd, &value);
+				if (r == q || value == 0)
+					break;
+				c.V = StoreObjIndex(value, chunk->Positions.size() / 3, ObjRelativeV, c.Flags);
+				if (r < lineEnd && *r == '/')
+				{
+					r++;
+					if (r < lineEnd && *r != '/')
+					{
+						r = ParseIntFast(r, lineEnd, &value);
+						if (value != 0)
+						{
+							c.T = StoreObjIndex(value, chunk->TexCoords.size() / 2, ObjRelativeT, c.Flags);
+							c.Flags |= ObjHasT;
+						}
+					}
+					if (r < lineEnd && *r == '/')
+					{
+						r = ParseIntFast(r + 1, lineEnd, &value);
+						if (value != 0)
+						{
+							c.N = StoreObjIndex(value, chunk->Normals.size() / 3, ObjRelativeN, c.Flags);
+							c.Flags |= ObjHasN;
+						}
+					}
+				}
+				chunk->Corners.push_back(c);
+				corners++;
+				while (r < lineEnd && *r != ' ' && *r != '\t')
+					r++;
+				q = SkipBlanks(r, lineEnd);
+			}
+			if (corners >= 3)
+				chunk->FaceSizes.push_back(corners);
+			else
+				chunk->Corners.resize(chunk->Corners.size() - corners);
+		}
+		else if (!this->mergeObjects && ((p[0] == 'o' || p[0] == 'g') && (p[1] == ' ' || p[1] == '\t')))
+		{
+			auto name = SkipBlanks(p + 2, lineEnd);
+			ObjEvent e = { chunk->FaceSizes.size(), false, std::string(name, lineEnd) };
+			chunk->Events.push_back(e);
+		}
+		else if (!this->mergeObjects && lineEnd - p > 7 && strncmp(p, "usemtl", 6) == 0 && (p[6] == ' ' || p[6] == '\t'))
+		{
+			auto name = SkipBlanks(p + 7, lineEnd);
+			ObjEvent e = { chunk->FaceSizes.size(), true, std::string(name, lineEnd) };
+			chunk->Events.push_back(e);
+		}
+		p = next;
+	}
+}
+
+void ModelImporter::FlushObjSoup()
+{
+	auto finished = this->soup;
+	this->soup = new ObjSoup();
+	this->soup->Name = finished->Name;
+	this->soup->Material = finished->Material;
+	if (finished->Positions.empty())
+	{
+		delete finished;
+		return;
+	}
+	auto result = new ImportedMesh();
+	result->Name = finished->Name;
+	result->Material = finished->Material;
+	result->Index = this->meshCount++;
+	this->jobs->Schedule([this, finished, result]()
+	{
+		MeshSource source;
+		source.Positions = finished->Positions.data();
+		source.TexCoords = finished->HasTexCoords ? finished->TexCoords.data() : NULL;
+		source.Normals = finished->HasNormals ? finished->Normals.data() : NULL;
+		source.VertexCount = finished->Positions.size() / 3;
+		this->Build(source, result);
+		delete finished;
+	}, &this->built);
+}
+
+const float* ModelImporter::FindObjElement(size_t chunk, size_t global, int stream) const
+{
+	//walk back from the current chunk, faces mostly reference vertices close to them
+	for (size_t c = chunk + 1; c-- > 0;)
+	{
+		auto data = this->chunks[c];
+		size_t first = stream == 0 ? data->FirstPosition : stream == 1 ? data->FirstTexCoord : data->FirstNormal;
+		auto& values = stream == 0 ? data->Positions : stream == 1 ? data->TexCoords : data->Normals;
+		size_t width = stream == 1 ? 2 : 3;
+		if (global >= first)
+			return global - first < values.size() / width ? values.data() + (global - first) * width : NULL;
+	}
+	return NULL;
+}
+
+void ModelImporter::ResolveObjChunk(size_t index)
+{
+	auto chunk = this->chunks[index];
+	if (index > 0)
+	{
+		auto previous = this->chunks[index - 1];
+		chunk->FirstPosition = previous->FirstPosition + previous->Positions.size() / 3;
+		chunk->FirstTexCoord = previous->FirstTexCoord + previous->TexCoords.size() / 2;
+		chunk->FirstNormal = previous->FirstNormal + previous->Normals.size() / 3;
+	}
+	size_t corner = 0, event = 0;
+	for (size_t face = 0; face < chunk->FaceSizes.size(); face++)
+	{
+		for (; event < chunk->Events.size() && chunk->Events[event].Face == face; event++)
+		{
+			this->FlushObjSoup();
+			if (chunk->Events[event].Material)
+				this->soup->Material = chunk->Events[event].Name;
+			else
+				this->soup->Name = chunk->Events[event].Name;
+		}
+		auto size = chunk->FaceSizes[face];
+		auto corners = &chunk->Corners[corner];
+		corner += size;
+		//resolve all corners first so a bad index drops the whole face
+		const float* resolved[64][3];
+		if (size > 64)
+		{
+			this->failed = true;
+			continue;
+		}
+		bool valid = true;
+		for (uint32_t i = 0; i < size && valid; i++)
+		{
+			auto& c = corners[i];
+			size_t v = (size_t)(c.Flags & ObjRelativeV ? (int64_t)chunk->FirstPosition + c.V : c.V);
+			resolved[i][0] = this->FindObjElement(index, v, 0);
+			resolved[i][1] = NULL;
+			resolved[i][2] = NULL;
+			if (c.Flags & ObjHasT)
+			{
+				size_t t = (size_t)(c.Flags & ObjRelativeT ? (int64_t)chunk->FirstTexCoord + c.T : c.T);
+				resolved[i][1] = this->FindObjElement(index, t, 1);
+				valid = resolved[i][1] != NULL;
+			}
+			if (c.Flags & ObjHasN)
+			{
+				size_t n = (size_t)(c.Flags & ObjRelativeN ? (int64_t)chunk->FirstNormal + c.N : c.N);
+				resolved[i][2] = this->FindObjElement(index, n, 2);
+				valid = valid && resolved[i][2] != NULL;
+			}
+			valid = valid && resolved[i][0] != NULL;
+		}
+		if (!valid)
+		{
+			this->failed = true;
+			continue;
+		}
+		auto s = this->soup;
+		for (uint32_t i = 1; i + 1 < size; i++)
+		{
+			uint32_t triangle[3] = { 0, i, i + 1 };
+			for (auto k : triangle)
+			{
+				s->Positions.insert(s->Positions.end(), resolved[k][0], resolved[k][0] + 3);
+				if (resolved[k][1])
+				{
+					s->TexCoords.insert(s->TexCoords.end(), resolved[k][1], resolved[k][1] + 2);
+					s->HasTexCoords = true;
+				}
+				else
+					s->TexCoords.insert(s->TexCoords.end(), 2, 0.0f);
+				if (resolved[k][2])
+				{
+					s->Normals.insert(s->Normals.end(), resolved[k][2], resolved[k][2] + 3);
+					s->HasNormals = true;
+				}
+				else
+					s->Normals.insert(s->Normals.end(), 3, 0.0f);
+			}
+		}
+	}
+	//group lines after the last face still name the next chunk's faces
+	for (; event < chunk->Events.size(); event++)
+	{
+		this->FlushObjSoup();
+		if (chunk->Events[event].Material)
+			this->soup->Material = chunk->Events[event].Name;
+		else
+			this->soup->Name = chunk->Events[event].Name;
+	}
+}
+
+//----------------------------------------------------------------------------- glTF
+
+///just enough JSON for a glTF document
+struct JsonValue
+{
+	enum JsonKind { JsonNull, JsonBool, JsonNumber, JsonString, JsonArray, JsonObject };
+	JsonKind Kind = JsonNull;
+	bool Bool = false;
+	double Number = 0;
+	std::string String;
+	///array elements, or object members paired with Keys
+	std::vector<JsonValue> Items;
+	std::vector<std::string> Keys;
+	const JsonValue* Find(const char* key) const
+	{
+		for (size_t i = 0; i < this->Keys.size(); i++)
+		{
+			if (this->Keys[i] == key)
+				return &this->Items[i];
+		}
+		return NULL;
+	}
+	const JsonValue* At(size_t index) const { return this->Kind == JsonArray && index < this->Items.size() ? &this->Items[index] : NULL; }
+	double Get(const char* key, double fallback) const
+	{
+		auto v = this->Find(key);
+		return v && v->Kind == JsonNumber ? v->Number : fallback;
+	}
+	///array index stored in this value, SIZE_MAX when it is not a usable one
+	size_t AsIndex() const { return this->Kind == JsonNumber && this->Number >= 0 && this->Number < 4294967296.0 ? (size_t)this->Number : SIZE_MAX; }
+	size_t Index(const char* key) const
+	{
+		auto v = this->Find(key);
+		return v ? v->AsIndex() : SIZE_MAX;
+	}
+};
+
+static const char* SkipJsonSpace(const char* p)
+{
+	while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')
+		p++;
+	return p;
+}
+
+static const char* ParseJsonString(const char* p, std::string& out)
+{
+	if (*p++ != '"')
+		return NULL;
+	while (*p != '"')
+	{
+		if (*p == 0)
+			return NULL;
+		if (*p != '\\')
+		{
+			out.push_back(*p++);
+			continue;
+		}
+		p++;
+		switch (*p++)
+		{
+		case '"': out.push_back('"'); break;
+		case '\\': out.push_back('\\'); break;
+		case '/': out.push_back('/'); break;
+		case 'b': out.push_back('\b'); break;
+		case 'f': out.push_back('\f'); break;
+		case 'n': out.push_back('\n'); break;
+		case 'r': out.push_back('\r'); break;
+		case 't': out.push_back('\t'); break;
+		case 'u':
+		{
+			unsigned code = 0;
+			for (int i = 0; i < 4; i++, p++)
+			{
+				char c = *p;
+				unsigned digit = c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : c >= 'A' && c <= 'F' ? c - 'A' + 10 : 16;
+				if (digit == 16)
+					return NULL;
+				code = code * 16 + digit;
+			}
+			//utf-8, surrogate pairs are kept as two 3 byte sequences
+			if (code < 0x80)
+				out.push_back((char)code);
+			else if (code < 0x800)
+			{
+				out.push_back((char)(0xc0 | (code >> 6)));
+				out.push_back((char)(0x80 | (code & 0x3f)));
+			}
+			else
+			{
+				out.push_back((char)(0xe0 | (code >> 12)));
+				out.push_back((char)(0x80 | ((code >> 6) & 0x3f)));
+				out.push_back((char)(0x80 | (code & 0x3f)));
+			}
+			break;
+		}
+		default:
+			return NULL;
+		}
+	}
+	return p + 1;
+}
+
+static const char* ParseJson(const char* p, JsonValue& v, int depth)
+{
+	if (depth > 64)
+		return NULL;
+	p = SkipJsonSpace(p);
+	if (*p == '{' || *p == '[')
+	{
+		bool object = *p == '{';
+		char close = object ? '}' : ']';
+		v.Kind = object ? JsonValue::JsonObject : JsonValue::JsonArray;
+		p = SkipJsonSpace(p + 1);
+		if (*p == close)
+			return p + 1;
+		while (true)
+		{
+			if (object)
+			{
+				v.Keys.push_back(std::string());
+				p = ParseJsonString(p, v.Keys.back());
+				if (p == NULL)
+					return NULL;
+				p = SkipJsonSpace(p);
+				if (*p++ != ':')
+					return NULL;
+			}
+			v.Items.push_back(JsonValue());
+			p = ParseJson(p, v.Items.back(), depth + 1);
+			if (p == NULL)
+				return NULL;
+			p = SkipJsonSpace(p);
+			if (*p == close)
+				return p + 1;
+			if (*p++ != ',')
+				return NULL;
+			p = SkipJsonSpace(p);
+		}
+	}
+	if (*p == '"')
+	{
+		v.Kind = JsonValue::JsonString;
+		return ParseJsonString(p, v.String);
+	}
+	if (strncmp(p, "true", 4) == 0 || strncmp(p, "false", 5) == 0)
+	{
+		v.Kind = JsonValue::JsonBool;
+		v.Bool = *p == 't';
+		return p + (v.Bool ? 4 : 5);
+	}
+	if (strncmp(p, "null", 4) == 0)
+		return p + 4;
+	char* end = NULL;
+	v.Kind = JsonValue::JsonNumber;
+	v.Number = strtod(p, &end);
+	return end == p ? NULL : end;
+}
+
+struct GltfBuffer
+{
+	const uint8_t* Data;
+	size_t Size;
+};
+
+static int GltfComponentCount(const std::string& type)
+{
+	if (type == "SCALAR") return 1;
+	if (type == "VEC2") return 2;
+	if (type == "VEC3") return 3;
+	if (type == "VEC4") return 4;
+	return 0;
+}
+
+static size_t GltfComponentSize(int componentType)
+{
+	switch (componentType)
+	{
+	case GL_BYTE: case GL_UNSIGNED_BYTE: return 1;
+	case GL_SHORT: case GL_UNSIGNED_SHORT: return 2;
+	case GL_UNSIGNED_INT: case GL_FLOAT: return 4;
+	}
+	return 0;
+}
+
+///element pointer + stride of an accessor after bounds checks, NULL when it cannot be read
+static const uint8_t* GltfAccessorData(const JsonValue& root, const std::vector<GltfBuffer>& buffers, const JsonValue& accessor, int components, size_t* count, size_t* stride, int* componentType)
+{
+	auto type = accessor.Find("type");
+	if (accessor.Find("sparse") || type == NULL || GltfComponentCount(type->String) != components)
+		return NULL;
+	*componentType = (int)accessor.Get("componentType", 0);
+	*count = accessor.Index("count");
+	auto elementSize = GltfComponentSize(*componentType) * components;
+	auto views = root.Find("bufferViews");
+	auto view = views ? views->At(accessor.Index("bufferView")) : NULL;
+	if (elementSize == 0 || view == NULL || *count == SIZE_MAX)
+		return NULL;
+	auto bufferIndex = view->Index("buffer");
+	if (bufferIndex >= buffers.size())
+		return NULL;
+	auto& buffer = buffers[bufferIndex];
+	//missing offsets default to 0, anything negative or huge comes back as SIZE_MAX and fails the checks below
+	auto viewOffset = view->Find("byteOffset") ? view->Index("byteOffset") : 0;
+	auto viewLength = view->Index("byteLength");
+	auto accessorOffset = accessor.Find("byteOffset") ? accessor.Index("byteOffset") : 0;
+	*stride = view->Find("byteStride") ? view->Index("byteStride") : elementSize;
+	if (*stride < elementSize || *stride == SIZE_MAX)
+		return NULL;
+	if (viewOffset > buffer.Size || viewLength > buffer.Size - viewOffset)
+		return NULL;
+	if (*count > 0 && (accessorOffset > viewLength || (uint64_t)(*count - 1) * *stride + elementSize > viewLength - accessorOffset))
+		return NULL;
+	return buffer.Data + viewOffset + accessorOffset;
+}
+
+static float GltfComponent(const uint8_t* p, int componentType, bool normalized)
+{
+	switch (componentType)
+	{
+	case GL_FLOAT: { float f; memcpy(&f, p, 4); return f; }
+	case GL_UNSIGNED_BYTE: return normalized ? *p / 255.0f : *p;
+	case GL_BYTE: { float f = (float)(int8_t)*p; return normalized ? (f / 127.0f < -1.0f ? -1.0f : f / 127.0f) : f; }
+	case GL_UNSIGNED_SHORT: { uint16_t u; memcpy(&u, p, 2); return normalized ? u / 65535.0f : u; }
+	case GL_SHORT: { int16_t s; memcpy(&s, p, 2); float f = s; return normalized ? (f / 32767.0f < -1.0f ? -1.0f : f / 32767.0f) : f; }
+	case GL_UNSIGNED_INT: { uint32_t u; memcpy(&u, p, 4); return (float)u; }
+	}
+	return 0;
+}
+
+///tightly packed aligned floats are used in place, anything else is converted into storage
+static const float* GltfReadFloats(const JsonValue& root, const std::vector<GltfBuffer>& buffers, const JsonValue* accessor, int components, size_t vertexCount, std::vector<float>& storage)
+{
+	if (accessor == NULL)
+		return NULL;
+	size_t count = 0, stride = 0;
+	int componentType = 0;
+	auto data = GltfAccessorData(root, buffers, *accessor, components, &count, &stride, &componentType);
+	if (data == NULL || count != vertexCount)
+		return NULL;
+	if (componentType == GL_FLOAT && stride == components * sizeof(float) && ((size_t)data & 3) == 0)
+		return (const float*)data;
+	auto normalized = accessor->Find("normalized");
+	bool isNormalized = normalized && normalized->Bool;
+	auto componentSize = GltfComponentSize(componentType);
+	storage.resize(count * components);
+	for (size_t i = 0; i < count; i++)
+	{
+		for (int c = 0; c < components; c++)
+			storage[i * components + c] = GltfComponent(data + i * stride + c * componentSize, componentType, isNormalized);
+	}
+	return storage.data();
+}
+
+static const GLuint* GltfReadIndices(const JsonValue& root, const std::vector<GltfBuffer>& buffers, const JsonValue& accessor, size_t vertexCount, size_t* indexCount, std::vector<GLuint>& storage)
+{
+	size_t stride = 0;
+	int componentType = 0;
+	auto data = GltfAccessorData(root, buffers, accessor, 1, indexCount, &stride, &componentType);
+	if (data == NULL || componentType == GL_FLOAT || componentType == GL_BYTE || componentType == GL_SHORT)
+		return NULL;
+	const GLuint* indices = (const GLuint*)data;
+	if (componentType != GL_UNSIGNED_INT || stride != 4 || ((size_t)data & 3) != 0)
+	{
+		storage.resize(*indexCount);
+		for (size_t i = 0; i < *indexCount; i++)
+			storage[i] = (GLuint)GltfComponent(data + i * stride, componentType, false);
+		indices = storage.data();
+	}
+	//MeshBuilder trusts its indices
+	for (size_t i = 0; i < *indexCount; i++)
+	{
+		if (indices[i] >= vertexCount)
+			return NULL;
+	}
+	return indices;
+}
+
+void ModelImporter::StartGltf(const std::string& path, bool binary)
+{
+	auto slash = path.find_last_of("/\\");
+	auto directory = slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+	this->jobs->Schedule([this, directory, binary]() { this->ParseGltf(directory, binary); }, &this->parsed);
+}
+
+void ModelImporter::ParseGltf(std::string directory, bool binary)
+{
+	auto data = this->file.Data();
+	auto size = this->file.Size();
+	std::string json;
+	GltfBuffer embedded = { NULL, 0 };
+	if (binary)
+	{
+		//12 byte header then chunks of (length, type, payload), JSON first and the optional BIN second
+		uint32_t header[3];
+		if (size < 20)
+		{
+			this->failed = true;
+			return;
+		}
+		memcpy(header, data, 12);
+		if (header[0] != 0x46546c67 || header[1] != 2)
+		{
+			this->failed = true;
+			return;
+		}
+		size_t offset = 12;
+		while (offset + 8 <= size)
+		{
+			uint32_t chunk[2];
+			memcpy(chunk, data + offset, 8);
+			offset += 8;
+			if (chunk[0] > size - offset)
+				break;
+			if (chunk[1] == 0x4e4f534a && json.empty())
+				json.assign((const char*)data + offset, chunk[0]);
+			else if (chunk[1] == 0x004e4942 && embedded.Data == NULL)
+				embedded = { data + offset, chunk[0] };
+			offset += (chunk[0] + 3) & ~3u;
+		}
+	}
+	else
+		json.assign((const char*)data, size);
+
+	JsonValue root;
+	if (ParseJson(json.c_str(), root, 0) == NULL || root.Kind != JsonValue::JsonObject)
+	{
+		this->failed = true;
+		return;
+	}
+	std::vector<GltfBuffer> buffers;
+	auto bufferList = root.Find("buffers");
+	for (size_t i = 0; bufferList && i < bufferList->Items.size(); i++)
+	{
+		GltfBuffer b = { NULL, 0 };
+		auto uri = bufferList->Items[i].Find("uri");
+		if (uri == NULL && binary && i == 0)
+			b = embedded;
+		else if (uri && uri->String.compare(0, 5, "data:") != 0)
+		{
+			//data: uris are not supported, those buffers read as empty and their meshes fail
+			MappedFile external;
+			if (external.Open((directory + uri->String).c_str(), MappedSequential))
+			{
+				b.Data = external.Data();
+				b.Size = external.Size();
+				this->buffers.push_back(std::move(external));
+			}
+		}
+		buffers.push_back(b);
+	}
+
+	auto meshes = root.Find("meshes");
+	auto materials = root.Find("materials");
+	for (size_t m = 0; meshes && m < meshes->Items.size(); m++)
+	{
+		auto& mesh = meshes->Items[m];
+		auto meshName = mesh.Find("name");
+		auto primitives = mesh.Find("primitives");
+		for (size_t p = 0; primitives && p < primitives->Items.size(); p++)
+		{
+			auto& primitive = primitives->Items[p];
+			auto attributes = primitive.Find("attributes");
+			auto position = attributes ? attributes->Find("POSITION") : NULL;
+			auto accessors = root.Find("accessors");
+			auto positionAccessor = position && accessors ? accessors->At(position->AsIndex()) : NULL;
+			//triangles only, strips and fans are rare enough to skip
+			if (primitive.Get("mode", GL_TRIANGLES) != GL_TRIANGLES || positionAccessor == NULL)
+			{
+				this->failed = true;
+				continue;
+			}
+			auto accessorOf = [&](const char* name) -> const JsonValue*
+			{
+				auto index = attributes->Find(name);
+				return index ? accessors->At(index->AsIndex()) : NULL;
+			};
+			//the gathered streams live on the heap until the build job is done with them
+			struct Streams
+			{
+				std::vector<float> Positions, TexCoords, Normals, Tangents;
+				std::vector<GLuint> Indices;
+				MeshSource Source;
+			};
+			auto streams = new Streams();
+			auto& source = streams->Source;
+			source.VertexCount = positionAccessor->Index("count");
+			source.Positions = GltfReadFloats(root, buffers, positionAccessor, 3, source.VertexCount, streams->Positions);
+			source.TexCoords = GltfReadFloats(root, buffers, accessorOf("TEXCOORD_0"), 2, source.VertexCount, streams->TexCoords);
+			source.Normals = GltfReadFloats(root, buffers, accessorOf("NORMAL"), 3, source.VertexCount, streams->Normals);
+			if (this->locations.Tangent >= 0)
+				source.Tangents = GltfReadFloats(root, buffers, accessorOf("TANGENT"), 4, source.VertexCount, streams->Tangents);
+			bool valid = source.Positions != NULL;
+			auto indexAccessor = primitive.Find("indices");
+			if (valid && indexAccessor)
+			{
+				auto accessor = accessors->At(indexAccessor->AsIndex());
+				source.Indices = accessor ? GltfReadIndices(root, buffers, *accessor, source.VertexCount, &source.IndexCount, streams->Indices) : NULL;
+				valid = source.Indices != NULL;
+			}
+			if (!valid)
+			{
+				this->failed = true;
+				delete streams;
+				continue;
+			}
+			auto result = new ImportedMesh();
+			result->Name = (meshName ? meshName->String : std::to_string(m)) + "#" + std::to_string(p);
+			auto material = primitive.Find("material");
+			if (material)
+			{
+				auto entry = materials ? materials->At(material->AsIndex()) : NULL;
+				auto materialName = entry ? entry->Find("name") : NULL;
+				result->Material = materialName ? materialName->String : std::to_string(material->AsIndex());
+			}
+			result->Index = this->meshCount++;
+			this->jobs->Schedule([this, streams, result]()
+			{
+				this->Build(streams->Source, result);
+				delete streams;
+			}, &this->built);
+		}
+	}
+}
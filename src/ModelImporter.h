@@ -0,0 +1,96 @@
+#pragma once
+#include "JobSystem.h"
+#include "MappedFile.h"
+#include "MeshBuilder.h"
+#include "MeshSimplifier.h"
+#include "Meshlet.h"
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+///one finished mesh, already interleaved, indexed and welded by MeshBuilder
+struct ImportedMesh
+{
+	///OBJ object/group name or glTF mesh name, "#n" appended for the n-th primitive
+	std::string Name;
+	///OBJ usemtl name or glTF material name/index, empty when the mesh has none
+	std::string Material;
+	///order the mesh appears in the file, results can arrive out of order
+	size_t Index = 0;
+	///bounds are in BuiltMesh::BoundsMin/BoundsMax, LODs in BuiltMesh::Lods
+	BuiltMesh Mesh;
+	///clusters of LOD 0 when enabled, LOD 0's indices are then already in meshlet order
+	MeshletMesh Meshlets;
+};
+
+///fast path for the common "-12.345e-6" shape, exact for up to 19 significant digits and
+///|exponent| <= 22, anything else goes through strtod. returns the end of the number,
+///or p itself when there is none
+const char* ParseFloatFast(const char* p, const char* end, float* out);
+
+///Reads OBJ (text) and glTF (.gltf + external .bin or .glb) files on the job system and hands out
+///meshes through a queue as soon as each one is built, so the first meshes can be drawn while the
+///rest of the file is still being parsed. glTF node transforms are not applied, meshes come out
+///in their own space.
+class ModelImporter
+{
+public:
+	ModelImporter(JobSystem* jobs, const MeshCompression& compression = MeshCompression(), const MeshAttributeLocations& locations = MeshAttributeLocations());
+	///waits for outstanding jobs
+	~ModelImporter();
+	ModelImporter(const ModelImporter&) = delete;
+	ModelImporter& operator=(const ModelImporter&) = delete;
+	///OBJ only, ignore o/g/usemtl and produce a single mesh
+	void SetMergeObjects(bool merge) { this->mergeObjects = merge; }
+	///LODs are built on the same job as the mesh, off by default
+	void SetLodSettings(const LodSettings& settings) { this->lodSettings = settings; }
+	///split LOD 0 into meshlets for cluster culling, off by default
+	void SetBuildMeshlets(bool build) { this->buildMeshlets = build; }
+	///maps the file and schedules the parse, false if it cannot be opened or the importer is busy
+	bool Start(const char* path);
+	///pops one finished mesh, any thread
+	bool Poll(ImportedMesh& mesh);
+	///every mesh has been pushed, the queue may still hold some
+	bool IsDone() const { return !this->started || (this->parsed.IsDone() && this->built.IsDone()); }
+	///set when something in the file could not be read, meshes before it still arrive
+	bool HasFailed() const { return this->failed.load(); }
+	///runs jobs on the calling thread until IsDone
+	void Wait();
+private:
+	struct ObjChunk;
+	struct ObjSoup;
+	void StartObj();
+	void ParseObjChunk(size_t chunk);
+	void ResolveObjChunk(size_t chunk);
+	void FlushObjSoup();
+	///stream 0 positions, 1 texcoords, 2 normals, NULL when the index is out of range
+	const float* FindObjElement(size_t chunk, size_t global, int stream) const;
+	void StartGltf(const std::string& path, bool binary);
+	void ParseGltf(std::string directory, bool binary);
+	void Build(const MeshSource& source, ImportedMesh* result);
+	void Push(ImportedMesh* mesh);
+	JobSystem* jobs;
+	MeshCompression compression;
+	MeshAttributeLocations locations;
+	LodSettings lodSettings;
+	bool mergeObjects = false;
+	bool buildMeshlets = false;
+	bool started = false;
+	std::atomic<bool> failed;
+	MappedFile file;
+	///.bin files a .gltf points at
+	std::vector<MappedFile> buffers;
+	std::vector<ObjChunk*> chunks;
+	///ready[i] reaches zero once chunk i is parsed and chunk i - 1 resolved
+	std::vector<JobCounter*> ready;
+	///zero once all parse/resolve work is over, build jobs are scheduled before it gets there
+	JobCounter parsed;
+	JobCounter built;
+	///only touched by the resolve chain, which runs one chunk at a time
+	ObjSoup* soup = NULL;
+	size_t meshCount = 0;
+	std::mutex resultLock;
+	std::deque<ImportedMesh*> results;
+};
@@ -0,0 +1,262 @@
+#include "RangeAllocator.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+static uint32_t HighestBit(uint32_t v)
+{
+	unsigned long index;
+	_BitScanReverse(&index, v);
+	return index;
+}
+static uint32_t LowestBit(uint32_t v)
+{
+	unsigned long index;
+	_BitScanForward(&index, v);
+	return index;
+}
+#else
+static uint32_t HighestBit(uint32_t v) { return 31 - __builtin_clz(v); }
+static uint32_t LowestBit(uint32_t v) { return __builtin_ctz(v); }
+#endif
+
+RangeAllocator::RangeAllocator(uint32_t capacity)
+	: capacity(capacity),
+	freeSpace(0)
+{
+	for (uint32_t i = 0; i < FirstLevelCount; i++)
+	{
+		this->secondLevelMap[i] = 0;
+		for (uint32_t j = 0; j < SecondLevelCount; j++)
+			this->heads[i][j] = InvalidNode;
+	}
+	auto node = this->NewNode();
+	auto& n = this->nodes[node];
+	n.Offset = 0;
+	n.Size = capacity;
+	this->lastNode = node;
+	if (capacity > 0)
+	{
+		this->InsertFree(node);
+		this->freeSpace = capacity;
+	}
+}
+
+void RangeAllocator::Mapping(uint32_t size, uint32_t& fl, uint32_t& sl)
+{
+	//sizes below SecondLevelCount get exact bins in level 0, above that each power of two is split in SecondLevelCount
+	if (size < SecondLevelCount)
+	{
+		fl = 0;
+		sl = size;
+		return;
+	}
+	auto msb = HighestBit(size);
+	fl = msb - SecondLevelBits + 1;
+	sl = (size >> (msb - SecondLevelBits)) ^ SecondLevelCount;
+}
+
+uint32_t RangeAllocator::NewNode()
+{
+	uint32_t index;
+	if (!this->unusedNodes.empty())
+	{
+		index = this->unusedNodes.back();
+		this->unusedNodes.pop_back();
+	}
+	else
+	{
+		index = (uint32_t)this->nodes.size();
+		this->nodes.push_back(Node());
+	}
+	auto& n = this->nodes[index];
+	n.Offset = 0;
+	n.Size = 0;
+	n.PrevPhysical = InvalidNode;
+	n.NextPhysical = InvalidNode;
+	n.PrevFree = InvalidNode;
+	n.NextFree = InvalidNode;
+	n.Free = false;
+	return index;
+}
+
+void RangeAllocator::InsertFree(uint32_t node)
+{
+	auto& n = this->nodes[node];
+	uint32_t fl, sl;
+	Mapping(n.Size, fl, sl);
+	n.Free = true;
+	n.PrevFree = InvalidNode;
+	n.NextFree = this->heads[fl][sl];
+	if (n.NextFree != InvalidNode)
+		this->nodes[n.NextFree].PrevFree = node;
+	this->heads[fl][sl] = node;
+	this->firstLevelMap |= 1u << fl;
+	this->secondLevelMap[fl] |= 1u << sl;
+}
+
+void RangeAllocator::RemoveFree(uint32_t node)
+{
+	auto& n = this->nodes[node];
+	uint32_t fl, sl;
+	Mapping(n.Size, fl, sl);
+	if (n.PrevFree != InvalidNode)
+		this->nodes[n.PrevFree].NextFree = n.NextFree;
+	else
+		this->heads[fl][sl] = n.NextFree;
+	if (n.NextFree != InvalidNode)
+		this->nodes[n.NextFree].PrevFree = n.PrevFree;
+	if (this->heads[fl][sl] == InvalidNode)
+	{
+		this->secondLevelMap[fl] &= ~(1u << sl);
+		if (this->secondLevelMap[fl] == 0)
+			this->firstLevelMap &= ~(1u << fl);
+	}
+	n.Free = false;
+	n.PrevFree = InvalidNode;
+	n.NextFree = InvalidNode;
+}
+
+uint32_t RangeAllocator::FindFree(uint32_t size)
+{
+	//round up to the next bin boundary so any block in the found bin is big enough
+	if (size >= SecondLevelCount)
+	{
+		auto round = (1u << (HighestBit(size) - SecondLevelBits)) - 1;
+		if (size > 0xffffffffu - round)
+			return InvalidNode;
+		size += round;
+	}
+	uint32_t fl, sl;
+	Mapping(size, fl, sl);
+	if (fl >= FirstLevelCount)
+		return InvalidNode;
+	auto slMap = this->secondLevelMap[fl] & (~0u << sl);
+	if (slMap == 0)
+	{
+		auto flMap = fl + 1 < FirstLevelCount ? this->firstLevelMap & (~0u << (fl + 1)) : 0;
+		if (flMap == 0)
+			return InvalidNode;
+		fl = LowestBit(flMap);
+		slMap = this->secondLevelMap[fl];
+	}
+	sl = LowestBit(slMap);
+	return this->heads[fl][sl];
+}
+
+RangeAllocator::Allocation RangeAllocator::Allocate(uint32_t size)
+{
+	Allocation result;
+	if (size == 0)
+		return result;
+	auto node = this->FindFree(size);
+	if (node == InvalidNode)
+		return result;
+	this->RemoveFree(node);
+	auto& n = this->nodes[node];
+	if (n.Size > size)
+	{
+		//split, the remainder goes back as a free block right after us
+		auto rest = this->NewNode();
+		auto& r = this->nodes[rest];
+		auto& m = this->nodes[node];
+		r.Offset = m.Offset + size;
+		r.Size = m.Size - size;
+		r.PrevPhysical = node;
+		r.NextPhysical = m.NextPhysical;
+		if (m.NextPhysical != InvalidNode)
+			this->nodes[m.NextPhysical].PrevPhysical = rest;
+		else
+			this->lastNode = rest;
+		m.NextPhysical = rest;
+		m.Size = size;
+		this->InsertFree(rest);
+	}
+	auto& m = this->nodes[node];
+	this->freeSpace -= m.Size;
+	result.Offset = m.Offset;
+	result.Size = m.Size;
+	result.Node = node;
+	return result;
+}
+
+void RangeAllocator::Free(Allocation allocation)
+{
+	if (!allocation.IsValid())
+		return;
+	auto node = allocation.Node;
+	this->freeSpace += this->nodes[node].Size;
+	auto prev = this->nodes[node].PrevPhysical;
+	if (prev != InvalidNode && this->nodes[prev].Free)
+	{
+		this->RemoveFree(prev);
+		auto& p = this->nodes[prev];
+		auto& n = this->nodes[node];
+		p.Size += n.Size;
+		p.NextPhysical = n.NextPhysical;
+		if (n.NextPhysical != InvalidNode)
+			this->nodes[n.NextPhysical].PrevPhysical = prev;
+		else
+			this->lastNode = prev;
+		this->unusedNodes.push_back(node);
+		node = prev;
+	}
+	auto next = this->nodes[node].NextPhysical;
+	if (next != InvalidNode && this->nodes[next].Free)
+	{
+		this->RemoveFree(next);
+		auto& n = this->nodes[node];
+		auto& x = this->nodes[next];
+		n.Size += x.Size;
+		n.NextPhysical = x.NextPhysical;
+		if (x.NextPhysical != InvalidNode)
+			this->nodes[x.NextPhysical].PrevPhysical = node;
+		else
+			this->lastNode = node;
+		this->unusedNodes.push_back(next);
+	}
+	this->InsertFree(node);
+}
+
+void RangeAllocator::Grow(uint32_t newCapacity)
+{
+	if (newCapacity <= this->capacity)
+		return;
+	auto extra = newCapacity - this->capacity;
+	auto last = this->lastNode;
+	if (this->nodes[last].Free || this->nodes[last].Size == 0)
+	{
+		//extend the trailing free (or empty initial) block in place
+		if (this->nodes[last].Free)
+			this->RemoveFree(last);
+		this->nodes[last].Size += extra;
+		this->InsertFree(last);
+	}
+	else
+	{
+		auto node = this->NewNode();
+		auto& n = this->nodes[node];
+		n.Offset = this->capacity;
+		n.Size = extra;
+		n.PrevPhysical = last;
+		this->nodes[last].NextPhysical = node;
+		this->lastNode = node;
+		this->InsertFree(node);
+	}
+	this->capacity = newCapacity;
+	this->freeSpace += extra;
+}
+
+uint32_t RangeAllocator::LargestFreeBlock()
+{
+	if (this->firstLevelMap == 0)
+		return 0;
+	auto fl = HighestBit(this->firstLevelMap);
+	auto sl = HighestBit(this->secondLevelMap[fl]);
+	uint32_t largest = 0;
+	for (auto node = this->heads[fl][sl]; node != InvalidNode; node = this->nodes[node].NextFree)
+	{
+		if (this->nodes[node].Size > largest)
+			largest = this->nodes[node].Size;
+	}
+	return largest;
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+///TLSF style allocator over an abstract range [0, capacity) of units (vertices, indices, bytes...).
+///two level segregated free lists with bitmaps give O(1) allocate and free, neighbours are merged on free.
+///only bookkeeping, the memory itself lives somewhere else (a GL buffer)
+class RangeAllocator
+{
+public:
+	static const uint32_t InvalidNode = 0xffffffff;
+	struct Allocation
+	{
+		uint32_t Offset = 0;
+		uint32_t Size = 0;
+		uint32_t Node = InvalidNode;
+		bool IsValid() const { return this->Node != InvalidNode; }
+	};
+
+	explicit RangeAllocator(uint32_t capacity);
+	Allocation Allocate(uint32_t size);
+	void Free(Allocation allocation);
+	///extends the range at the end, the new space merges with a free block already there
+	void Grow(uint32_t newCapacity);
+	uint32_t GetCapacity() { return this->capacity; }
+	uint32_t GetFreeSpace() { return this->freeSpace; }
+	///largest block Allocate can currently return
+	uint32_t LargestFreeBlock();
+private:
+	static const uint32_t SecondLevelBits = 3;
+	static const uint32_t SecondLevelCount = 1 << SecondLevelBits;
+	static const uint32_t FirstLevelCount = 32;
+	struct Node
+	{
+		uint32_t Offset;
+		uint32_t Size;
+		uint32_t PrevPhysical;
+		uint32_t NextPhysical;
+		uint32_t PrevFree;
+		uint32_t NextFree;
+		bool Free;
+	};
+	static void Mapping(uint32_t size, uint32_t& fl, uint32_t& sl);
+	uint32_t NewNode();
+	void InsertFree(uint32_t node);
+	void RemoveFree(uint32_t node);
+	uint32_t FindFree(uint32_t size);
+	std::vector<Node> nodes;
+	std::vector<uint32_t> unusedNodes;
+	uint32_t heads[FirstLevelCount][SecondLevelCount];
+	uint32_t firstLevelMap = 0;
+	uint32_t secondLevelMap[FirstLevelCount];
+	///node at the end of the range, Grow appends after it
+	uint32_t lastNode;
+	uint32_t capacity;
+	uint32_t freeSpace;
+};
@@ -0,0 +1,70 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+
+///bounded lock-free queue for exactly one producer thread and one consumer thread
+///Capacity must be a power of two, Push fails instead of blocking when the queue is full
+template <typename T, size_t Capacity>
+class SpscQueue
+{
+	static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "SpscQueue capacity must be a power of two");
+public:
+	SpscQueue()
+		: head(0),
+		tail(0),
+		cachedHead(0),
+		cachedTail(0) {}
+	///producer side
+	bool Push(const T& item);
+	///consumer side
+	bool Pop(T& item);
+	///approximate, exact only when called from the producer or consumer with the other side idle
+	size_t Size() const { return this->tail.load(std::memory_order_acquire) - this->head.load(std::memory_order_acquire); }
+	bool Empty() const { return this->Size() == 0; }
+private:
+	static const size_t Mask = Capacity - 1;
+	T items[Capacity];
+	///padding keeps each side on its own cache line without needing over-aligned new
+	char pad0[64];
+	///next slot to read, written only by the consumer
+	std::atomic<size_t> head;
+	char pad1[64];
+	///next slot to write, written only by the producer
+	std::atomic<size_t> tail;
+	char pad2[64];
+	///producer's last seen head, saves touching the consumer's cache line on every push
+	size_t cachedHead;
+	char pad3[64];
+	///consumer's last seen tail
+	size_t cachedTail;
+};
+
+template <typename T, size_t Capacity>
+bool SpscQueue<T, Capacity>::Push(const T& item)
+{
+	auto t = this->tail.load(std::memory_order_relaxed);
+	if (t - this->cachedHead == Capacity)
+	{
+		this->cachedHead = this->head.load(std::memory_order_acquire);
+		if (t - this->cachedHead == Capacity)
+			return false;
+	}
+	this->items[t & Mask] = item;
+	this->tail.store(t + 1, std::memory_order_release);
+	return true;
+}
+
+template <typename T, size_t Capacity>
+bool SpscQueue<T, Capacity>::Pop(T& item)
+{
+	auto h = this->head.load(std::memory_order_relaxed);
+	if (h == this->cachedTail)
+	{
+		this->cachedTail = this->tail.load(std::memory_order_acquire);
+		if (h == this->cachedTail)
+			return false;
+	}
+	item = this->items[h & Mask];
+	this->head.store(h + 1, std::memory_order_release);
+	return true;
+}
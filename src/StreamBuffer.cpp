@@ -0,0 +1,144 @@
+#include "StreamBuffer.h"
+#include <cstring>
+
+StreamBuffer::StreamBuffer(GLenum target, GLsizeiptr regionSize, int regionCount)
+	: target(target),
+	regionSize(regionSize),
+	regionCount(regionCount < 1 ? 1 : (regionCount > 8 ? 8 : regionCount))
+{
+	for (int i = 0; i < 8; i++)
+		this->fences[i] = 0;
+	auto total = this->regionSize * this->regionCount;
+	glGenBuffers(1, &this->ID);
+	glBindBuffer(this->target, this->ID);
+	if (GLExt.BufferStorage)
+	{
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		GLExt.glBufferStorage(this->target, total, NULL, flags);
+		this->mapped = (char*)glMapBufferRange(this->target, 0, total, flags);
+		this->persistent = this->mapped != NULL;
+	}
+	if (!this->persistent)
+	{
+		//storage might have been created immutable above if the map failed, start over with a mutable buffer
+		if (GLExt.BufferStorage)
+		{
+			glDeleteBuffers(1, &this->ID);
+			glGenBuffers(1, &this->ID);
+			glBindBuffer(this->target, this->ID);
+		}
+		glBufferData(this->target, total, NULL, GL_STREAM_DRAW);
+		this->mapped = NULL;
+	}
+}
+
+StreamBuffer::~StreamBuffer()
+{
+	for (int i = 0; i < this->regionCount; i++)
+	{
+		if (this->fences[i] != 0)
+			glDeleteSync(this->fences[i]);
+	}
+	if (this->mapped != NULL)
+	{
+		glBindBuffer(this->target, this->ID);
+		glUnmapBuffer(this->target);
+	}
+	glDeleteBuffers(1, &this->ID);
+}
+
+GLsizeiptr StreamBuffer::UniformAlignment()
+{
+	GLint alignment = 256;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	return alignment > 0 ? alignment : 256;
+}
+
+void StreamBuffer::WaitRegion(int region)
+{
+	auto fence = this->fences[region];
+	if (fence == 0)
+		return;
+	//first wait flushes so the fence is guaranteed to signal, then poll in 1ms steps
+	GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+	for (;;)
+	{
+		auto result = glClientWaitSync(fence, flags, 1000000);
+		if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED || result == GL_WAIT_FAILED)
+			break;
+		flags = 0;
+	}
+	glDeleteSync(fence);
+	this->fences[region] = 0;
+}
+
+bool StreamBuffer::BeginFrame()
+{
+	if (this->inFrame)
+		return false;
+	this->current = (this->current + 1) % this->regionCount;
+	this->used = 0;
+	this->WaitRegion(this->current);
+	if (!this->persistent)
+	{
+		//the fence already proved the GPU is done with this region, so skip the driver's own sync
+		glBindBuffer(this->target, this->ID);
+		this->mapped = (char*)glMapBufferRange(this->target, this->current * this->regionSize, this->regionSize,
+			GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_FLUSH_EXPLICIT_BIT);
+		if (this->mapped == NULL)
+			return false;
+	}
+	this->inFrame = true;
+	this->flushed = false;
+	return true;
+}
+
+StreamAllocation StreamBuffer::Allocate(GLsizeiptr size, GLsizeiptr alignment)
+{
+	StreamAllocation result;
+	if (!this->inFrame || this->flushed)
+		return result;
+	auto base = this->current * this->regionSize;
+	//align the absolute buffer offset, that is what glBindBufferRange checks
+	auto offset = ((base + this->used + alignment - 1) & ~(alignment - 1)) - base;
+	if (offset + size > this->regionSize)
+		return result;
+	this->used = offset + size;
+	result.Buffer = this->ID;
+	result.Offset = base + offset;
+	result.Size = size;
+	result.Pointer = this->persistent ? this->mapped + base + offset : this->mapped + offset;
+	return result;
+}
+
+StreamAllocation StreamBuffer::Upload(const void* data, GLsizeiptr size, GLsizeiptr alignment)
+{
+	auto result = this->Allocate(size, alignment);
+	if (result.Pointer != NULL)
+		memcpy(result.Pointer, data, size);
+	return result;
+}
+
+void StreamBuffer::Flush()
+{
+	if (!this->inFrame || this->flushed)
+		return;
+	this->flushed = true;
+	//coherent mappings need nothing, the writes are visible to commands issued after them
+	if (this->persistent)
+		return;
+	glBindBuffer(this->target, this->ID);
+	if (this->used > 0)
+		glFlushMappedBufferRange(this->target, 0, this->used);
+	glUnmapBuffer(this->target);
+	this->mapped = NULL;
+}
+
+void StreamBuffer::EndFrame()
+{
+	if (!this->inFrame)
+		return;
+	this->Flush();
+	this->fences[this->current] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	this->inFrame = false;
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include "GLExtensions.h"
+
+///one sub-allocation, write through Pointer before the frame is submitted and draw from Buffer at Offset
+struct StreamAllocation
+{
+	void* Pointer = NULL;
+	GLuint Buffer = 0;
+	GLintptr Offset = 0;
+	GLsizeiptr Size = 0;
+};
+
+///ring of per-frame regions in one GL buffer for uniforms, instance data and immediate geometry.
+///uses a persistent coherent mapping when buffer storage is available, otherwise maps the
+///frame's region with GL_MAP_UNSYNCHRONIZED_BIT. either way a fence per region keeps the CPU
+///from overwriting data the GPU has not read yet, so there is no reallocation or implicit sync
+class StreamBuffer
+{
+public:
+	StreamBuffer(GLenum target, GLsizeiptr regionSize, int regionCount = 3);
+	~StreamBuffer();
+	///moves to the next region and waits for the GPU to release it
+	bool BeginFrame();
+	///NULL Pointer when the region is full, alignment must be a power of two
+	StreamAllocation Allocate(GLsizeiptr size, GLsizeiptr alignment = 16);
+	///copy helper around Allocate
+	StreamAllocation Upload(const void* data, GLsizeiptr size, GLsizeiptr alignment = 16);
+	///makes what was written this frame visible to GL, call once it is all written and before the draws that
+	///read it (without persistent mapping the region is unmapped here, GL can not draw from a mapped buffer).
+	///no more Allocate until the next BeginFrame
+	void Flush();
+	///fences the region, call after the frame's draws
+	void EndFrame();
+	GLuint GetId() { return this->ID; }
+	bool IsPersistent() { return this->persistent; }
+	GLsizeiptr GetRegionSize() { return this->regionSize; }
+	///GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, use it as alignment for glBindBufferRange uniform blocks
+	static GLsizeiptr UniformAlignment();
+private:
+	void WaitRegion(int region);
+	GLuint ID = 0;
+	GLenum target;
+	GLsizeiptr regionSize;
+	int regionCount;
+	int current = -1;
+	GLsizeiptr used = 0;
+	bool persistent = false;
+	bool inFrame = false;
+	bool flushed = false;
+	///whole buffer when persistent, only the current region otherwise
+	char* mapped = NULL;
+	GLsync fences[8];
+};
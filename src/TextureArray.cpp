@@ -0,0 +1,284 @@
+#include "TextureArray.h"
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <tuple>
+
+//GL 3.3 guarantees at least this many layers per array
+static const size_t MaxArrayLayers = 256;
+
+AtlasPacker::AtlasPacker(int width, int height)
+	: width(width),
+	height(height)
+{
+	this->Reset();
+}
+
+void AtlasPacker::Reset()
+{
+	this->skyline.clear();
+	Segment all = { 0, 0, this->width };
+	this->skyline.push_back(all);
+	this->used = 0;
+}
+
+int AtlasPacker::Fit(size_t index, int width, int height) const
+{
+	auto x = this->skyline[index].X;
+	if (x + width > this->width)
+		return -1;
+	int y = 0;
+	for (int left = width; left > 0; index++)
+	{
+		y = std::max(y, this->skyline[index].Y);
+		if (y + height > this->height)
+			return -1;
+		left -= this->skyline[index].Width;
+	}
+	return y;
+}
+
+bool AtlasPacker::Pack(int width, int height, int* x, int* y)
+{
+	size_t best = SIZE_MAX;
+	int bestTop = INT_MAX, bestWidth = INT_MAX;
+	for (size_t i = 0; i < this->skyline.size(); i++)
+	{
+		int top = this->Fit(i, width, height);
+		if (top < 0)
+			continue;
+		//lowest top edge first, the narrower segment on ties wastes less
+		if (top + height < bestTop || (top + height == bestTop && this->skyline[i].Width < bestWidth))
+		{
+			best = i;
+			bestTop = top + height;
+			bestWidth = this->skyline[i].Width;
+		}
+	}
+	if (best == SIZE_MAX)
+		return false;
+	*x = this->skyline[best].X;
+	*y = bestTop - height;
+
+	Segment placed = { *x, bestTop, width };
+	this->skyline.insert(this->skyline.begin() + best, placed);
+	//cut back the segments the new one now covers
+	for (size_t i = best + 1; i < this->skyline.size(); i++)
+	{
+		auto& previous = this->skyline[i - 1];
+		auto& s = this->skyline[i];
+		int overlap = previous.X + previous.Width - s.X;
+		if (overlap <= 0)
+			break;
+		s.X += overlap;
+		s.Width -= overlap;
+		if (s.Width > 0)
+			break;
+		this->skyline.erase(this->skyline.begin() + i);
+		i--;
+	}
+	for (size_t i = 0; i + 1 < this->skyline.size(); i++)
+	{
+		if (this->skyline[i].Y == this->skyline[i + 1].Y)
+		{
+			this->skyline[i].Width += this->skyline[i + 1].Width;
+			this->skyline.erase(this->skyline.begin() + i + 1);
+			i--;
+		}
+	}
+	this->used += (long long)width * height;
+	return true;
+}
+
+TextureArrayBuilder::TextureArrayBuilder(int smallSize, int atlasSize, int padding)
+	: smallSize(std::min(smallSize, atlasSize - padding * 2)),
+	atlasSize(atlasSize),
+	padding(padding)
+{
+}
+
+size_t TextureArrayBuilder::Add(const unsigned char* pixels, int width, int height, int channels, TextureUsage usage)
+{
+	Image image;
+	if (pixels == NULL || width <= 0 || height <= 0)
+		width = height = 0;
+	else
+		image.Pixels.assign(pixels, pixels + (size_t)width * height * channels);
+	image.Width = width;
+	image.Height = height;
+	image.Channels = channels;
+	image.Usage = usage;
+	this->images.push_back(std::move(image));
+	this->slots.push_back(TextureSlot());
+	return this->images.size() - 1;
+}
+
+void TextureArrayBuilder::Pack(JobSystem* jobs)
+{
+	this->pending.clear();
+	std::vector<size_t> small;
+	//(width, height, channels, usage) -> images of that shape and format
+	std::map<std::tuple<int, int, int, int>, std::vector<size_t>> groups;
+	for (size_t i = this->packedCount; i < this->images.size(); i++)
+	{
+		auto& image = this->images[i];
+		//failed decodes keep an empty slot
+		if (image.Pixels.empty())
+			continue;
+		if (image.Width <= this->smallSize && image.Height <= this->smallSize)
+			small.push_back(i);
+		else
+			groups[std::make_tuple(image.Width, image.Height, image.Channels, (int)image.Usage)].push_back(i);
+	}
+	for (auto& group : groups)
+	{
+		for (size_t first = 0; first < group.second.size(); first += MaxArrayLayers)
+		{
+			PendingArray array;
+			array.Width = std::get<0>(group.first);
+			array.Height = std::get<1>(group.first);
+			array.Channels = std::get<2>(group.first);
+			array.Usage = (TextureUsage)std::get<3>(group.first);
+			for (size_t i = first; i < group.second.size() && i < first + MaxArrayLayers; i++)
+			{
+				auto id = group.second[i];
+				this->slots[id].Layer = (GLint)array.Layers.size();
+				this->slots[id].UVRect = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+				array.Layers.push_back(std::move(this->images[id].Pixels));
+				array.Users.push_back(id);
+			}
+			this->pending.push_back(std::move(array));
+		}
+	}
+	this->PackAtlases(small);
+	for (auto& array : this->pending)
+	{
+		MipSettings settings;
+		settings.Usage = array.Usage;
+		settings.Wrap = !array.Atlas;
+		for (auto& layer : array.Layers)
+			array.Mips.push_back(MipGenerator::Generate(layer.data(), array.Width, array.Height, array.Channels, settings, jobs));
+	}
+	this->packedCount = this->images.size();
+}
+
+void TextureArrayBuilder::PackAtlases(std::vector<size_t>& small)
+{
+	//tallest first packs a skyline much tighter
+	std::sort(small.begin(), small.end(), [this](size_t a, size_t b)
+	{
+		return this->images[a].Height > this->images[b].Height;
+	});
+	//one set of pages per channel count and usage, colour and data maps can not share an internal format
+	for (int format = 0; format < 8; format++)
+	{
+		int channels = format % 4 + 1;
+		auto usage = format < 4 ? TextureColor : TextureData;
+		PendingArray array;
+		array.Width = this->atlasSize;
+		array.Height = this->atlasSize;
+		array.Channels = channels;
+		array.Usage = usage;
+		array.Atlas = true;
+		std::vector<AtlasPacker> pages;
+		for (auto id : small)
+		{
+			auto& image = this->images[id];
+			if (image.Channels != channels || image.Usage != usage)
+				continue;
+			//the gutter repeats the edge texels so filtering and the smaller mips do not pick up neighbours
+			int w = image.Width + this->padding * 2, h = image.Height + this->padding * 2;
+			int x = 0, y = 0;
+			size_t page = 0;
+			for (; page < pages.size(); page++)
+			{
+				if (pages[page].Pack(w, h, &x, &y))
+					break;
+			}
+			if (page == pages.size())
+			{
+				if (array.Layers.size() == MaxArrayLayers)
+				{
+					this->pending.push_back(std::move(array));
+					array = PendingArray();
+					array.Width = this->atlasSize;
+					array.Height = this->atlasSize;
+					array.Channels = channels;
+					array.Usage = usage;
+					array.Atlas = true;
+					pages.clear();
+					page = 0;
+				}
+				pages.push_back(AtlasPacker(this->atlasSize, this->atlasSize));
+				array.Layers.push_back(std::vector<unsigned char>((size_t)this->atlasSize * this->atlasSize * channels, 0));
+				pages.back().Pack(w, h, &x, &y);
+			}
+			auto& layer = array.Layers[page];
+			for (int row = 0; row < h; row++)
+			{
+				int sy = std::min(std::max(row - this->padding, 0), image.Height - 1);
+				auto dst = layer.data() + ((size_t)(y + row) * this->atlasSize + x) * channels;
+				auto src = image.Pixels.data() + (size_t)sy * image.Width * channels;
+				for (int col = 0; col < w; col++)
+				{
+					int sx = std::min(std::max(col - this->padding, 0), image.Width - 1);
+					memcpy(dst + (size_t)col * channels, src + (size_t)sx * channels, channels);
+				}
+			}
+			float scale = 1.0f / this->atlasSize;
+			this->slots[id].Layer = (GLint)page;
+			this->slots[id].UVRect = glm::vec4((x + this->padding) * scale, (y + this->padding) * scale, image.Width * scale, image.Height * scale);
+			array.Users.push_back(id);
+			image.Pixels = std::vector<unsigned char>();
+		}
+		if (!array.Layers.empty())
+			this->pending.push_back(std::move(array));
+	}
+}
+
+bool TextureArrayBuilder::Upload()
+{
+	for (auto& array : this->pending)
+	{
+		auto format = SelectTextureFormat(array.Channels, array.Usage);
+		GLuint id = 0;
+		glGenTextures(1, &id);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, id);
+		auto levels = MipLevelCount(array.Width, array.Height);
+		AllocateTexture2DArray(format, array.Width, array.Height, (int)array.Layers.size(), levels);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, levels - 1);
+		//rows of 1-3 channel images are rarely 4 byte aligned
+		glPixelStorei(GL_UNPACK_ALIGNMENT, RowUnpackAlignment(array.Width, array.Channels));
+		for (size_t layer = 0; layer < array.Layers.size(); layer++)
+			glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, (GLint)layer, array.Width, array.Height, 1, format.Format, format.Type, array.Layers[layer].data());
+		//the whole chain comes from Pack, filtered on the CPU, so there is no glGenerateMipmap stall here
+		for (size_t layer = 0; layer < array.Mips.size(); layer++)
+		{
+			auto& chain = array.Mips[layer];
+			for (size_t i = 0; i < chain.Levels.size(); i++)
+			{
+				auto& level = chain.Levels[i];
+				glPixelStorei(GL_UNPACK_ALIGNMENT, RowUnpackAlignment(level.Width, array.Channels));
+				glTexSubImage3D(GL_TEXTURE_2D_ARRAY, (GLint)i + 1, 0, 0, (GLint)layer, level.Width, level.Height, 1, format.Format, format.Type, level.Pixels.data());
+			}
+		}
+		//atlas entries repeat in the shader, the page edge is never meant to wrap around to the other side
+		auto wrap = array.Atlas ? GL_CLAMP_TO_EDGE : GL_REPEAT;
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, wrap);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, wrap);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		for (auto user : array.Users)
+			this->slots[user].Array = id;
+		this->arrays.push_back(id);
+		this->arrayBytes.push_back(TextureByteSize(array.Width, array.Height, array.Channels, levels) * array.Layers.size());
+		array.Layers.clear();
+		array.Mips.clear();
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+	this->pending.clear();
+	return true;
+}
@@ -0,0 +1,100 @@
+#pragma once
+#include "../include/glad/glad.h"
+#include "../include/glm/glm.hpp"
+#include "MipChain.h"
+#include "TextureFormat.h"
+#include <cstddef>
+#include <vector>
+
+///where a material's texture ended up: a layer of a GL_TEXTURE_2D_ARRAY and the part of it the image covers
+struct TextureSlot
+{
+	GLuint Array = 0;
+	GLint Layer = 0;
+	///uv' = uv * UVRect.zw + UVRect.xy, (0, 0, 1, 1) for images that own their layer.
+	///atlas entries are wrapped and clamped to their rect in the shader (SampleRect in fragment.shader),
+	///only whole layers can use GL_REPEAT
+	glm::vec4 UVRect = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+};
+
+///skyline bottom-left rectangle packer
+class AtlasPacker
+{
+public:
+	AtlasPacker(int width, int height);
+	void Reset();
+	///false when the rectangle does not fit anywhere
+	bool Pack(int width, int height, int* x, int* y);
+	float Occupancy() const { return (float)this->used / ((float)this->width * this->height); }
+private:
+	struct Segment
+	{
+		int X;
+		int Y;
+		int Width;
+	};
+	///lowest y the rectangle can sit at when its left edge is on segment index, -1 if it sticks out
+	int Fit(size_t index, int width, int height) const;
+	std::vector<Segment> skyline;
+	int width;
+	int height;
+	long long used = 0;
+};
+
+///groups same sized, same format textures into GL_TEXTURE_2D_ARRAY layers and packs small ones into
+///atlas pages (themselves layers of an array per channel count), so a whole set of materials needs
+///one texture bind per format instead of one per texture
+class TextureArrayBuilder
+{
+public:
+	///images no bigger than smallSize on either side go to atlas pages of atlasSize
+	explicit TextureArrayBuilder(int smallSize = 256, int atlasSize = 2048, int padding = 4);
+	///copies the pixels (tightly packed rows, 1-4 channels of 8 bit), returns the id Slot takes after Upload.
+	///NULL pixels (a failed decode) still get an id, its slot stays Array 0
+	size_t Add(const unsigned char* pixels, int width, int height, int channels, TextureUsage usage = TextureColor);
+	///places everything, composes the atlas pages and builds every layer's mip chain. no GL calls so it
+	///can run on a worker, jobs (may be NULL) spreads the mip filtering
+	void Pack(JobSystem* jobs = NULL);
+	///GL thread, creates the arrays and drops the CPU copies
+	bool Upload();
+	const TextureSlot& Slot(size_t id) const { return this->slots[id]; }
+	///every array created so far, the caller owns them
+	const std::vector<GLuint>& Arrays() const { return this->arrays; }
+	///estimated GPU bytes of each of Arrays(), every layer and level included
+	const std::vector<size_t>& ArrayBytes() const { return this->arrayBytes; }
+private:
+	struct Image
+	{
+		std::vector<unsigned char> Pixels;
+		int Width;
+		int Height;
+		int Channels;
+		TextureUsage Usage;
+	};
+	///one array to be created, layers are whole images or composed atlas pages
+	struct PendingArray
+	{
+		int Width;
+		int Height;
+		int Channels;
+		TextureUsage Usage;
+		std::vector<std::vector<unsigned char>> Layers;
+		///levels below each layer, filled by Pack
+		std::vector<MipChain> Mips;
+		///atlas pages filter clamped, whole images wrap like the GL_REPEAT they are sampled with
+		bool Atlas = false;
+		///slots that get the array id once it exists
+		std::vector<size_t> Users;
+	};
+	void PackAtlases(std::vector<size_t>& small);
+	int smallSize;
+	int atlasSize;
+	int padding;
+	std::vector<Image> images;
+	std::vector<TextureSlot> slots;
+	std::vector<PendingArray> pending;
+	std::vector<GLuint> arrays;
+	std::vector<size_t> arrayBytes;
+	///first image not packed yet
+	size_t packedCount = 0;
+};
@@ -0,0 +1,76 @@
+#include "TextureFormat.h"
+#include "GLExtensions.h"
+#include <algorithm>
+
+TextureFormat SelectTextureFormat(int channels, TextureUsage usage)
+{
+	static const GLenum linear[] = { GL_R8, GL_RG8, GL_RGB8, GL_RGBA8 };
+	static const GLenum srgb[] = { GL_R8, GL_RG8, GL_SRGB8, GL_SRGB8_ALPHA8 };
+	static const GLenum formats[] = { GL_RED, GL_RG, GL_RGB, GL_RGBA };
+	if (channels < 1 || channels > 4)
+		channels = 4;
+	TextureFormat format;
+	format.InternalFormat = usage == TextureColor ? srgb[channels - 1] : linear[channels - 1];
+	format.Format = formats[channels - 1];
+	format.Type = GL_UNSIGNED_BYTE;
+	return format;
+}
+
+GLint RowUnpackAlignment(int width, int channels)
+{
+	auto pitch = (size_t)width * channels;
+	if (pitch % 8 == 0)
+		return 8;
+	if (pitch % 4 == 0)
+		return 4;
+	if (pitch % 2 == 0)
+		return 2;
+	return 1;
+}
+
+GLsizei MipLevelCount(int width, int height)
+{
+	GLsizei levels = 1;
+	for (int size = width > height ? width : height; size > 1; size >>= 1)
+		levels++;
+	return levels;
+}
+
+size_t TextureByteSize(int width, int height, int channels, GLsizei levels)
+{
+	size_t texel = channels == 3 ? 4 : (size_t)channels, bytes = 0;
+	for (GLsizei i = 0; i < levels; i++)
+	{
+		bytes += (size_t)width * height * texel;
+		width = width > 1 ? width / 2 : 1;
+		height = height > 1 ? height / 2 : 1;
+	}
+	return bytes;
+}
+
+void AllocateTexture2D(const TextureFormat& format, int width, int height, GLsizei levels)
+{
+	if (GLExt.TextureStorage)
+	{
+		GLExt.glTexStorage2D(GL_TEXTURE_2D, levels, format.InternalFormat, width, height);
+		return;
+	}
+	//every level the storage path would have made, uploads go through glTexSubImage into them and a level
+	//that was never specified leaves the texture incomplete
+	for (GLsizei i = 0; i < levels; i++)
+		glTexImage2D(GL_TEXTURE_2D, i, format.InternalFormat, std::max(width >> i, 1), std::max(height >> i, 1), 0, format.Format, format.Type, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+}
+
+void AllocateTexture2DArray(const TextureFormat& format, int width, int height, int layers, GLsizei levels)
+{
+	if (GLExt.TextureStorage)
+	{
+		GLExt.glTexStorage3D(GL_TEXTURE_2D_ARRAY, levels, format.InternalFormat, width, height, layers);
+		return;
+	}
+	//layers do not shrink down the chain
+	for (GLsizei i = 0; i < levels; i++)
+		glTexImage3D(GL_TEXTURE_2D_ARRAY, i, format.InternalFormat, std::max(width >> i, 1), std::max(height >> i, 1), layers, 0, format.Format, format.Type, NULL);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, levels - 1);
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include "../include/glad/glad.h"
+#include <cstddef>
+
+///what the texels mean, decides between sRGB and linear storage
+enum TextureUsage
+{
+	///colour authored in sRGB (albedo/diffuse), sampled back as linear
+	TextureColor,
+	///linear values: specular/roughness masks, normal maps, lookup tables
+	TextureData,
+};
+
+struct TextureFormat
+{
+	GLenum InternalFormat;
+	///client side layout of the pixels handed to glTex(Sub)Image
+	GLenum Format;
+	GLenum Type;
+};
+
+///sized internal format matching the decoded channel count, 1 and 2 channel images stay R8/RG8 even
+///as colour since core GL has no single/dual channel sRGB format
+TextureFormat SelectTextureFormat(int channels, TextureUsage usage);
+///largest GL_UNPACK_ALIGNMENT (8, 4, 2 or 1) the rows of tightly packed 8 bit pixels satisfy
+GLint RowUnpackAlignment(int width, int channels);
+///levels in a full mip chain down to 1x1
+GLsizei MipLevelCount(int width, int height);
+///estimated GPU bytes of the first levels of a chain of 8 bit texels, 3 channels count as 4 since
+///drivers pad RGB8 out to RGBA8
+size_t TextureByteSize(int width, int height, int channels, GLsizei levels);
+///allocates levels of the bound texture, immutable through glTexStorage when the driver has it,
+///otherwise one glTexImage per level, so either way every level can take glTexSubImage or glGenerateMipmap
+void AllocateTexture2D(const TextureFormat& format, int width, int height, GLsizei levels);
+void AllocateTexture2DArray(const TextureFormat& format, int width, int height, int layers, GLsizei levels);
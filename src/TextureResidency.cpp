@@ -0,0 +1,330 @@
+#include "TextureResidency.h"
+#include "GLExtensions.h"
+#include <algorithm>
+#include <cfloat>
+#include <climits>
+
+//reads allowed in flight at once, each one holds its levels in memory until it is uploaded
+static const int MaxLoadsInFlight = 4;
+//frames a newly streamed level takes to fade in instead of popping
+static const int FadeFrames = 8;
+
+TextureResidency::TextureResidency(JobSystem* jobs, size_t budgetBytes) : jobs(jobs), budget(budgetBytes)
+{
+}
+
+TextureResidency::~TextureResidency()
+{
+	this->jobs->Wait(&this->loading);
+	for (auto load : this->results)
+		delete load;
+	for (auto& entry : this->entries)
+	{
+		if (!entry.Tracked && entry.Texture != 0)
+			glDeleteTextures(1, &entry.Texture);
+	}
+}
+
+size_t TextureResidency::AddBaked(const char* path, TextureUsage usage)
+{
+	Entry entry;
+	entry.Path = path;
+	entry.Usage = usage;
+	//a first level past the last one reads the level sizes without copying any blocks
+	CompressedImage header;
+	if (ReadCompressedImage(path, &header, INT_MAX) && !header.Levels.empty() && BlockInternalFormat(header.Format, usage) != 0)
+	{
+		for (size_t i = 0; i <= header.Levels.size(); i++)
+			entry.Tail.push_back(CompressedImageBytes(header, (int)i));
+		entry.Width = header.Levels[0].Width;
+		entry.Height = header.Levels[0].Height;
+	}
+	else
+	{
+		entry.Tail.push_back(0);
+		entry.Failed = true;
+	}
+	entry.Level = LevelCount(entry);
+	this->entries.push_back(entry);
+	return this->entries.size() - 1;
+}
+
+size_t TextureResidency::Track(GLuint texture, size_t bytes)
+{
+	Entry entry;
+	entry.Texture = texture;
+	entry.Tracked = true;
+	entry.Tail.push_back(bytes);
+	entry.Tail.push_back(0);
+	entry.Bytes = bytes;
+	this->resident += bytes;
+	Commit(entry, bytes);
+	this->entries.push_back(entry);
+	return this->entries.size() - 1;
+}
+
+void TextureResidency::Remove(size_t id)
+{
+	auto& entry = this->entries[id];
+	if (entry.Removed)
+		return;
+	//a read in flight keeps its share committed until FinishLoad throws it away
+	Evict(entry);
+	entry.Removed = true;
+}
+
+GLuint TextureResidency::Use(size_t id, float screenSize)
+{
+	auto& entry = this->entries[id];
+	entry.LastUsed = this->frame;
+	//0 asks for everything
+	if (screenSize <= 0.0f)
+		screenSize = FLT_MAX;
+	if (entry.DemandFrame != this->frame || screenSize > entry.Demand)
+		entry.Demand = screenSize;
+	entry.DemandFrame = this->frame;
+	//the small end of the chain first, a few KB that are up within a frame or two, Update streams in the rest
+	if (entry.Texture == 0 && entry.Loading < 0 && !entry.Failed && !entry.Removed)
+		StartLoad(id, DropLimit(entry), false);
+	return entry.Texture;
+}
+
+void TextureResidency::Update()
+{
+	//uploads and fades bind on the active unit, whatever the caller had there is put back below
+	GLint bound = 0;
+	glGetIntegerv(GL_TEXTURE_BINDING_2D, &bound);
+	std::vector<Load*> finished;
+	{
+		std::lock_guard<std::mutex> guard(this->resultLock);
+		finished.swap(this->results);
+	}
+	for (auto load : finished)
+		FinishLoad(load);
+	//the newest level of each texture blends in over a few frames, MIN_LOD is relative to the base level
+	for (auto& entry : this->entries)
+	{
+		if (entry.Fade <= 0.0f || entry.Texture == 0)
+			continue;
+		entry.Fade = std::max(entry.Fade - 1.0f / FadeFrames, 0.0f);
+		glBindTexture(GL_TEXTURE_2D, entry.Texture);
+		glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_LOD, entry.Fade);
+	}
+	//unless a finished load just replaced it, deleting it unbinds it anyway
+	glBindTexture(GL_TEXTURE_2D, glIsTexture((GLuint)bound) ? (GLuint)bound : 0);
+	//least recently used first: textures idle for a while go entirely, as many as it takes, after that the
+	//ones still in use lose their top level, those with more detail than their screen size needs and bigger
+	//ones first
+	while (this->committed > this->budget && EvictIdle())
+	{
+	}
+	while (this->committed > this->budget)
+	{
+		size_t drop = this->entries.size();
+		for (size_t i = 0; i < this->entries.size() && this->inFlight < MaxLoadsInFlight; i++)
+		{
+			auto& entry = this->entries[i];
+			if (!IsEvictable(entry) || entry.Level >= DropLimit(entry))
+				continue;
+			if (drop == this->entries.size())
+			{
+				drop = i;
+				continue;
+			}
+			auto& best = this->entries[drop];
+			auto excess = WantedLevel(entry) - entry.Level, bestExcess = WantedLevel(best) - best.Level;
+			if (entry.LastUsed != best.LastUsed ? entry.LastUsed < best.LastUsed : excess != bestExcess ? excess > bestExcess : entry.Bytes > best.Bytes)
+				drop = i;
+		}
+		if (drop == this->entries.size())
+			break;
+		StartLoad(drop, this->entries[drop].Level + 1, false);
+	}
+	//then the next level for textures in use that are drawn bigger than their top level, the most
+	//magnified first. it has to fit with an eighth of the budget to spare, so a texture right at the
+	//limit does not bounce between two levels, and idle textures make room for it
+	std::vector<std::pair<float, size_t>> wanted;
+	for (size_t i = 0; i < this->entries.size(); i++)
+	{
+		auto& entry = this->entries[i];
+		if (IsEvictable(entry) && entry.LastUsed == this->frame && entry.Level > WantedLevel(entry))
+			wanted.push_back(std::make_pair(entry.Demand / std::max(entry.Width >> entry.Level, entry.Height >> entry.Level), i));
+	}
+	std::sort(wanted.begin(), wanted.end(), [](const std::pair<float, size_t>& a, const std::pair<float, size_t>& b) { return a.first > b.first; });
+	auto limit = this->budget - this->budget / 8;
+	for (size_t i = 0; i < wanted.size() && this->inFlight < MaxLoadsInFlight; i++)
+	{
+		auto& entry = this->entries[wanted[i].second];
+		auto grow = entry.Tail[entry.Level - 1] - entry.Bytes;
+		while (this->committed + grow > limit && EvictIdle())
+		{
+		}
+		if (this->committed + grow <= limit)
+			StartLoad(wanted[i].second, entry.Level - 1, true);
+	}
+	this->frame++;
+}
+
+float TextureResidency::ScreenSize(const glm::vec3& center, float radius, const glm::vec3& camera, float projectionScale)
+{
+	//inside the sphere it could fill the whole screen
+	auto distance = std::max(glm::length(center - camera) - radius, 1e-3f);
+	return 2.0f * radius * projectionScale / distance;
+}
+
+size_t TextureResidency::DefaultBudget()
+{
+	GLint kilobytes[4] = { 0, 0, 0, 0 };
+	if (HasGLExtension("GL_NVX_gpu_memory_info"))
+		glGetIntegerv(GL_GPU_MEMORY_INFO_DEDICATED_VIDMEM_NVX, kilobytes);
+	else if (HasGLExtension("GL_ATI_meminfo"))
+		glGetIntegerv(GL_TEXTURE_FREE_MEMORY_ATI, kilobytes);
+	if (kilobytes[0] <= 0)
+		return (size_t)256 << 20;
+	//the rest is left for buffers, framebuffers and whatever else shares the card
+	return (size_t)kilobytes[0] * 1024 / 2;
+}
+
+int TextureResidency::DropLimit(const Entry& entry) const
+{
+	int level = 0;
+	while (level + 1 < LevelCount(entry) && std::max(entry.Width >> (level + 1), entry.Height >> (level + 1)) >= this->minimumSize)
+		level++;
+	return level;
+}
+
+int TextureResidency::WantedLevel(const Entry& entry)
+{
+	int level = 0;
+	while (level + 1 < LevelCount(entry) && std::max(entry.Width >> (level + 1), entry.Height >> (level + 1)) >= entry.Demand)
+		level++;
+	return level;
+}
+
+bool TextureResidency::EvictIdle()
+{
+	Entry* idle = NULL;
+	for (auto& entry : this->entries)
+	{
+		if (IsEvictable(entry) && entry.LastUsed + this->idleFrames < this->frame && (idle == NULL || entry.LastUsed < idle->LastUsed))
+			idle = &entry;
+	}
+	if (idle == NULL)
+		return false;
+	Evict(*idle);
+	return true;
+}
+
+void TextureResidency::StartLoad(size_t id, int level, bool grow)
+{
+	auto& entry = this->entries[id];
+	entry.Loading = level;
+	entry.Growing = grow;
+	Commit(entry, entry.Tail[level]);
+	this->inFlight++;
+	auto path = entry.Path;
+	this->jobs->Schedule([this, id, level, grow, path]()
+	{
+		auto load = new Load();
+		load->Id = id;
+		load->Level = level;
+		load->Ok = ReadCompressedImage(path.c_str(), &load->Image, level, grow ? level : INT_MAX);
+		std::lock_guard<std::mutex> guard(this->resultLock);
+		this->results.push_back(load);
+	}, &this->loading);
+}
+
+void TextureResidency::FinishLoad(Load* load)
+{
+	auto id = load->Id;
+	auto& entry = this->entries[id];
+	auto level = load->Level;
+	auto grow = entry.Growing;
+	this->inFlight--;
+	entry.Loading = -1;
+	entry.Growing = false;
+	//the file may have been rebaked since AddBaked, a different chain would break the byte counts
+	if (entry.Removed || !load->Ok || (int)load->Image.Levels.size() != LevelCount(entry))
+	{
+		delete load;
+		//whatever was resident stays, only a texture with nothing to show gives up
+		Commit(entry, entry.Removed ? 0 : entry.Bytes);
+		if (entry.Texture == 0)
+			entry.Failed = true;
+		return;
+	}
+	//earlier errors are not this upload's
+	while (glGetError() != GL_NO_ERROR)
+	{
+	}
+	GLuint texture = 0;
+	bool uploaded;
+	if (grow)
+	{
+		uploaded = UploadLevel(entry, *load);
+	}
+	else
+	{
+		texture = UploadCompressedTexture(load->Image, entry.Usage, level);
+		uploaded = texture != 0 && glGetError() != GL_OUT_OF_MEMORY;
+		if (!uploaded)
+			glDeleteTextures(1, &texture);
+	}
+	delete load;
+	if (!uploaded)
+	{
+		//the driver ran out before the budget did, so the budget shrinks to what is already up and a
+		//texture with nothing resident yet tries again a level smaller
+		this->budget = std::min(this->budget, this->resident);
+		Commit(entry, entry.Bytes);
+		if (entry.Texture == 0 && level < LevelCount(entry) - 1)
+			StartLoad(id, level + 1, false);
+		else if (entry.Texture == 0)
+			entry.Failed = true;
+		return;
+	}
+	if (!grow)
+	{
+		if (entry.Texture != 0)
+			glDeleteTextures(1, &entry.Texture);
+		entry.Texture = texture;
+		entry.Fade = 0.0f;
+	}
+	this->resident = this->resident - entry.Bytes + entry.Tail[level];
+	entry.Level = level;
+	entry.Bytes = entry.Tail[level];
+	Commit(entry, entry.Bytes);
+}
+
+bool TextureResidency::UploadLevel(Entry& entry, const Load& load)
+{
+	auto& level = load.Image.Levels[load.Level];
+	glBindTexture(GL_TEXTURE_2D, entry.Texture);
+	glCompressedTexImage2D(GL_TEXTURE_2D, load.Level, BlockInternalFormat(load.Image.Format, entry.Usage), level.Width, level.Height, 0, (GLsizei)level.Data.size(), level.Data.data());
+	bool uploaded = glGetError() != GL_OUT_OF_MEMORY;
+	if (uploaded)
+	{
+		//the new level starts out clamped away and fades in from the one that was on top
+		entry.Fade = 1.0f;
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, load.Level);
+		glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_LOD, entry.Fade);
+	}
+	return uploaded;
+}
+
+void TextureResidency::Evict(Entry& entry)
+{
+	if (entry.Texture != 0 && !entry.Tracked)
+		glDeleteTextures(1, &entry.Texture);
+	this->resident -= entry.Bytes;
+	entry.Texture = 0;
+	entry.Bytes = 0;
+	entry.Level = LevelCount(entry);
+	Commit(entry, entry.Loading >= 0 ? entry.Tail[entry.Loading] : 0);
+}
+
+void TextureResidency::Commit(Entry& entry, size_t bytes)
+{
+	this->committed = this->committed - entry.Committed + bytes;
+	entry.Committed = bytes;
+}
@@ -0,0 +1,129 @@
+#pragma once
+#include "../include/glad/glad.h"
+#include "../include/glm/glm.hpp"
+#include "BlockCompression.h"
+#include "JobSystem.h"
+#include "TextureFormat.h"
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+///keeps textures within a GPU memory budget instead of failing once the scene outgrows VRAM, and streams
+///them in smallest mips first so something can be drawn right away.
+///baked textures (the DDS files --bake-texture writes) are read on the job system the first time they
+///are used: the small end of the chain comes first, then one level at a time up to what their size on
+///screen needs, the biggest shortfall first, each new level fading in through GL_TEXTURE_MIN_LOD.
+///when the budget runs out, textures nothing has used for a while are evicted least recently used first,
+///then the ones still in use lose their top mips, and both stream back once there is room again.
+///all calls belong to the GL thread, only the file reads run on the workers
+class TextureResidency
+{
+public:
+	explicit TextureResidency(JobSystem* jobs, size_t budgetBytes);
+	///waits for outstanding reads, deletes the textures it loaded (tracked ones stay with their owner)
+	~TextureResidency();
+	TextureResidency(const TextureResidency&) = delete;
+	TextureResidency& operator=(const TextureResidency&) = delete;
+	///reads the header only, the texels come with the first Use. a file that can not be read still
+	///gets an id, Use just returns 0 for it
+	size_t AddBaked(const char* path, TextureUsage usage = TextureColor);
+	///a texture created elsewhere (CreateTexture, texture arrays), counted against the budget but never evicted
+	size_t Track(GLuint texture, size_t bytes);
+	///stops managing id, its texture is deleted unless it was tracked
+	void Remove(size_t id);
+	///texture to draw with this frame, 0 until its first mips are up. marks it used and, if it was evicted,
+	///starts streaming it back. screenSize is how many pixels the texture spans on screen (ScreenSize), the
+	///largest over a frame's calls decides how many levels it gets, 0 asks for all of them
+	GLuint Use(size_t id, float screenSize = 0.0f);
+	///once a frame: uploads finished reads, then evicts or drops mips until the budget holds, or streams in
+	///the next level of the textures that need it most while there is room. the active unit's
+	///GL_TEXTURE_2D binding is the same afterwards
+	void Update();
+	void SetBudget(size_t bytes) { this->budget = bytes; }
+	size_t Budget() const { return this->budget; }
+	///bytes of what is on the GPU right now
+	size_t ResidentBytes() const { return this->resident; }
+	///textures unused for this many frames are evicted before anything in use loses detail, 120 by default
+	void SetIdleFrames(int frames) { this->idleFrames = frames; }
+	///streaming starts at the smallest level still this big on its longer side, and dropping mips stops
+	///there, 64 by default
+	void SetMinimumSize(int size) { this->minimumSize = size; }
+	///pixels across a bounding sphere seen from camera, projectionScale from LodProjectionScale
+	static float ScreenSize(const glm::vec3& center, float radius, const glm::vec3& camera, float projectionScale);
+	///half of the dedicated video memory the driver reports through GL_NVX_gpu_memory_info, half of the
+	///free texture memory for GL_ATI_meminfo, 256MB when it reports neither
+	static size_t DefaultBudget();
+private:
+	struct Entry
+	{
+		std::string Path;
+		TextureUsage Usage = TextureColor;
+		GLuint Texture = 0;
+		///Tail[i] is the GPU size of levels i and below, Tail[levels] is 0
+		std::vector<size_t> Tail;
+		///size of level 0
+		int Width = 0;
+		int Height = 0;
+		///GL_TEXTURE_BASE_LEVEL of Texture, levels keep their numbers from the file. the level count when
+		///nothing is resident
+		int Level = 0;
+		///level a read in flight will bring, -1 when there is none
+		int Loading = -1;
+		///the read in flight adds one level to Texture instead of replacing it
+		bool Growing = false;
+		///GL_TEXTURE_MIN_LOD while the newest level fades in
+		float Fade = 0.0f;
+		///largest screen size asked for in frame DemandFrame
+		float Demand = 0.0f;
+		uint64_t DemandFrame = 0;
+		uint64_t LastUsed = 0;
+		bool Tracked = false;
+		bool Failed = false;
+		bool Removed = false;
+		///bytes on the GPU and bytes once the read in flight replaces them
+		size_t Bytes = 0;
+		size_t Committed = 0;
+	};
+	///one finished read, filled on a worker
+	struct Load
+	{
+		size_t Id;
+		int Level;
+		bool Ok;
+		CompressedImage Image;
+	};
+	///how many levels the entry has, Tail carries one past them
+	static int LevelCount(const Entry& entry) { return (int)entry.Tail.size() - 1; }
+	///loaded by this manager, on the GPU and not about to be replaced by a read in flight
+	static bool IsEvictable(const Entry& entry) { return !entry.Tracked && !entry.Removed && entry.Texture != 0 && entry.Loading < 0; }
+	///level streaming starts at, and the lowest the top of entry may drop to under pressure
+	int DropLimit(const Entry& entry) const;
+	///finest level its last screen size can show
+	static int WantedLevel(const Entry& entry);
+	///evicts the least recently used texture idle for longer than idleFrames, false if there is none
+	bool EvictIdle();
+	///reads level and below of id in the background into a new texture, or only level to grow the current one
+	void StartLoad(size_t id, int level, bool grow);
+	void FinishLoad(Load* load);
+	///GL thread, puts the one level of load under the texture of entry, false if the driver is out of memory.
+	///leaves it bound, Update restores the binding
+	bool UploadLevel(Entry& entry, const Load& load);
+	void Evict(Entry& entry);
+	///makes Committed of entry become bytes
+	void Commit(Entry& entry, size_t bytes);
+	JobSystem* jobs;
+	std::vector<Entry> entries;
+	size_t budget;
+	size_t resident = 0;
+	///resident plus what reads in flight will add or free
+	size_t committed = 0;
+	uint64_t frame = 1;
+	int idleFrames = 120;
+	int minimumSize = 64;
+	int inFlight = 0;
+	JobCounter loading;
+	std::mutex resultLock;
+	std::vector<Load*> results;
+};
@@ -0,0 +1,49 @@
+#pragma once
+#include <atomic>
+
+///single producer / single consumer triple buffer, neither side ever blocks
+///the writer fills GetWriteBuffer() then Publish(), the reader calls Update() then GetReadBuffer()
+template <typename T>
+class TripleBuffer
+{
+public:
+	TripleBuffer()
+		: shared(1),
+		writeIndex(0),
+		readIndex(2) {}
+	T& GetWriteBuffer() { return this->buffers[this->writeIndex]; }
+	void Publish();
+	///true if a newer buffer was swapped in
+	bool Update();
+	const T& GetReadBuffer() const { return this->buffers[this->readIndex]; }
+	bool HasNew() const { return (this->shared.load(std::memory_order_acquire) & DirtyBit) != 0; }
+private:
+	static const unsigned IndexMask = 3;
+	static const unsigned DirtyBit = 4;
+	T buffers[3];
+	///index of the buffer in the middle slot, plus DirtyBit when the reader has not taken it yet
+	///padding keeps the three on separate cache lines without needing over-aligned new
+	char pad0[64];
+	std::atomic<unsigned> shared;
+	char pad1[64];
+	unsigned writeIndex;
+	char pad2[64];
+	unsigned readIndex;
+};
+
+template <typename T>
+void TripleBuffer<T>::Publish()
+{
+	auto prev = this->shared.exchange(this->writeIndex | DirtyBit, std::memory_order_acq_rel);
+	this->writeIndex = prev & IndexMask;
+}
+
+template <typename T>
+bool TripleBuffer<T>::Update()
+{
+	if ((this->shared.load(std::memory_order_relaxed) & DirtyBit) == 0)
+		return false;
+	auto prev = this->shared.exchange(this->readIndex, std::memory_order_acq_rel);
+	this->readIndex = prev & IndexMask;
+	return true;
+}
@@ -3,11 +3,34 @@ in vec2 texCoord;
 in vec3 Normal;
 in vec3 forgPos;
 out vec4 FragColor;
-uniform sampler2D ourTexture;
-uniform sampler2D refleTexture;
-uniform float ambientStrength;
-uniform vec3 lightPosition;
-uniform vec3 camPos;
+//both maps live in texture arrays, rect maps the mesh uv into the image's part of its layer
+uniform sampler2DArray diffuseArray;
+uniform sampler2DArray specularArray;
+uniform vec4 diffuseRect;
+uniform vec4 specularRect;
+uniform float diffuseLayer;
+uniform float specularLayer;
+//per frame values every program shares, written once a frame into the stream buffer
+layout(std140) uniform Frame
+{
+	mat4 view;
+	mat4 projection;
+	vec3 camPos;
+	float ambientStrength;
+	vec3 lightPosition;
+};
+
+//atlas entries share their page: the uv repeats inside the entry and stays half a texel off its edges so
+//filtering never reaches a neighbour, with the unwrapped gradients so the wrap seam keeps its mip level.
+//whole layers (rect 0,0,1,1) are left to GL_REPEAT
+vec4 SampleRect(sampler2DArray map, vec2 uv, vec4 rect, float layer)
+{
+	if (rect.z >= 1.0 && rect.w >= 1.0)
+		return texture(map, vec3(uv, layer));
+	vec2 halfTexel = 0.5 / vec2(textureSize(map, 0).xy);
+	vec2 coord = clamp(fract(uv) * rect.zw + rect.xy, rect.xy + halfTexel, rect.xy + rect.zw - halfTexel);
+	return textureGrad(map, vec3(coord, layer), dFdx(uv * rect.zw), dFdy(uv * rect.zw));
+}
 
 void main()
 {
@@ -24,9 +47,9 @@ void main()
 	vec3 camDir = normalize(camPos - forgPos);
 	//淴
 	float spec = pow(max(dot(camDir, reflectDir), 0.0), 128);
-	spec = texture(refleTexture, texCoord).x * spec;
+	spec = SampleRect(specularArray, texCoord, specularRect, specularLayer).x * spec;
 
 
-	vec4 color = texture(ourTexture, texCoord);
+	vec4 color = SampleRect(diffuseArray, texCoord, diffuseRect, diffuseLayer);
 	FragColor = color * (ambientStrength + diff + spec);
 }
\ No newline at end of file
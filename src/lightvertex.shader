@@ -1,8 +1,15 @@
 #version 330 core
 in vec3 aPos;
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+//per frame values every program shares, written once a frame into the stream buffer
+layout(std140) uniform Frame
+{
+	mat4 view;
+	mat4 projection;
+	vec3 camPos;
+	float ambientStrength;
+	vec3 lightPosition;
+};
 
 void main()
 {
@@ -1,4 +1,5 @@
 #include "../include/glad/glad.h"
+#include "GLExtensions.h"
 #define STB_IMAGE_IMPLEMENTATION
 #include "../stb_image.h"
 #include <glfw3.h>
@@ -8,9 +9,37 @@
 #include "../include/glm/glm.hpp"
 #include "../include/glm/gtc/matrix_transform.hpp"
 #include "../include/glm/gtc/type_ptr.hpp"
+#include "../include/glm/gtc/quaternion.hpp"
+#include <vector>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+#include <iterator>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include "TripleBuffer.h"
+#include "SpscQueue.h"
+#include "CommandBuffer.h"
+#include "JobSystem.h"
+#include "StreamBuffer.h"
+#include "MeshBuilder.h"
+#include "BinaryMesh.h"
+#include "MeshBuffer.h"
+#include "IndirectDraw.h"
+#include "ModelImporter.h"
+#include "TextureArray.h"
+#include "TextureFormat.h"
+#include "BlockCompression.h"
+#include "MappedFile.h"
+#include "TextureResidency.h"
+#include <climits>
+#include <memory>
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
-void processInput(GLFWwindow *window);
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
+void cursor_position_callback(GLFWwindow* window, double xpos, double ypos);
+void mouse_button_callback(GLFWwindow* window, int button, int action, int mods);
 std::ostringstream* GetShaderSourceFile(const char* path)
 {
 	std::ifstream shaderFile(path);
@@ -102,6 +131,8 @@ public:
 	VertexAttributeObject();
 	bool CreateVertexAttribute(char* const attrName, ShaderProgramer* sp, VertexBufferObject* vbo);
 	bool BindElementBufferObject(int datesize, void* data);
+	///one attribute of an interleaved vbo, at offset inside each stride sized vertex
+	bool CreateVertexAttribute(GLuint location, VertexBufferObject* vbo, int components, GLenum type, GLboolean normalized, bool integer, int stride, int offset);
 	bool UseThisVAO() { glBindVertexArray(this->ID); return true; }
 };
 VertexAttributeObject::VertexAttributeObject()
@@ -117,6 +148,15 @@ public:
 		glBindBuffer(GL_ARRAY_BUFFER, this->ID); 
 		return true; 
 	}
+	///packed formats (GL_HALF_FLOAT, GL_INT_2_10_10_10_REV...) read a different component count than
+	///bufferElementSize * typeSize bytes suggests, normalized/integer decide how the shader sees them
+	VertexBufferObject* SetAttributeFormat(int components, GLboolean normalized, bool integer)
+	{
+		this->components = components;
+		this->normalized = normalized;
+		this->integer = integer;
+		return this;
+	}
 	GLuint ID;
 	char* const vboName;
 	int dataSize;
@@ -124,6 +164,9 @@ public:
 	GLenum type;
 	int typeSize;
 	int bufferElementSize;
+	int components = -1;
+	GLboolean normalized = GL_FALSE;
+	bool integer = false;
 };
 
 VertexBufferObject::VertexBufferObject(char* const vboname, int datasize, void* data, GLenum type, int typesize, int buffelementsize)
@@ -147,8 +190,11 @@ public:
 	ShaderProgramer(char* const vertexShaderSourceFile, char* const fragmentShaderSourceFile);
 	bool Init();
 	void UseThisProgram() { glUseProgram(this->programID); }
+	unsigned int GetProgramId() { return this->programID; }
 	GLint GetUnifLocation(const char* name) { return glGetUniformLocation(this->programID, name); }
 	GLint GetAttLocation(const char* name) { return glGetAttribLocation(this->programID, name); }
+	///points the uniform block at binding, false when the program has no such block
+	bool BindUniformBlock(const char* name, GLuint binding);
 protected:
 	unsigned int programID;
 };
@@ -176,6 +222,15 @@ bool ShaderProgramer::Init()
 	return true;
 }
 
+bool ShaderProgramer::BindUniformBlock(const char* name, GLuint binding)
+{
+	auto index = glGetUniformBlockIndex(this->programID, name);
+	if (index == GL_INVALID_INDEX)
+		return false;
+	glUniformBlockBinding(this->programID, index, binding);
+	return true;
+}
+
 bool VertexAttributeObject::CreateVertexAttribute(char* const attrName, ShaderProgramer* sp, VertexBufferObject* vbo)
 {
 	if (sp == NULL || vbo == NULL)
@@ -187,7 +242,11 @@ bool VertexAttributeObject::CreateVertexAttribute(char* const attrName, ShaderPr
 	this->UseThisVAO();
 	vbo->UseThisVBO();
 	//ǿһṹһstridesizeԪsizeһ(attributeһsize,Ҳ0ƫ)
-	glVertexAttribPointer(attlayout, vbo->bufferElementSize, vbo->type, GL_FALSE, vbo->bufferElementSize * vbo->typeSize, (void*)0);
+	auto components = vbo->components > 0 ? vbo->components : vbo->bufferElementSize;
+	if (vbo->integer)
+		glVertexAttribIPointer(attlayout, components, vbo->type, vbo->bufferElementSize * vbo->typeSize, (void*)0);
+	else
+		glVertexAttribPointer(attlayout, components, vbo->type, vbo->normalized, vbo->bufferElementSize * vbo->typeSize, (void*)0);
 	glEnableVertexAttribArray(attlayout);
 	return true;
 }
@@ -201,11 +260,61 @@ bool VertexAttributeObject::BindElementBufferObject(int datesize, void* data)
 	return true;
 }
 
+bool VertexAttributeObject::CreateVertexAttribute(GLuint location, VertexBufferObject* vbo, int components, GLenum type, GLboolean normalized, bool integer, int stride, int offset)
+{
+	if (vbo == NULL)
+		return false;
+	this->UseThisVAO();
+	vbo->UseThisVBO();
+	if (integer)
+		glVertexAttribIPointer(location, components, type, stride, (void*)(size_t)offset);
+	else
+		glVertexAttribPointer(location, components, type, normalized, stride, (void*)(size_t)offset);
+	glEnableVertexAttribArray(location);
+	return true;
+}
+
+///decoded pixels waiting for upload, decoding needs no GL context so it can run on a worker
+struct DecodedImage
+{
+	unsigned char* Data = NULL;
+	int Width = 0;
+	int Height = 0;
+	int Channels = 0;
+	///levels below Data when the decode built them, UploadTexture then skips glGenerateMipmap
+	MipChain Mips;
+};
+
+///one file of a DecodeImages batch, Image must outlive the decode
+struct ImageRequest
+{
+	const char* Path = NULL;
+	DecodedImage* Image = NULL;
+	int DesiredChannels = 0;
+	const MipSettings* Mips = NULL;
+	///0 for full size, see DecodeImageFromMemory
+	int MaxSize = 0;
+};
+
 class TexureManager 
 {
 public:
-	static GLuint CreateTexture(char* const path);
+	static GLuint CreateTexture(char* const path, TextureUsage usage = TextureColor, int desiredChannels = 0, int maxSize = 0);
+	///desiredChannels 0 keeps what the file has, otherwise stb converts (1 for masks that only use red).
+	///with mips the chain is filtered right after the decode, still on the decoding thread.
+	///the file is memory mapped and decoded in place, no FILE* reads or copies into stb's buffer
+	static bool DecodeImage(const char* path, DecodedImage* image, int desiredChannels = 0, const MipSettings* mips = NULL, int maxSize = 0);
+	///same for an image already in memory, e.g. a glTF buffer view.
+	///maxSize above 0 halves the image until neither side is larger, for low end targets and distant only
+	///assets. JPEG decodes straight at 1/2, 1/4 or 1/8 scale, other formats are box filtered by stb
+	static bool DecodeImageFromMemory(const unsigned char* data, size_t size, DecodedImage* image, int desiredChannels = 0, const MipSettings* mips = NULL, int maxSize = 0);
+	///maps every file up front and has the OS read them all in at once, then decodes each one as its own job
+	///on counter, so reading the later files overlaps decoding the first. jobs NULL decodes on the calling thread
+	static void DecodeImages(const std::vector<ImageRequest>& requests, JobSystem* jobs, JobCounter* counter);
+	///GL thread only, frees image->Data
+	static GLuint UploadTexture(DecodedImage* image, TextureUsage usage = TextureColor);
 	static bool SwitchTexture(GLuint textureID, GLint layout, int textureunitId);
+	static bool SwitchTextureArray(GLuint arrayID, GLint layout, int textureunitId);
 private:
 	TexureManager() {}
 };
@@ -289,26 +398,651 @@ glm::mat4 EulerCamera::GetViewModel()
 	return glm::lookAt(this->Position, this->Position + this->Front, this->WorldUp);
 }
 
-GLuint TexureManager::CreateTexture(char* const pic)
+///quaternion log/exp, glm 0.9.8 gtx::intermediate is broken so squad control points are built here
+static glm::quat QuatLog(const glm::quat& q)
+{
+	glm::vec3 v(q.x, q.y, q.z);
+	float len = glm::length(v);
+	if (len < 1e-6f)
+		return glm::quat(0, 0, 0, 0);
+	float a = atan2(len, q.w) / len;
+	return glm::quat(0, v.x * a, v.y * a, v.z * a);
+}
+
+static glm::quat QuatExp(const glm::quat& q)
+{
+	glm::vec3 v(q.x, q.y, q.z);
+	float len = glm::length(v);
+	if (len < 1e-6f)
+		return glm::quat(1, 0, 0, 0);
+	float s = sin(len) / len;
+	return glm::quat(cos(len), v.x * s, v.y * s, v.z * s);
+}
+
+struct CameraKey
+{
+	float Time;
+	glm::vec3 Position;
+	glm::quat Orientation;
+	///squad intermediate control point, filled by CameraPath::Build
+	glm::quat Control;
+};
+
+///keyed camera poses, replayed with slerp or squad
+class CameraPath
+{
+public:
+	void AddKey(float time, glm::vec3 pos, glm::quat orientation);
+	///text file, one key per line: time x y z qw qx qy qz, # starts a comment. false if it has no keys
+	bool Load(const char* path);
+	void Build();
+	bool Evaluate(float time, bool useSquad, glm::vec3& pos, glm::quat& orientation);
+	size_t KeyCount() { return this->keys.size(); }
+	float Duration() { return this->keys.empty() ? 0 : this->keys.back().Time; }
+private:
+	size_t FindSegment(float time);
+	std::vector<CameraKey> keys;
+	///last segment used, sequential replay only walks forward a step or two
+	size_t cursor = 0;
+	bool built = false;
+};
+
+void CameraPath::AddKey(float time, glm::vec3 pos, glm::quat orientation)
 {
-	int width, height, nrChannels;
+	CameraKey key;
+	key.Time = time;
+	key.Position = pos;
+	key.Orientation = glm::normalize(orientation);
+	key.Control = key.Orientation;
+	this->keys.push_back(key);
+	this->built = false;
+}
+
+bool CameraPath::Load(const char* path)
+{
+	std::ifstream file(path);
+	std::string line;
+	while (std::getline(file, line))
+	{
+		std::istringstream fields(line.substr(0, line.find('#')));
+		float time;
+		glm::vec3 pos;
+		glm::quat orientation;
+		if (fields >> time >> pos.x >> pos.y >> pos.z >> orientation.w >> orientation.x >> orientation.y >> orientation.z)
+			this->AddKey(time, pos, orientation);
+	}
+	return !this->keys.empty();
+}
+
+void CameraPath::Build()
+{
+	std::stable_sort(this->keys.begin(), this->keys.end(),
+		[](const CameraKey& a, const CameraKey& b) { return a.Time < b.Time; });
+	//q and -q are the same rotation, keep neighbours in one hemisphere so slerp takes the short arc
+	for (size_t i = 1; i < this->keys.size(); i++)
+	{
+		if (glm::dot(this->keys[i - 1].Orientation, this->keys[i].Orientation) < 0)
+			this->keys[i].Orientation = -this->keys[i].Orientation;
+	}
+	for (size_t i = 0; i < this->keys.size(); i++)
+	{
+		auto& curr = this->keys[i].Orientation;
+		auto& prev = this->keys[i == 0 ? i : i - 1].Orientation;
+		auto& next = this->keys[i + 1 == this->keys.size() ? i : i + 1].Orientation;
+		auto inv = glm::conjugate(curr);
+		auto l = QuatLog(inv * next) + QuatLog(inv * prev);
+		this->keys[i].Control = glm::normalize(curr * QuatExp(l * -0.25f));
+	}
+	this->cursor = 0;
+	this->built = true;
+}
+
+size_t CameraPath::FindSegment(float time)
+{
+	size_t last = this->keys.size() - 2;
+	if (this->cursor > last)
+		this->cursor = last;
+	if (this->keys[this->cursor].Time <= time)
+	{
+		while (this->cursor < last && this->keys[this->cursor + 1].Time <= time)
+			this->cursor++;
+		return this->cursor;
+	}
+	auto it = std::upper_bound(this->keys.begin(), this->keys.end(), time,
+		[](float t, const CameraKey& k) { return t < k.Time; });
+	this->cursor = it == this->keys.begin() ? 0 : (size_t)(it - this->keys.begin()) - 1;
+	return this->cursor;
+}
+
+bool CameraPath::Evaluate(float time, bool useSquad, glm::vec3& pos, glm::quat& orientation)
+{
+	if (this->keys.empty())
+		return false;
+	if (!this->built)
+		this->Build();
+	if (this->keys.size() == 1 || time <= this->keys.front().Time)
+	{
+		pos = this->keys.front().Position;
+		orientation = this->keys.front().Orientation;
+		return true;
+	}
+	if (time >= this->keys.back().Time)
+	{
+		pos = this->keys.back().Position;
+		orientation = this->keys.back().Orientation;
+		return true;
+	}
+	auto i = this->FindSegment(time);
+	auto& k0 = this->keys[i];
+	auto& k1 = this->keys[i + 1];
+	float span = k1.Time - k0.Time;
+	float h = span > 0 ? (time - k0.Time) / span : 0;
+	if (!useSquad)
+	{
+		pos = glm::mix(k0.Position, k1.Position, h);
+		orientation = glm::slerp(k0.Orientation, k1.Orientation, h);
+		return true;
+	}
+	//catmull-rom for position so it stays C1 like the squad rotation
+	auto& p0 = this->keys[i == 0 ? i : i - 1].Position;
+	auto& p3 = this->keys[i + 2 < this->keys.size() ? i + 2 : i + 1].Position;
+	float h2 = h * h;
+	float h3 = h2 * h;
+	pos = 0.5f * ((2.0f * k0.Position) + (k1.Position - p0) * h
+		+ (2.0f * p0 - 5.0f * k0.Position + 4.0f * k1.Position - p3) * h2
+		+ (3.0f * k0.Position - p0 - 3.0f * k1.Position + p3) * h3);
+	auto a = glm::mix(k0.Orientation, k1.Orientation, h);
+	auto b = glm::mix(k0.Control, k1.Control, h);
+	orientation = glm::normalize(glm::mix(a, b, 2.0f * h * (1.0f - h)));
+	return true;
+}
+
+class QuaternionCamera
+	: public ICamera
+{
+public:
+	QuaternionCamera(glm::vec3 pos, glm::vec3 cfront, glm::vec3 wup);
+	glm::mat4 GetViewModel() override;
+	void PitchUp() { this->Rotate(this->pitchStep, false); }
+	void PitchDown() { this->Rotate(glm::conjugate(this->pitchStep), false); }
+	void YawLeft() { this->Rotate(this->yawStep, true); }
+	void YawRight() { this->Rotate(glm::conjugate(this->yawStep), true); }
+
+	void MoveFront() { this->Position += this->Front * 0.5f; }
+	void MoveBack() { this->Position -= this->Front * 0.5f; }
+	void MoveRight() { this->Position += this->Orientation * glm::vec3(0.5f, 0, 0); }
+	void MoveLeft() { this->Position -= this->Orientation * glm::vec3(0.5f, 0, 0); }
+
+	///free look by arbitrary angles, for mouse input
+	void Turn(float yawDegrees, float pitchDegrees);
+	void SetPose(glm::vec3 pos, glm::quat orientation);
+	bool ApplyPath(CameraPath* path, float time, bool useSquad);
+	glm::quat GetOrientation() { return this->Orientation; }
+protected:
+	void Rotate(glm::quat delta, bool worldSpace);
+	///camera to world rotation, camera looks down -z
+	glm::quat Orientation;
+	///same 0.1 degree per call steps as EulerCamera, sin/cos only paid once here
+	glm::quat pitchStep;
+	glm::quat yawStep;
+	int rotateCount = 0;
+};
+
+QuaternionCamera::QuaternionCamera(glm::vec3 pos, glm::vec3 cfront, glm::vec3 wup)
+{
+	this->Position = pos;
+	this->WorldUp = glm::normalize(wup);
+	auto f = glm::normalize(cfront);
+	auto r = glm::normalize(glm::cross(f, this->WorldUp));
+	auto u = glm::cross(r, f);
+	this->Orientation = glm::normalize(glm::quat_cast(glm::mat3(r, u, -f)));
+	this->Front = f;
+	this->pitchStep = glm::angleAxis(glm::radians(0.1f), glm::vec3(1, 0, 0));
+	this->yawStep = glm::angleAxis(glm::radians(0.1f), this->WorldUp);
+}
+
+void QuaternionCamera::Rotate(glm::quat delta, bool worldSpace)
+{
+	//yaw around world up keeps the horizon level, pitch around the local right axis
+	this->Orientation = worldSpace ? delta * this->Orientation : this->Orientation * delta;
+	//renormalize now and then so float drift does not add scale into the view matrix
+	if (++this->rotateCount >= 64)
+	{
+		this->Orientation = glm::normalize(this->Orientation);
+		this->rotateCount = 0;
+	}
+	this->Front = this->Orientation * glm::vec3(0, 0, -1);
+}
+
+void QuaternionCamera::Turn(float yawDegrees, float pitchDegrees)
+{
+	if (yawDegrees != 0)
+		this->Rotate(glm::angleAxis(glm::radians(-yawDegrees), this->WorldUp), true);
+	if (pitchDegrees != 0)
+		this->Rotate(glm::angleAxis(glm::radians(pitchDegrees), glm::vec3(1, 0, 0)), false);
+}
+
+void QuaternionCamera::SetPose(glm::vec3 pos, glm::quat orientation)
+{
+	this->Position = pos;
+	this->Orientation = orientation;
+	this->Front = this->Orientation * glm::vec3(0, 0, -1);
+}
+
+bool QuaternionCamera::ApplyPath(CameraPath* path, float time, bool useSquad)
+{
+	glm::vec3 pos;
+	glm::quat orientation;
+	if (path == NULL || !path->Evaluate(time, useSquad, pos, orientation))
+		return false;
+	this->SetPose(pos, orientation);
+	return true;
+}
+
+glm::mat4 QuaternionCamera::GetViewModel()
+{
+	//view = inverse(T * R) = transpose(R) * -T, no lookAt cross products needed
+	auto rt = glm::mat3_cast(glm::conjugate(this->Orientation));
+	glm::mat4 view(rt);
+	view[3] = glm::vec4(-(rt * this->Position), 1.0f);
+	return view;
+}
+
+enum SimulationKey
+{
+	SimKeyPitchUp = 1 << 0,
+	SimKeyPitchDown = 1 << 1,
+	SimKeyYawLeft = 1 << 2,
+	SimKeyYawRight = 1 << 3,
+	SimKeyFront = 1 << 4,
+	SimKeyBack = 1 << 5,
+	SimKeyRight = 1 << 6,
+	SimKeyLeft = 1 << 7,
+};
+
+enum InputEventType
+{
+	InputKey,
+	InputCursorPos,
+	InputMouseButton,
+};
+
+///one glfw callback, stamped with SimulationThread::Now() when it was received
+struct InputEvent
+{
+	InputEventType Type;
+	double Time;
+	///key or mouse button
+	int Code;
+	int Action;
+	int Mods;
+	double X;
+	double Y;
+};
+
+///filled by the glfw callbacks on the window thread, drained by the simulation thread
+typedef SpscQueue<InputEvent, 1024> InputQueue;
+
+///state produced by one simulation tick, never modified after it is published
+struct SimulationState
+{
+	double Time = 0;
+	glm::vec3 CamPosition;
+	glm::quat CamOrientation;
+	float ModelAngle = 0;
+};
+
+///what the render thread sees, the last two ticks so it can interpolate between them
+struct FrameSnapshot
+{
+	SimulationState Previous;
+	SimulationState Current;
+	unsigned long long Tick = 0;
+};
+
+///runs camera movement and scene updates at a fixed rate on its own thread,
+///so a vsync stall in glfwSwapBuffers no longer slows the simulation down
+class SimulationThread
+{
+public:
+	SimulationThread(QuaternionCamera* camera, double tickSeconds);
+	~SimulationThread() { this->Stop(); }
+	void Start();
+	void Stop();
+	///seconds since Start, same clock on both threads
+	double Now();
+	///called from the glfw callbacks, false if the queue was full and the event was dropped
+	bool PushInput(const InputEvent& e);
+	unsigned GetDroppedInput() { return this->droppedInput.load(std::memory_order_relaxed); }
+	///interpolated state for render time now, false until the first tick was published
+	bool Interpolate(double now, SimulationState& out);
+	double GetTickSeconds() { return this->tickSeconds; }
+	///before Start: the camera follows path, looping, instead of the keys and mouse
+	void SetCameraPath(CameraPath* path, bool useSquad) { this->path = path; this->useSquad = useSquad; }
+private:
+	void Run();
+	void Tick(SimulationState& state);
+	void DrainInput(double until);
+	void ApplyInput(const InputEvent& e);
+	QuaternionCamera* camera;
+	CameraPath* path = NULL;
+	bool useSquad = true;
+	double tickSeconds;
+	std::chrono::steady_clock::time_point startTime;
+	InputQueue input;
+	///first event stamped past the current tick, held back for the next one
+	InputEvent pendingInput;
+	bool hasPendingInput = false;
+	std::atomic<unsigned> droppedInput;
+	///held SimulationKey bits and mouse look state, only touched on the simulation thread
+	unsigned keys = 0;
+	bool mouseLook = false;
+	bool hasCursor = false;
+	double cursorX = 0;
+	double cursorY = 0;
+	float lookYaw = 0;
+	float lookPitch = 0;
+	std::atomic<bool> running;
+	std::thread worker;
+	TripleBuffer<FrameSnapshot> snapshots;
+	bool hasSnapshot = false;
+};
+
+SimulationThread::SimulationThread(QuaternionCamera* camera, double tickSeconds)
+	: camera(camera),
+	tickSeconds(tickSeconds),
+	droppedInput(0),
+	running(false)
+{
+}
+
+void SimulationThread::Start()
+{
+	if (this->running.exchange(true))
+		return;
+	this->startTime = std::chrono::steady_clock::now();
+	this->worker = std::thread(&SimulationThread::Run, this);
+}
+
+void SimulationThread::Stop()
+{
+	if (!this->running.exchange(false))
+		return;
+	if (this->worker.joinable())
+		this->worker.join();
+}
+
+double SimulationThread::Now()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - this->startTime).count();
+}
+
+bool SimulationThread::PushInput(const InputEvent& e)
+{
+	if (this->input.Push(e))
+		return true;
+	this->droppedInput.fetch_add(1, std::memory_order_relaxed);
+	return false;
+}
+
+static unsigned KeyToSimulationKey(int key)
+{
+	switch (key)
+	{
+	case GLFW_KEY_W: return SimKeyPitchUp;
+	case GLFW_KEY_S: return SimKeyPitchDown;
+	case GLFW_KEY_A: return SimKeyYawLeft;
+	case GLFW_KEY_D: return SimKeyYawRight;
+	case GLFW_KEY_UP: return SimKeyFront;
+	case GLFW_KEY_DOWN: return SimKeyBack;
+	case GLFW_KEY_RIGHT: return SimKeyRight;
+	case GLFW_KEY_LEFT: return SimKeyLeft;
+	default: return 0;
+	}
+}
+
+void SimulationThread::DrainInput(double until)
+{
+	//events stamped after this tick wait for the next one, so a press lands on the tick it happened in
+	while (this->hasPendingInput || this->input.Pop(this->pendingInput))
+	{
+		if (this->pendingInput.Time > until)
+		{
+			this->hasPendingInput = true;
+			return;
+		}
+		this->hasPendingInput = false;
+		this->ApplyInput(this->pendingInput);
+	}
+}
+
+void SimulationThread::ApplyInput(const InputEvent& e)
+{
+	if (e.Type == InputKey)
+	{
+		auto bit = KeyToSimulationKey(e.Code);
+		if (e.Action == GLFW_PRESS)
+			this->keys |= bit;
+		else if (e.Action == GLFW_RELEASE)
+			this->keys &= ~bit;
+	}
+	else if (e.Type == InputMouseButton)
+	{
+		if (e.Code == GLFW_MOUSE_BUTTON_LEFT)
+			this->mouseLook = e.Action == GLFW_PRESS;
+	}
+	else if (e.Type == InputCursorPos)
+	{
+		if (this->hasCursor && this->mouseLook)
+		{
+			this->lookYaw += (float)(e.X - this->cursorX) * 0.1f;
+			this->lookPitch -= (float)(e.Y - this->cursorY) * 0.1f;
+		}
+		this->cursorX = e.X;
+		this->cursorY = e.Y;
+		this->hasCursor = true;
+	}
+}
+
+void SimulationThread::Tick(SimulationState& state)
+{
+	this->DrainInput(state.Time + this->tickSeconds);
+	auto k = this->path != NULL ? 0 : this->keys;
+	if (this->path != NULL)
+	{
+		//replay ignores input, the same path gives the same frames run after run
+		auto duration = this->path->Duration();
+		auto time = (float)(state.Time + this->tickSeconds);
+		this->camera->ApplyPath(this->path, duration > 0 ? std::fmod(time, duration) : 0.0f, this->useSquad);
+		this->lookYaw = 0;
+		this->lookPitch = 0;
+	}
+	if (this->lookYaw != 0 || this->lookPitch != 0)
+	{
+		this->camera->Turn(this->lookYaw, this->lookPitch);
+		this->lookYaw = 0;
+		this->lookPitch = 0;
+	}
+	if (k & SimKeyPitchUp)
+		this->camera->PitchUp();
+	if (k & SimKeyPitchDown)
+		this->camera->PitchDown();
+	if (k & SimKeyYawLeft)
+		this->camera->YawLeft();
+	if (k & SimKeyYawRight)
+		this->camera->YawRight();
+	if (k & SimKeyFront)
+		this->camera->MoveFront();
+	if (k & SimKeyBack)
+		this->camera->MoveBack();
+	if (k & SimKeyRight)
+		this->camera->MoveRight();
+	if (k & SimKeyLeft)
+		this->camera->MoveLeft();
+	state.Time += this->tickSeconds;
+	state.ModelAngle += (float)this->tickSeconds;
+	state.CamPosition = this->camera->GetCamPosition();
+	state.CamOrientation = this->camera->GetOrientation();
+}
+
+void SimulationThread::Run()
+{
+	SimulationState state;
+	state.CamPosition = this->camera->GetCamPosition();
+	state.CamOrientation = this->camera->GetOrientation();
+	auto previous = state;
+	unsigned long long tick = 0;
+	auto tickDuration = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+		std::chrono::duration<double>(this->tickSeconds));
+	//tick n runs at wall time n * tickSeconds, which is also the Time it stamps
+	auto next = this->startTime + tickDuration;
+	while (this->running.load(std::memory_order_relaxed))
+	{
+		//catch up without sleeping if we fell behind, the step size never changes
+		while (std::chrono::steady_clock::now() >= next)
+		{
+			previous = state;
+			this->Tick(state);
+			tick++;
+			next += tickDuration;
+			auto& snapshot = this->snapshots.GetWriteBuffer();
+			snapshot.Previous = previous;
+			snapshot.Current = state;
+			snapshot.Tick = tick;
+			this->snapshots.Publish();
+		}
+		std::this_thread::sleep_until(next);
+	}
+}
+
+bool SimulationThread::Interpolate(double now, SimulationState& out)
+{
+	if (this->snapshots.Update())
+		this->hasSnapshot = true;
+	if (!this->hasSnapshot)
+		return false;
+	auto& snapshot = this->snapshots.GetReadBuffer();
+	//render one tick behind the newest state so there is always a pair to blend
+	float alpha = (float)((now - snapshot.Current.Time) / this->tickSeconds);
+	alpha = glm::clamp(alpha, 0.0f, 1.0f);
+	out.Time = glm::mix(snapshot.Previous.Time, snapshot.Current.Time, (double)alpha);
+	out.CamPosition = glm::mix(snapshot.Previous.CamPosition, snapshot.Current.CamPosition, alpha);
+	out.CamOrientation = glm::slerp(snapshot.Previous.CamOrientation, snapshot.Current.CamOrientation, alpha);
+	out.ModelAngle = glm::mix(snapshot.Previous.ModelAngle, snapshot.Current.ModelAngle, alpha);
+	return true;
+}
+
+//stb_image hands each PNG's passes/pipeline stages to the job workers, Wait keeps the decoding job busy meanwhile
+static void StbiParallelFor(void* user, stbi_parallel_task* task, void* taskUser, int count)
+{
+	JobSystem* jobs = (JobSystem*)user;
+	JobCounter done;
+	jobs->ParallelFor(0, count, 1, [=](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+			task(taskUser, (int)i);
+	}, &done);
+	jobs->Wait(&done);
+}
+
+GLuint TexureManager::CreateTexture(char* const pic, TextureUsage usage, int desiredChannels, int maxSize)
+{
+	DecodedImage image;
+	if (!DecodeImage(pic, &image, desiredChannels, NULL, maxSize))
+		return 0;
+	return UploadTexture(&image, usage);
+}
+
+bool TexureManager::DecodeImage(const char* pic, DecodedImage* image, int desiredChannels, const MipSettings* mips, int maxSize)
+{
+	MappedFile file;
+	if (!file.Open(pic, MappedSequential))
+	{
+		image->Data = NULL;
+		return false;
+	}
+	return DecodeImageFromMemory(file.Data(), file.Size(), image, desiredChannels, mips, maxSize);
+}
+
+bool TexureManager::DecodeImageFromMemory(const unsigned char* data, size_t size, DecodedImage* image, int desiredChannels, const MipSettings* mips, int maxSize)
+{
+	//stb takes an int length, and an empty file maps to no pointer at all
+	if (data == NULL || size == 0 || size > INT_MAX)
+	{
+		image->Data = NULL;
+		return false;
+	}
+	//per call options instead of stbi_set_flip_vertically_on_load, several workers decode at once
+	stbi_load_options options;
+	stbi_default_load_options(&options);
+	options.desired_channels = desiredChannels;
 	//opengltexture任
-	stbi_set_flip_vertically_on_load(true);
-	unsigned char* data = stbi_load(pic, &width, &height, &nrChannels, 0);
-	if (data == 0)
+	options.flip_vertically = 1;
+	options.max_size = maxSize;
+	image->Data = (unsigned char*)stbi_load_from_memory_with_options(data, (int)size, &image->Width, &image->Height, &image->Channels, NULL, &options);
+	//Channels reports the file, the buffer has what was asked for
+	if (desiredChannels != 0)
+		image->Channels = desiredChannels;
+	if (image->Data != 0 && mips != NULL)
+		image->Mips = MipGenerator::Generate(image->Data, image->Width, image->Height, image->Channels, *mips, NULL);
+	return image->Data != 0;
+}
+
+void TexureManager::DecodeImages(const std::vector<ImageRequest>& requests, JobSystem* jobs, JobCounter* counter)
+{
+	//the mappings are shared by the jobs, each one unmaps its file once decoded
+	auto files = std::make_shared<std::vector<MappedFile>>(requests.size());
+	for (size_t i = 0; i < requests.size(); i++)
+	{
+		if ((*files)[i].Open(requests[i].Path, MappedSequential))
+			(*files)[i].Prefetch();
+	}
+	for (size_t i = 0; i < requests.size(); i++)
+	{
+		auto request = requests[i];
+		auto decode = [files, request, i]()
+		{
+			auto& file = (*files)[i];
+			DecodeImageFromMemory(file.Data(), file.Size(), request.Image, request.DesiredChannels, request.Mips, request.MaxSize);
+			file.Close();
+		};
+		if (jobs != NULL)
+			jobs->Schedule(decode, counter);
+		else
+			decode();
+	}
+}
+
+GLuint TexureManager::UploadTexture(DecodedImage* image, TextureUsage usage)
+{
+	if (image->Data == 0)
 	{
 		return 0;
 	}
+	if (!image->Mips.Levels.empty())
+	{
+		auto texture = UploadMipChain(image->Data, image->Width, image->Height, image->Mips, usage);
+		stbi_image_free(image->Data);
+		image->Data = NULL;
+		image->Mips = MipChain();
+		return texture;
+	}
+	auto format = SelectTextureFormat(image->Channels, usage);
 	unsigned int TextureBuf;
 	glGenTextures(1, &TextureBuf);
 	glBindTexture(GL_TEXTURE_2D, TextureBuf);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+	AllocateTexture2D(format, image->Width, image->Height, MipLevelCount(image->Width, image->Height));
+	//3 channel rows of odd width are not 4 byte aligned, the default alignment would skew them
+	glPixelStorei(GL_UNPACK_ALIGNMENT, RowUnpackAlignment(image->Width, image->Channels));
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, image->Width, image->Height, format.Format, format.Type, image->Data);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
 	glGenerateMipmap(GL_TEXTURE_2D);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	stbi_image_free(data);
+	stbi_image_free(image->Data);
+	image->Data = NULL;
 	return TextureBuf;
 }
 bool TexureManager::SwitchTexture(GLuint textureID, GLint layout, int textureunitId)
@@ -318,15 +1052,203 @@ bool TexureManager::SwitchTexture(GLuint textureID, GLint layout, int textureuni
 	glUniform1i(layout, textureunitId);
 	return true;
 }
+bool TexureManager::SwitchTextureArray(GLuint arrayID, GLint layout, int textureunitId)
+{
+	glActiveTexture(GL_TEXTURE0 + textureunitId);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, arrayID);
+	glUniform1i(layout, textureunitId);
+	return true;
+}
 
 SampleCamera* cam = NULL;
 EulerCamera* eCam = NULL;
-int main() 
+//times stb_image's wide inflate against its reference loop on the IDAT stream of a png, false if they disagree
+static bool BenchmarkInflate(const char* path)
+{
+	std::ifstream file(path, std::ios::binary);
+	std::vector<char> png((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	std::vector<char> zlib;
+	//chunks after the 8 byte signature: length, type, data, crc
+	for (size_t at = 8; at + 12 <= png.size();)
+	{
+		const unsigned char* chunk = (const unsigned char*)&png[at];
+		size_t length = ((size_t)chunk[0] << 24) | (chunk[1] << 16) | (chunk[2] << 8) | chunk[3];
+		if (at + 12 + length > png.size())
+			break;
+		if (memcmp(chunk + 4, "IDAT", 4) == 0)
+			zlib.insert(zlib.end(), png.begin() + at + 8, png.begin() + at + 8 + length);
+		at += 12 + length;
+	}
+	if (zlib.empty())
+	{
+		std::cout << path << " has no image data" << std::endl;
+		return false;
+	}
+	const int runs = 20;
+	double best[2] = { 1e30, 1e30 };
+	std::vector<char> output[2];
+	for (int run = 0; run < runs; run++)
+	{
+		for (int reference = 0; reference < 2; reference++)
+		{
+			stbi_zlib_use_reference_inflate(reference);
+			int length = 0;
+			auto start = std::chrono::high_resolution_clock::now();
+			char* data = stbi_zlib_decode_malloc(zlib.data(), (int)zlib.size(), &length);
+			double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+			best[reference] = std::min(best[reference], seconds);
+			if (run == 0 && data != NULL)
+				output[reference].assign(data, data + length);
+			free(data);
+		}
+	}
+	stbi_zlib_use_reference_inflate(0);
+	double megabytes = output[0].size() / 1e6;
+	std::cout << path << " " << zlib.size() << " -> " << output[0].size() << " bytes, reference " << megabytes / best[1] << " MB/s, wide "
+		<< megabytes / best[0] << " MB/s, x" << best[1] / best[0] << std::endl;
+	if (output[0].empty() || output[0] != output[1])
+	{
+		std::cout << path << " wide and reference inflate disagree" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+QuaternionCamera* qCam = NULL;
+SimulationThread* sim = NULL;
+///writes the DDS --bake-texture would make from image unless path is already there (delete it to bake
+///again), false when it can not be written
+static bool BakeTextureIfMissing(const char* path, const DecodedImage& image, JobSystem* jobs)
+{
+	if (std::ifstream(path, std::ios::binary).good())
+		return true;
+	if (image.Data == NULL)
+		return false;
+	auto format = ChooseBlockFormat(image.Data, image.Width, image.Height, image.Channels);
+	MipSettings mips;
+	mips.Usage = format == BlockBC1 || format == BlockBC3 ? TextureColor : TextureData;
+	auto compressed = BlockEncoder::Compress(image.Data, image.Width, image.Height, image.Channels, format, BlockNormal, jobs, &mips);
+	return WriteCompressedImage(path, compressed);
+}
+
+///the shaders' Frame block in std140, a vec3 followed by a float packs into one 16 byte slot
+struct FrameUniforms
 {
+	glm::mat4 View;
+	glm::mat4 Projection;
+	glm::vec3 CamPosition;
+	float AmbientStrength;
+	glm::vec3 LightPosition;
+	float Padding;
+};
+//uniform buffer binding point of the Frame block
+static const GLuint FrameBlockBinding = 0;
+///what modelvertex.shader reads per draw id out of drawTransforms, six RGBA32F texels
+struct DrawTransform
+{
+	glm::mat4 Model;
+	///stored position * PositionScale + PositionBias is the mesh space one, w unused
+	glm::vec4 PositionScale;
+	glm::vec4 PositionBias;
+};
+//modelvertex.shader's aDrawId, clear of the importer's attribute locations (tangents stay off)
+static const GLint DrawIdLocation = 3;
+
+int main(int argc, char** argv) 
+{
+	//inflate throughput: main --bench-inflate [a.png b.png ...], the repo's textures when no file is given
+	if (argc >= 2 && strcmp(argv[1], "--bench-inflate") == 0)
+	{
+		static const char* const corpus[] = { "../resources/container2.png", "../resources/container2_specular.png" };
+		bool same = true;
+		if (argc == 2)
+		{
+			for (const char* path : corpus)
+				same = BenchmarkInflate(path) && same;
+		}
+		for (int i = 2; i < argc; i++)
+			same = BenchmarkInflate(argv[i]) && same;
+		return same ? 0 : 1;
+	}
+	//offline bake: main --convert in.obj|in.gltf|in.glb out.mesh
+	if (argc == 4 && strcmp(argv[1], "--convert") == 0)
+	{
+		MeshCompression compression;
+		LodSettings lods;
+		lods.MaxLevels = 4;
+		JobSystem converterJobs;
+		if (!ConvertModelToBinaryMesh(argv[2], argv[3], compression, lods, &converterJobs))
+		{
+			std::cout << "failed to convert " << argv[2] << std::endl;
+			return -1;
+		}
+		return 0;
+	}
+	//offline bake: main --bake-texture in.png out.dds [auto|bc1|bc3|bc4|bc5] [fast|normal|high] [min psnr]
+	//prints the PSNR against the source and fails below min psnr, so CI catches quality regressions
+	if (argc >= 4 && strcmp(argv[1], "--bake-texture") == 0)
+	{
+		static const char* const formatNames[] = { "bc1", "bc3", "bc4", "bc5" };
+		static const char* const qualityNames[] = { "fast", "normal", "high" };
+		DecodedImage image;
+		if (!TexureManager::DecodeImage(argv[2], &image))
+		{
+			std::cout << "failed to load " << argv[2] << std::endl;
+			return -1;
+		}
+		auto format = ChooseBlockFormat(image.Data, image.Width, image.Height, image.Channels);
+		auto quality = BlockNormal;
+		for (int i = 0; i < 4 && argc > 4; i++)
+		{
+			if (strcmp(argv[4], formatNames[i]) == 0)
+				format = (BlockFormat)i;
+		}
+		for (int i = 0; i < 3 && argc > 5; i++)
+		{
+			if (strcmp(argv[5], qualityNames[i]) == 0)
+				quality = (BlockQuality)i;
+		}
+		//BC4/BC5 hold masks and normals, only the colour formats filter their mips in linear space
+		MipSettings mips;
+		mips.Usage = format == BlockBC1 || format == BlockBC3 ? TextureColor : TextureData;
+		JobSystem bakeJobs;
+		auto compressed = BlockEncoder::Compress(image.Data, image.Width, image.Height, image.Channels, format, quality, &bakeJobs, &mips);
+		auto report = BlockEncoder::Measure(image.Data, image.Width, image.Height, image.Channels, compressed.Levels[0], format);
+		stbi_image_free(image.Data);
+		std::cout << argv[2] << " " << formatNames[format] << " " << qualityNames[quality] << " PSNR";
+		for (int c = 0; c < report.Channels; c++)
+			std::cout << " " << "rgba"[c] << " " << report.PSNR[c];
+		std::cout << " all " << report.Combined << std::endl;
+		if (!WriteCompressedImage(argv[3], compressed))
+		{
+			std::cout << "failed to write " << argv[3] << std::endl;
+			return -1;
+		}
+		return argc > 6 && report.Combined < atof(argv[6]) ? 1 : 0;
+	}
+	//main [--camera-path keys.txt] [model.obj|model.glb|model.mesh]
+	const char* modelPath = NULL;
+	CameraPath* cameraPath = NULL;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--camera-path") == 0 && i + 1 < argc)
+		{
+			cameraPath = new CameraPath();
+			if (!cameraPath->Load(argv[++i]))
+			{
+				std::cout << "no camera keys in " << argv[i] << std::endl;
+				return -1;
+			}
+		}
+		else
+			modelPath = argv[i];
+	}
 	glfwInit();
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
 	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GLFW_OPENGL_CORE_PROFILE);
+	//colour maps are sRGB textures, so shading happens in linear space and gets encoded on write
+	glfwWindowHint(GLFW_SRGB_CAPABLE, GLFW_TRUE);
 
 	auto windows = glfwCreateWindow(800, 600, "test", NULL, NULL);
 	if (windows == NULL) {
@@ -336,11 +1258,15 @@ int main()
 	glfwMakeContextCurrent(windows);
 
 	glfwSetFramebufferSizeCallback(windows, framebuffer_size_callback);
+	glfwSetKeyCallback(windows, key_callback);
+	glfwSetCursorPosCallback(windows, cursor_position_callback);
+	glfwSetMouseButtonCallback(windows, mouse_button_callback);
 	if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
 	{
 		std::cout << "Failed to initialize GLAD" << std::endl;
 		return -1;
 	}
+	LoadGLExtensions((GLADloadproc)glfwGetProcAddress);
 	
 	/*
 	unsigned int vertexShader;
@@ -398,6 +1324,12 @@ int main()
 		"./lightvertex.shader",
 		"./lightfragment.shader");
 	lightProgramer->Init();
+
+	//imported meshes are drawn through IndirectDrawList, the vertex shader finds their transform by draw id
+	ShaderProgramer* modelProgramer = new ShaderProgramer(
+		"./modelvertex.shader",
+		"./modelfragment.shader");
+	modelProgramer->Init();
 	programer->UseThisProgram();
 
 
@@ -625,8 +1557,12 @@ int main()
 	*/
 	
 	VertexBufferObject* vbo1 = new VertexBufferObject("zhengfangxin1", sizeof(vertices), vertices, GL_FLOAT, sizeof(float), 3);
-	VertexBufferObject* vbo2 = new VertexBufferObject("wenli1", sizeof(vertexMap), vertexMap, GL_FLOAT, sizeof(float), 2);
-	VertexBufferObject* vbo3 = new VertexBufferObject("normal", sizeof(normals), normals, GL_FLOAT, sizeof(float), 3);
+	//uvs as two halfs and normals as 10:10:10:2 snorm, 4 bytes each instead of 8 and 12
+	auto packedMap = MeshBuilder::PackHalf2(vertexMap, 36);
+	auto packedNormals = MeshBuilder::PackSnorm10Normals(normals, 36);
+	VertexBufferObject* vbo2 = new VertexBufferObject("wenli1", (int)(packedMap.size() * sizeof(uint32_t)), packedMap.data(), GL_HALF_FLOAT, sizeof(uint16_t), 2);
+	VertexBufferObject* vbo3 = new VertexBufferObject("normal", (int)(packedNormals.size() * sizeof(uint32_t)), packedNormals.data(), GL_INT_2_10_10_10_REV, sizeof(uint32_t), 1);
+	vbo3->SetAttributeFormat(4, GL_TRUE, false);
 	VertexAttributeObject* vao = new VertexAttributeObject();
 	vao->CreateVertexAttribute("aPos", programer, vbo1);
 	vao->CreateVertexAttribute("textPos", programer, vbo2);
@@ -634,8 +1570,50 @@ int main()
 	vao->BindElementBufferObject(sizeof(indices), indices);
 
 
-	auto textureid = TexureManager::CreateTexture("../resources/container2.png");
-	auto spectextureid = TexureManager::CreateTexture("../resources/container2_specular.png");
+	//this thread owns the GL context and becomes job thread 0, JobGLThread jobs only run here
+	JobSystem* jobs = new JobSystem();
+	stbi_set_parallel_for(StbiParallelFor, jobs);
+
+	//decode on the workers, then pack both maps into texture array layers (same size and format share
+	//one array) and filter their mip chains there too, this thread only uploads
+	DecodedImage diffuseImage, specularImage;
+	TextureArrayBuilder textureArrays;
+	size_t diffuseSlot = 0, specularSlot = 0;
+	JobCounter texturesDecoded, texturesBaked, texturesPacked, texturesUploaded;
+	std::vector<ImageRequest> textureFiles(2);
+	textureFiles[0].Path = "../resources/container2.png";
+	textureFiles[0].Image = &diffuseImage;
+	textureFiles[1].Path = "../resources/container2_specular.png";
+	textureFiles[1].Image = &specularImage;
+	textureFiles[1].DesiredChannels = 1;
+	TexureManager::DecodeImages(textureFiles, jobs, &texturesDecoded);
+	//the model streams the same maps through the residency manager, from DDS files baked on the first run
+	jobs->Schedule([&]()
+	{
+		BakeTextureIfMissing("../resources/container2.dds", diffuseImage, jobs);
+		BakeTextureIfMissing("../resources/container2_specular.dds", specularImage, jobs);
+	}, &texturesBaked, &texturesDecoded);
+	jobs->Schedule([&]()
+	{
+		diffuseSlot = textureArrays.Add(diffuseImage.Data, diffuseImage.Width, diffuseImage.Height, diffuseImage.Channels);
+		//the shader only reads red from the specular map, R8 linear instead of RGBA
+		specularSlot = textureArrays.Add(specularImage.Data, specularImage.Width, specularImage.Height, specularImage.Channels, TextureData);
+		stbi_image_free(diffuseImage.Data);
+		stbi_image_free(specularImage.Data);
+		diffuseImage.Data = specularImage.Data = NULL;
+		textureArrays.Pack(jobs);
+	}, &texturesPacked, &texturesBaked);
+	jobs->Schedule([&]() { textureArrays.Upload(); }, &texturesUploaded, &texturesPacked, JobGLThread);
+	jobs->Wait(&texturesUploaded);
+	auto diffuseTexture = textureArrays.Slot(diffuseSlot);
+	auto specularTexture = textureArrays.Slot(specularSlot);
+	//one budget for everything on the card: the arrays are only counted, baked textures added with
+	//AddBaked get evicted or lose their top mips when it runs out instead of the driver failing
+	TextureResidency* residency = new TextureResidency(jobs, TextureResidency::DefaultBudget());
+	for (size_t i = 0; i < textureArrays.Arrays().size(); i++)
+		residency->Track(textureArrays.Arrays()[i], textureArrays.ArrayBytes()[i]);
+	auto modelDiffuseMap = residency->AddBaked("../resources/container2.dds");
+	auto modelSpecularMap = residency->AddBaked("../resources/container2_specular.dds", TextureData);
 
 
 	VertexAttributeObject* vao1 = new VertexAttributeObject();
@@ -644,8 +1622,12 @@ int main()
 	
 
 
-	GLint texturelayout = programer->GetUnifLocation("ourTexture");//glGetUniformLocation(shaderProgram, "ourTexture");
-	GLint spetexturelayout = programer->GetUnifLocation("refleTexture");
+	GLint texturelayout = programer->GetUnifLocation("diffuseArray");//glGetUniformLocation(shaderProgram, "ourTexture");
+	GLint spetexturelayout = programer->GetUnifLocation("specularArray");
+	GLint diffuseRectLayout = programer->GetUnifLocation("diffuseRect");
+	GLint specularRectLayout = programer->GetUnifLocation("specularRect");
+	GLint diffuseLayerLayout = programer->GetUnifLocation("diffuseLayer");
+	GLint specularLayerLayout = programer->GetUnifLocation("specularLayer");
 	//if (texturelayout == -1)
 	//	return 0;
 
@@ -656,87 +1638,301 @@ int main()
 		return 0;
 	auto lightModelLayout = lightProgramer->GetUnifLocation("model");
 	
-	auto viewLayout = programer->GetUnifLocation("view");//glGetUniformLocation(shaderProgram, "view");
-	if (viewLayout == -1)
-		return 0;
-	auto lightViewLayout = lightProgramer->GetUnifLocation("view");
-
-	auto projectionLayout = programer->GetUnifLocation("projection");//glGetUniformLocation(shaderProgram, "projection");
-	if (projectionLayout == -1)
-		return 0;
-	auto lightProjectionLayout = lightProgramer->GetUnifLocation("projection");
-
-	auto ambientStrengthLayout = programer->GetUnifLocation("ambientStrength");
-	if (ambientStrengthLayout == -1)
-		return 0;
-
-
-	auto lightPositionLayout = programer->GetUnifLocation("lightPosition");
-	if (lightPositionLayout == -1)
-		return 0;
-
-	auto camPositionLayout = programer->GetUnifLocation("camPos");
-	if (camPositionLayout == -1)
+	//view, projection, camera and light go into the Frame block once a frame instead of being set
+	//per program, the block comes out of a ring of mapped regions so writing it never stalls
+	if (!programer->BindUniformBlock("Frame", FrameBlockBinding) || !lightProgramer->BindUniformBlock("Frame", FrameBlockBinding)
+		|| !modelProgramer->BindUniformBlock("Frame", FrameBlockBinding))
 		return 0;
+	auto uniformAlignment = StreamBuffer::UniformAlignment();
+	//the model's per-draw transforms share the ring and are read through a buffer texture over all of it,
+	//so the texel limit caps the ring's size (64K texels, ~3600 draws a frame, at the minimum)
+	GLint maxBufferTexels = 65536;
+	glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxBufferTexels);
+	auto regionSize = std::min((GLsizeiptr)maxBufferTexels * 16 / 3, (GLsizeiptr)4 << 20) & ~(GLsizeiptr)255;
+	StreamBuffer* frameData = new StreamBuffer(GL_UNIFORM_BUFFER, regionSize);
+	GLuint drawTransformTexture = 0;
+	glGenTextures(1, &drawTransformTexture);
+	glBindTexture(GL_TEXTURE_BUFFER, drawTransformTexture);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, frameData->GetId());
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+	GLint modelDiffuseLayout = modelProgramer->GetUnifLocation("diffuseMap");
+	GLint modelSpecularLayout = modelProgramer->GetUnifLocation("specularMap");
+	GLint drawTransformsLayout = modelProgramer->GetUnifLocation("drawTransforms");
+	GLint drawBaseLayout = modelProgramer->GetUnifLocation("drawBase");
+	GLint octahedralNormalsLayout = modelProgramer->GetUnifLocation("octahedralNormals");
 
 	
 	cam = new SampleCamera(glm::vec3(0, 0, 3), glm::vec3(0, 0, -1), glm::vec3(0, 1, 0));
 	eCam = new EulerCamera(glm::vec3(0, 0, 3), glm::vec3(0, 0, -1), glm::vec3(0, 1, 0));
+	//qCam belongs to the simulation thread, the render loop only reads published snapshots
+	qCam = new QuaternionCamera(glm::vec3(0, 0, 3), glm::vec3(0, 0, -1), glm::vec3(0, 1, 0));
+	QuaternionCamera viewCam(glm::vec3(0, 0, 3), glm::vec3(0, 0, -1), glm::vec3(0, 1, 0));
+	sim = new SimulationThread(qCam, 1.0 / 60.0);
+	sim->SetCameraPath(cameraPath, true);
+	sim->Start();
+	SimulationState frame;
+	CommandRecorder recorder(jobs->ThreadCount());
 
 	glm::vec3 lightPosition(3, 0, -3);
 	float ambientStrength = 0.2f;
 
+	//main model.obj|model.glb streams the model in, its meshes show up one by one as they are built
+	ModelImporter* importer = NULL;
+	//one buffer per vertex layout, a file can mix meshes with and without normals or uvs
+	std::vector<MeshBuffer*> modelBuffers;
+	//and the frame's draws out of each
+	std::vector<IndirectDrawList*> modelDraws;
+	//and whether its normals are octahedral (MeshBuilder's NormalOctahedral16), the shader decodes those
+	std::vector<bool> modelOctahedral;
+	struct ModelMesh
+	{
+		MeshBuffer* Buffer;
+		IndirectDrawList* Draws;
+		///where the mesh is drawn, identity until node transforms get applied
+		glm::mat4 Transform;
+		///turns the stored positions into mesh space, see BuiltMesh
+		glm::vec3 PositionScale = glm::vec3(1.0f);
+		glm::vec3 PositionBias = glm::vec3(0.0f);
+		MeshHandle Handle;
+		std::vector<MeshLod> Lods;
+		glm::vec3 Center;
+		float Radius;
+		MeshletMesh Meshlets;
+		ClusterCuller Culler;
+	};
+	std::vector<ModelMesh> modelMeshes;
+	auto modelBufferFor = [&](const std::vector<MeshAttribute>& layout, GLsizei stride)
+	{
+		for (size_t i = 0; i < modelBuffers.size(); i++)
+		{
+			if (modelBuffers[i]->HasLayout(layout, stride))
+				return i;
+		}
+		modelBuffers.push_back(new MeshBuffer(layout, stride, 1 << 16, 1 << 18));
+		modelDraws.push_back(new IndirectDrawList());
+		bool octahedral = false;
+		for (auto& attribute : layout)
+			octahedral = octahedral || (attribute.Location == 2 && attribute.Components == 2 && attribute.Type == GL_SHORT);
+		modelOctahedral.push_back(octahedral);
+		return modelBuffers.size() - 1;
+	};
+	//a .mesh from --convert next to the model (or given directly) maps straight into the buffers, no parse
+	//at all. --convert writes glTF primitives after the first to model.mesh.1, model.mesh.2...
+	std::string meshPath = modelPath != NULL ? modelPath : "";
+	auto extension = meshPath.find_last_of("./\\");
+	bool meshFile = extension != std::string::npos && meshPath.compare(extension, std::string::npos, ".mesh") == 0;
+	if (!meshFile)
+		meshPath = (extension != std::string::npos && meshPath[extension] == '.' ? meshPath.substr(0, extension) : meshPath) + ".mesh";
+	BinaryMesh binary;
+	for (int i = 0; modelPath != NULL && binary.Open(i == 0 ? meshPath.c_str() : (meshPath + "." + std::to_string(i)).c_str()); i++)
+	{
+		auto header = binary.Header();
+		ModelMesh mesh;
+		auto buffer = modelBufferFor(binary.Layout(), (GLsizei)header->Stride);
+		mesh.Buffer = modelBuffers[buffer];
+		mesh.Draws = modelDraws[buffer];
+		mesh.Handle = binary.UploadTo(mesh.Buffer);
+		mesh.Lods = binary.LodList();
+		mesh.PositionScale = glm::make_vec3(header->PositionScale);
+		mesh.PositionBias = glm::make_vec3(header->PositionBias);
+		auto boundsMin = glm::make_vec3(header->BoundsMin), boundsMax = glm::make_vec3(header->BoundsMax);
+		mesh.Center = (boundsMin + boundsMax) * 0.5f;
+		mesh.Radius = glm::length(boundsMax - boundsMin) * 0.5f;
+		binary.Close();
+		if (mesh.Handle.IsValid())
+			modelMeshes.push_back(mesh);
+	}
+	if (meshFile && modelMeshes.empty())
+		std::cout << "failed to open " << modelPath << std::endl;
+	if (modelPath != NULL && !meshFile && modelMeshes.empty())
+	{
+		LodSettings lods;
+		lods.MaxLevels = 4;
+		importer = new ModelImporter(jobs);
+		importer->SetLodSettings(lods);
+		importer->SetBuildMeshlets(true);
+		if (!importer->Start(modelPath))
+			std::cout << "failed to open " << modelPath << std::endl;
+	}
+
 	glEnable(GL_DEPTH_TEST);
+	glEnable(GL_FRAMEBUFFER_SRGB);
 	while (!glfwWindowShouldClose(windows))
 	{
 		// input
 		// -----
-		processInput(windows);
+		if (sim->Interpolate(sim->Now(), frame))
+			viewCam.SetPose(frame.CamPosition, frame.CamOrientation);
+
+		ImportedMesh imported;
+		while (importer != NULL && importer->Poll(imported))
+		{
+			//every LOD goes up with the mesh, they are ranges of the same index allocation
+			ModelMesh mesh;
+			auto buffer = modelBufferFor(imported.Mesh.Layout, imported.Mesh.Stride);
+			mesh.Buffer = modelBuffers[buffer];
+			mesh.Draws = modelDraws[buffer];
+			mesh.Handle = mesh.Buffer->Upload(imported.Mesh.Vertices.data(), imported.Mesh.VertexCount, imported.Mesh.Indices.data(), (GLsizei)imported.Mesh.Indices.size());
+			mesh.Lods = imported.Mesh.Lods;
+			mesh.PositionScale = imported.Mesh.PositionScale;
+			mesh.PositionBias = imported.Mesh.PositionBias;
+			mesh.Center = (imported.Mesh.BoundsMin + imported.Mesh.BoundsMax) * 0.5f;
+			mesh.Radius = glm::length(imported.Mesh.BoundsMax - imported.Mesh.BoundsMin) * 0.5f;
+			mesh.Meshlets = std::move(imported.Meshlets);
+			mesh.Culler.SetMeshlets(mesh.Meshlets);
+			if (mesh.Handle.IsValid())
+				modelMeshes.push_back(mesh);
+		}
 
 		// render
 		// ------
 		glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-		//glUseProgram(shaderProgram);
-		programer->UseThisProgram();
-		TexureManager::SwitchTexture(textureid, texturelayout, 0);
-		TexureManager::SwitchTexture(spectextureid, spetexturelayout, 1);
-		//glBindVertexArray(VAO);
-		vao->UseThisVAO();
-
-		glm::mat4 model;
-		model = glm::translate(model, glm::vec3(0.0f, 0.0f, 0.0f));
-		model = glm::rotate(model, (float)glfwGetTime(), glm::vec3(1.0f, 0.0f, 0.0f));
-		glUniformMatrix4fv(modelLayout, 1, GL_FALSE, glm::value_ptr(model));
+		//draws are recorded first and only turned into GL calls by the replay below,
+		//so recording can move to worker threads while GL stays on this one
+		auto cubeSlot = recorder.ReserveSlot();
+		auto modelSlot = recorder.ReserveSlot();
+		auto lightSlot = recorder.ReserveSlot();
 
 		glm::mat4 view;
 		//view = glm::translate(view, glm::vec3(0.0f, 0.0f, -3.0f));
-		view = eCam->GetViewModel();//cam->GetViewModel();
-		glUniformMatrix4fv(viewLayout, 1, GL_FALSE, glm::value_ptr(view));
-
-		auto campos = eCam->GetCamPosition();
-		glUniform3f(camPositionLayout, campos.x, campos.y, campos.z);
-
-		glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)800 / (float)600, 0.1f, 100.0f);
-		glUniformMatrix4fv(projectionLayout, 1, GL_FALSE, glm::value_ptr(projection));
-
-		glUniform1f(ambientStrengthLayout, ambientStrength);
-		glUniform3f(lightPositionLayout, lightPosition.x, lightPosition.y, lightPosition.z);
-
-
-
-		glDrawArrays(GL_TRIANGLES, 0, 36);
-		//glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-
-		vao1->UseThisVAO();
-		lightProgramer->UseThisProgram();
-		glm::mat4 newmodel;
-		newmodel = glm::translate(newmodel, lightPosition);
-		newmodel = glm::scale(newmodel, glm::vec3(0.2, 0.2, 0.2));
-		glUniformMatrix4fv(lightModelLayout, 1, GL_FALSE, glm::value_ptr(newmodel));
-		glUniformMatrix4fv(lightViewLayout, 1, GL_FALSE, glm::value_ptr(view));
-		glUniformMatrix4fv(lightProjectionLayout, 1, GL_FALSE, glm::value_ptr(projection));
-		glDrawArrays(GL_TRIANGLES, 0, 36);
+		view = viewCam.GetViewModel();//eCam->GetViewModel();
+		//the framebuffer, not the window, in pixels; 0 while minimized
+		int viewportWidth = 0, viewportHeight = 0;
+		glfwGetFramebufferSize(windows, &viewportWidth, &viewportHeight);
+		viewportWidth = std::max(viewportWidth, 1);
+		viewportHeight = std::max(viewportHeight, 1);
+		glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)viewportWidth / (float)viewportHeight, 0.1f, 100.0f);
+		auto campos = viewCam.GetCamPosition();
+		if (frameData->BeginFrame())
+		{
+			FrameUniforms uniforms;
+			uniforms.View = view;
+			uniforms.Projection = projection;
+			uniforms.CamPosition = campos;
+			uniforms.AmbientStrength = ambientStrength;
+			uniforms.LightPosition = lightPosition;
+			uniforms.Padding = 0.0f;
+			auto block = frameData->Upload(&uniforms, sizeof(uniforms), uniformAlignment);
+			if (block.Pointer != NULL)
+				glBindBufferRange(GL_UNIFORM_BUFFER, FrameBlockBinding, block.Buffer, block.Offset, block.Size);
+		}
+		//the model's transforms, one per mesh, are written by its recording job below
+		StreamAllocation drawData;
+		GLuint modelDiffuse = 0, modelSpecular = 0;
+		//coarsest LOD that stays within a pixel of the full mesh at this distance, and mip levels by the same measure
+		auto lodScale = LodProjectionScale(projection, (float)viewportHeight);
+		if (!modelMeshes.empty())
+		{
+			//every mesh shares the model's maps, the largest of their sizes on screen decides how many levels
+			//get streamed in. 0 until the first mips are up (or after an eviction), the model waits for both
+			for (auto& mesh : modelMeshes)
+			{
+				auto center = glm::vec3(mesh.Transform * glm::vec4(mesh.Center, 1.0f));
+				auto scale = glm::max(glm::length(glm::vec3(mesh.Transform[0])),
+					glm::max(glm::length(glm::vec3(mesh.Transform[1])), glm::length(glm::vec3(mesh.Transform[2]))));
+				auto screenSize = TextureResidency::ScreenSize(center, mesh.Radius * scale, campos, lodScale);
+				modelDiffuse = residency->Use(modelDiffuseMap, screenSize);
+				modelSpecular = residency->Use(modelSpecularMap, screenSize);
+			}
+			if (modelDiffuse != 0 && modelSpecular != 0)
+				drawData = frameData->Allocate((GLsizeiptr)(modelMeshes.size() * sizeof(DrawTransform)), 16);
+		}
+
+		JobCounter recorded;
+		jobs->Schedule([&]()
+		{
+			auto cmd = recorder.Begin(cubeSlot, JobSystem::ThreadIndex());
+			cmd->BindProgram(programer->GetProgramId());
+			cmd->BindTexture(diffuseTexture.Array, texturelayout, 0, TexTarget2DArray);
+			//both maps in one array means one bind, the specular sampler just points at the same unit
+			if (specularTexture.Array == diffuseTexture.Array)
+				cmd->SetUniform(spetexturelayout, 0);
+			else
+				cmd->BindTexture(specularTexture.Array, spetexturelayout, 1, TexTarget2DArray);
+			cmd->SetUniformVec4(diffuseRectLayout, glm::value_ptr(diffuseTexture.UVRect));
+			cmd->SetUniformVec4(specularRectLayout, glm::value_ptr(specularTexture.UVRect));
+			cmd->SetUniform(diffuseLayerLayout, (float)diffuseTexture.Layer);
+			cmd->SetUniform(specularLayerLayout, (float)specularTexture.Layer);
+			cmd->BindVertexArray(vao->ID);
+
+			glm::mat4 model;
+			model = glm::translate(model, glm::vec3(0.0f, 0.0f, 0.0f));
+			model = glm::rotate(model, frame.ModelAngle, glm::vec3(1.0f, 0.0f, 0.0f));
+			cmd->SetUniformMat4(modelLayout, glm::value_ptr(model));
+			cmd->DrawArrays(PrimTriangles, 0, 36);
+			//glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+		}, &recorded);
+		if (drawData.Pointer != NULL)
+		{
+			jobs->Schedule([&]()
+			{
+				auto cmd = recorder.Begin(modelSlot, JobSystem::ThreadIndex());
+				cmd->BindProgram(modelProgramer->GetProgramId());
+				cmd->BindTexture(modelDiffuse, modelDiffuseLayout, 0);
+				cmd->BindTexture(modelSpecular, modelSpecularLayout, 1);
+				cmd->BindTexture(drawTransformTexture, drawTransformsLayout, 2, TexTargetBuffer);
+				cmd->SetUniform(drawBaseLayout, (int)(drawData.Offset / 16));
+				//one multi-draw per buffer: a LOD range per mesh, or at full detail the runs of meshlets the
+				//cluster culler lets through. the mesh's index is its draw id, all its commands share it
+				auto transforms = (DrawTransform*)drawData.Pointer;
+				std::vector<uint32_t> visible;
+				for (auto list : modelDraws)
+					list->Clear();
+				for (size_t i = 0; i < modelMeshes.size(); i++)
+				{
+					auto& mesh = modelMeshes[i];
+					transforms[i].Model = mesh.Transform;
+					transforms[i].PositionScale = glm::vec4(mesh.PositionScale, 0.0f);
+					transforms[i].PositionBias = glm::vec4(mesh.PositionBias, 0.0f);
+					//bounds, meshlets and LODs are in the mesh's own space, so is the camera for them
+					auto eye = glm::vec3(glm::inverse(mesh.Transform) * glm::vec4(campos, 1.0f));
+					size_t level = 0;
+					if (!mesh.Lods.empty())
+					{
+						auto distance = glm::max(glm::length(eye - mesh.Center) - mesh.Radius, 0.1f);
+						level = SelectLod(mesh.Lods, distance, lodScale, 1.0f);
+					}
+					//only on-screen front-facing meshlets get drawn
+					if (level == 0 && !mesh.Meshlets.Meshlets.empty())
+					{
+						mesh.Culler.Cull(projection * view * mesh.Transform, eye, visible);
+						ClusterCuller::EmitCommands(mesh.Meshlets, mesh.Handle, visible, (GLuint)i, mesh.Draws->Commands());
+						continue;
+					}
+					auto range = mesh.Handle;
+					if (!mesh.Lods.empty())
+					{
+						range.FirstIndex += mesh.Lods[level].FirstIndex;
+						range.IndexCount = mesh.Lods[level].IndexCount;
+					}
+					mesh.Draws->Commands().push_back(IndirectDrawList::MakeCommand(range, (GLuint)i));
+				}
+				for (size_t i = 0; i < modelBuffers.size(); i++)
+				{
+					cmd->SetUniform(octahedralNormalsLayout, modelOctahedral[i] ? 1 : 0);
+					cmd->DrawIndirect(modelDraws[i], modelBuffers[i], DrawIdLocation);
+				}
+			}, &recorded);
+		}
+		jobs->Schedule([&]()
+		{
+			auto cmd = recorder.Begin(lightSlot, JobSystem::ThreadIndex());
+			cmd->BindVertexArray(vao1->ID);
+			cmd->BindProgram(lightProgramer->GetProgramId());
+			glm::mat4 newmodel;
+			newmodel = glm::translate(newmodel, lightPosition);
+			newmodel = glm::scale(newmodel, glm::vec3(0.2, 0.2, 0.2));
+			cmd->SetUniformMat4(lightModelLayout, glm::value_ptr(newmodel));
+			cmd->DrawArrays(PrimTriangles, 0, 36);
+		}, &recorded);
+		jobs->Wait(&recorded);
+
+		frameData->Flush();
+		ReplayCommandRecorderGL(recorder);
+		recorder.Reset();
+		frameData->EndFrame();
+		residency->Update();
 
 		// glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
 		// -------------------------------------------------------------------------------
@@ -744,6 +1940,20 @@ int main()
 		glfwPollEvents();
 	}
 
+	sim->Stop();
+	delete cameraPath;
+	delete importer;
+	for (auto buffer : modelBuffers)
+		delete buffer;
+	for (auto list : modelDraws)
+		delete list;
+	delete residency;
+	delete frameData;
+	glDeleteTextures(1, &drawTransformTexture);
+	glDeleteTextures((GLsizei)textureArrays.Arrays().size(), textureArrays.Arrays().data());
+	stbi_set_parallel_for(NULL, NULL);
+	delete jobs;
+
 	// glfw: terminate, clearing all previously allocated GLFW resources.
 	// ------------------------------------------------------------------
 	glfwTerminate();
@@ -751,30 +1961,48 @@ int main()
 	return 0;
 }
 
-void processInput(GLFWwindow *window)
+//glfw calls these from glfwPollEvents on the window thread, the simulation thread drains them
+void key_callback(GLFWwindow* window, int key, int, int action, int mods)
 {
-	if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
+	if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
 		glfwSetWindowShouldClose(window, true);
-	if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
-		eCam->PitchUp();// cam->MoveFront();
-	if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
-		eCam->PitchDown();//cam->MoveBack();
-	if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
-		eCam->YawLeft();
-	if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
-		eCam->YawRight();
-
-	if (glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS)
-		eCam->MoveFront();
-	if (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS)
-		eCam->MoveBack();
-	if (glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS)
-		eCam->MoveRight();
-	if (glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS)
-		eCam->MoveLeft();
-}
-
-void framebuffer_size_callback(GLFWwindow* window, int width, int height)
+	if (sim == NULL || action == GLFW_REPEAT)
+		return;
+	InputEvent e = {};
+	e.Type = InputKey;
+	e.Time = sim->Now();
+	e.Code = key;
+	e.Action = action;
+	e.Mods = mods;
+	sim->PushInput(e);
+}
+
+void cursor_position_callback(GLFWwindow*, double xpos, double ypos)
+{
+	if (sim == NULL)
+		return;
+	InputEvent e = {};
+	e.Type = InputCursorPos;
+	e.Time = sim->Now();
+	e.X = xpos;
+	e.Y = ypos;
+	sim->PushInput(e);
+}
+
+void mouse_button_callback(GLFWwindow*, int button, int action, int mods)
+{
+	if (sim == NULL)
+		return;
+	InputEvent e = {};
+	e.Type = InputMouseButton;
+	e.Time = sim->Now();
+	e.Code = button;
+	e.Action = action;
+	e.Mods = mods;
+	sim->PushInput(e);
+}
+
+void framebuffer_size_callback(GLFWwindow*, int width, int height)
 {
 	glViewport(0, 0, width, height);
 }
\ No newline at end of file
@@ -0,0 +1,39 @@
+#version 330 core
+in vec2 texCoord;
+in vec3 Normal;
+in vec3 forgPos;
+out vec4 FragColor;
+//fragment.shader for streamed textures, plain 2D maps from the residency manager instead of array layers
+uniform sampler2D diffuseMap;
+uniform sampler2D specularMap;
+//per frame values every program shares, written once a frame into the stream buffer
+layout(std140) uniform Frame
+{
+	mat4 view;
+	mat4 projection;
+	vec3 camPos;
+	float ambientStrength;
+	vec3 lightPosition;
+};
+
+void main()
+{
+	//
+	vec3 lightDir = normalize(lightPosition - forgPos);
+	//
+	vec3 norm = normalize(Normal);
+	//
+	float diff = max(dot(norm, lightDir), 0.0) * 0.4;
+
+	//շ
+	vec3 reflectDir = reflect(-lightDir, norm);
+	//۲
+	vec3 camDir = normalize(camPos - forgPos);
+	//淴
+	float spec = pow(max(dot(camDir, reflectDir), 0.0), 128);
+	spec = texture(specularMap, texCoord).x * spec;
+
+
+	vec4 color = texture(diffuseMap, texCoord);
+	FragColor = color * (ambientStrength + diff + spec);
+}
\ No newline at end of file
@@ -0,0 +1,45 @@
+#version 330 core
+layout(location = 0) in vec3 aPos;
+layout(location = 1) in vec2 textPos;
+layout(location = 2) in vec3 aNormal;
+//IndirectDrawList's draw id, one per mesh, the same for all of its commands
+layout(location = 3) in uint aDrawId;
+//six RGBA32F texels per draw from drawBase on: the model matrix's columns, then the scale and bias
+//that turn stored positions into mesh space (identity unless they are unorm16)
+uniform samplerBuffer drawTransforms;
+uniform int drawBase;
+//the normals are two octahedral snorm16 instead of a vector, the buffer being drawn decides
+uniform bool octahedralNormals;
+//per frame values every program shares, written once a frame into the stream buffer
+layout(std140) uniform Frame
+{
+	mat4 view;
+	mat4 projection;
+	vec3 camPos;
+	float ambientStrength;
+	vec3 lightPosition;
+};
+
+out vec2 texCoord;
+out vec3 Normal;
+out vec3 forgPos;
+//MeshBuilder::OctahedralDecode
+vec3 OctahedralDecode(vec2 e)
+{
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	if (n.z < 0.0)
+		n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+	return normalize(n);
+}
+void main()
+{
+	int first = drawBase + int(aDrawId) * 6;
+	mat4 model = mat4(texelFetch(drawTransforms, first), texelFetch(drawTransforms, first + 1),
+		texelFetch(drawTransforms, first + 2), texelFetch(drawTransforms, first + 3));
+	vec3 position = aPos * texelFetch(drawTransforms, first + 4).xyz + texelFetch(drawTransforms, first + 5).xyz;
+	gl_Position = projection * view * model * vec4(position, 1.0);
+	forgPos = vec3(model * vec4(position, 1.0));
+	texCoord = textPos;
+	vec3 normal = octahedralNormals ? OctahedralDecode(aNormal.xy) : aNormal;
+	Normal = mat3(transpose(inverse(model))) * normal;
+}
\ No newline at end of file
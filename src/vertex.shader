@@ -3,8 +3,15 @@ layout(location = 0) in vec3 aPos;
 layout(location = 1) in vec2 textPos;
 layout(location = 2) in vec3 aNormal;
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+//per frame values every program shares, written once a frame into the stream buffer
+layout(std140) uniform Frame
+{
+	mat4 view;
+	mat4 projection;
+	vec3 camPos;
+	float ambientStrength;
+	vec3 lightPosition;
+};
 
 out vec2 texCoord;
 out vec3 Normal;